@@ -38,6 +38,7 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Run many commands with a single load and save"},
 };
 
 static void Usage(void) {
@@ -42,18 +42,38 @@ struct pmbr {
 
 void PMBRToStr(struct pmbr *pmbr, char *str, unsigned int buflen);
 
+// Reads done while loading the GPT, shown by "cgpt show -v".
+struct drive_io_stats {
+  unsigned int reads;   /* number of read requests */
+  uint64_t bytes;       /* bytes read */
+  uint64_t usecs;       /* time spent reading */
+};
+
 // Handle to the drive storing the GPT.
 struct drive {
   uint64_t size;    /* total size (in bytes) */
   GptData gpt;
   struct pmbr pmbr;
-  int fd;       /* file descriptor */
+  int pmbr_loaded;  /* pmbr was read along with the primary GPT */
+  int direct_io;    /* fd was opened with O_DIRECT */
+  uint32_t sparse_block;  /* block size of a file that may have holes */
+  struct drive_io_stats io;
+  int fd;       /* file descriptor, -1 when the GPT is in NOR flash */
+  uint8_t *nor_gpt;       /* RW_GPT section of NOR flash, read once */
+  uint8_t *nor_original;  /* RW_GPT as read, to write back only changes */
+  uint32_t nor_size;      /* size of the RW_GPT section */
+  uint8_t *nor_fmap;      /* FMAP of NOR flash, to write back sector ranges */
+  uint32_t nor_fmap_size; /* size of the FMAP */
 };
 
-// Opens a block device or file, loads raw GPT data from it.
+// Opens a block device or file, loads raw GPT data from it. 'mode' may include
+// O_DIRECT for read-only access that bypasses the page cache.
 // 'mode' should be O_RDONLY or O_RDWR.
 // If 'drive_size' is 0, both the partitions and GPT structs reside on the same
 // 'drive_path'.
+// If 'drive_path' is an MTD device, the GPT structs are read from the RW_GPT
+// section of NOR flash into memory, and DriveClose() writes back the sectors of
+// that section that changed. 'drive_size' then defaults to the MTD size.
 // Otherwise, 'drive_size' is taken as the size of the device that all
 // partitions will reside on, and 'drive_path' is where we store GPT structs.
 //
@@ -64,6 +84,18 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
 int DriveClose(struct drive *drive, int update_as_needed);
 int CheckValid(const struct drive *drive);
 
+// Starts a batch of commands on 'drive_path'. Until DriveBatchEnd(), every
+// DriveOpen() of the same drive shares the data loaded here, and DriveClose()
+// only keeps the changes in memory.
+//
+// Returns CGPT_FAILED if the drive cannot be opened.
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size);
+
+// Ends the batch. If 'update_as_needed' is set, all changes made by the
+// commands in the batch are written (and synced) at once; otherwise nothing is
+// written.
+int DriveBatchEnd(int update_as_needed);
+
 /* Loads sectors from 'drive'.
  *
  *   drive -- open drive.
@@ -156,6 +188,10 @@ void SetRaw(struct drive *drive, int secondary, uint32_t entry_index,
 
 void UpdateAllEntries(struct drive *drive);
 
+// Like UpdateAllEntries(), when only the primary entry 'index' has changed
+// from 'old'. The entries CRC is patched rather than recomputed if possible.
+void UpdateEntry(struct drive *drive, uint32_t index, const GptEntry *old);
+
 uint8_t RepairHeader(GptData *gpt, const uint32_t valid_headers);
 uint8_t RepairEntries(GptData *gpt, const uint32_t valid_entries);
 void UpdateCrc(GptData *gpt);
@@ -190,6 +226,7 @@ int cmd_find(int argc, char *argv[]);
 int cmd_edit(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
@@ -172,9 +172,10 @@ int CgptSetAttributes(CgptAddParams *params) {
     goto bad;
   }
 
+  GptEntry old = *GetEntry(&drive.gpt, PRIMARY, params->partition - 1);
   SetEntryAttributes(&drive, params->partition - 1, params);
 
-  UpdateAllEntries(&drive);
+  UpdateEntry(&drive, params->partition - 1, &old);
 
   // Write it all out.
   return DriveClose(&drive, 1);
@@ -260,7 +261,7 @@ static int GptAdd(struct drive *drive, CgptAddParams *params, uint32_t index) {
     return -1;
   }
 
-  UpdateAllEntries(drive);
+  UpdateEntry(drive, index, &backup);
 
   rv = CheckEntries((GptEntry*)drive->gpt.primary_entries,
                     (GptHeader*)drive->gpt.primary_header);
@@ -22,16 +22,33 @@
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "cgpt.h"
+#include "cgpt_nor.h"
 #include "cgptlib_internal.h"
 #include "crc32.h"
 #include "vboot_host.h"
 
+// Buffer alignment for reads from a drive opened with O_DIRECT.
+#define DIRECT_IO_ALIGN 4096
+
+#if defined(SEEK_DATA) && defined(FALLOC_FL_PUNCH_HOLE)
+#define HAVE_SPARSE_FILES 1
+#endif
+
 static const char kErrorTag[] = "ERROR";
 static const char kWarningTag[] = "WARNING";
 
+// The drive shared by all commands in a batch, see DriveBatchBegin().
+static struct {
+  int active;
+  const char *path;
+  uint64_t size;
+  struct drive drive;
+} batch;
+
 static void LogToStderr(const char *tag, const char *format, va_list ap) {
   fprintf(stderr, "%s: ", tag);
   vfprintf(stderr, format, ap);
@@ -76,6 +93,35 @@ int CheckValid(const struct drive *drive) {
   return CGPT_OK;
 }
 
+// Reads 'count' bytes at 'offset', counting the request in drive->io.
+static ssize_t TimedRead(struct drive *drive, void *buf, size_t count,
+                         off_t offset) {
+  struct timespec start, end;
+  ssize_t nread;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (drive->nor_gpt) {
+    // The whole RW_GPT section is already in memory.
+    nread = 0;
+    if (offset >= 0 && offset < drive->nor_size) {
+      if (count > drive->nor_size - offset)
+        count = drive->nor_size - offset;
+      memcpy(buf, drive->nor_gpt + offset, count);
+      nread = count;
+    }
+  } else {
+    nread = pread(drive->fd, buf, count, offset);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  drive->io.reads++;
+  if (nread > 0)
+    drive->io.bytes += nread;
+  drive->io.usecs += (end.tv_sec - start.tv_sec) * 1000000LL +
+                     (end.tv_nsec - start.tv_nsec) / 1000;
+  return nread;
+}
+
 int Load(struct drive *drive, uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
@@ -97,12 +143,20 @@ int Load(struct drive *drive, uint8_t *buf,
   }
   count = sector_bytes * sector_count;
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET)) {
-    Error("Can't seek: %s\n", strerror(errno));
-    return CGPT_FAILED;
+  if (drive->direct_io) {
+    // O_DIRECT needs an aligned buffer, so read through a bounce buffer.
+    void *bounce;
+    if (posix_memalign(&bounce, DIRECT_IO_ALIGN, count)) {
+      Error("%s() failed to allocate %d bytes\n", __FUNCTION__, count);
+      return CGPT_FAILED;
+    }
+    nread = TimedRead(drive, bounce, count, sector * sector_bytes);
+    if (nread > 0)
+      memcpy(buf, bounce, nread);
+    free(bounce);
+  } else {
+    nread = TimedRead(drive, buf, count, sector * sector_bytes);
   }
-
-  nread = read(drive->fd, buf, count);
   if (nread < count) {
     Error("Can't read enough: %d, not %d\n", nread, count);
     return CGPT_FAILED;
@@ -113,48 +167,170 @@ int Load(struct drive *drive, uint8_t *buf,
 
 
 int ReadPMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
-    return CGPT_FAILED;
+  uint8_t *buf;
+  int ret;
+
+  if (drive->pmbr_loaded)
+    return CGPT_OK;
 
-  int nread = read(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nread != sizeof(struct pmbr))
+  buf = malloc(drive->gpt.sector_bytes);
+  if (!buf)
     return CGPT_FAILED;
+  ret = Load(drive, buf, 0, drive->gpt.sector_bytes, GPT_PMBR_SECTORS);
+  if (ret == CGPT_OK) {
+    memcpy(&drive->pmbr, buf, sizeof(struct pmbr));
+    drive->pmbr_loaded = 1;
+  }
+  free(buf);
+  return ret;
+}
+
+#ifdef HAVE_SPARSE_FILES
+static int IsZero(const uint8_t *buf, size_t count) {
+  return !count || (!buf[0] && !memcmp(buf, buf + 1, count - 1));
+}
+
+// Returns true if the file has no data in the 'count' bytes at 'offset'.
+static int IsHole(int fd, off_t offset, size_t count) {
+  off_t data = lseek(fd, offset, SEEK_DATA);
+  if (data == -1)
+    return errno == ENXIO;  // No data from 'offset' to the end of the file.
+  return data >= offset + (off_t)count;
+}
+
+// Deallocates the 'count' bytes at 'offset' of the file, so they read back as
+// zeros. Returns true on success.
+static int PunchHole(struct drive *drive, off_t offset, size_t count) {
+  if (!drive->sparse_block)
+    return 0;
+  if (fallocate(drive->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                offset, count) == 0)
+    return 1;
+  if (errno == EOPNOTSUPP || errno == ENOSYS)
+    drive->sparse_block = 0;  // Don't try again, just write zeros.
+  return 0;
+}
+
+// Writes 'count' bytes at 'offset' of a regular file, keeping a sparse image
+// sparse: blocks of zeros that fall in a hole are skipped, and blocks of zeros
+// over existing data are punched out instead of written.
+static int WriteSparse(struct drive *drive, const uint8_t *buf, size_t count,
+                       off_t offset) {
+  const size_t block = drive->sparse_block;
+
+  while (count) {
+    size_t len, next;
+    ssize_t nwrote;
+    int zero;
+
+    // Split at file block boundaries into runs of zero or non-zero blocks.
+    len = block - offset % block;
+    if (len > count)
+      len = count;
+    zero = IsZero(buf, len);
+    while (len < count) {
+      next = count - len < block ? count - len : block;
+      if (IsZero(buf + len, next) != zero)
+        break;
+      len += next;
+    }
+
+    if (!zero || !(IsHole(drive->fd, offset, len) ||
+                   PunchHole(drive, offset, len))) {
+      nwrote = pwrite(drive->fd, buf, len, offset);
+      if (nwrote < 0 || (size_t)nwrote < len)
+        return CGPT_FAILED;
+    }
 
+    buf += len;
+    offset += len;
+    count -= len;
+  }
   return CGPT_OK;
 }
+#endif
 
-int WritePMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
+// Writes 'count' bytes at 'offset', to NOR flash contents in memory if the
+// drive has them.
+static int WriteAt(struct drive *drive, const void *buf, size_t count,
+                   off_t offset) {
+  if (drive->nor_gpt) {
+    if (offset < 0 || offset > drive->nor_size ||
+        count > (size_t)(drive->nor_size - offset))
+      return CGPT_FAILED;
+    memcpy(drive->nor_gpt + offset, buf, count);
+    return CGPT_OK;
+  }
+
+#ifdef HAVE_SPARSE_FILES
+  if (drive->sparse_block)
+    return WriteSparse(drive, buf, count, offset);
+#endif
+
+  if (-1 == lseek(drive->fd, offset, SEEK_SET))
     return CGPT_FAILED;
 
-  int nwrote = write(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nwrote != sizeof(struct pmbr))
+  ssize_t nwrote = write(drive->fd, buf, count);
+  if (nwrote < 0 || (size_t)nwrote < count)
     return CGPT_FAILED;
 
   return CGPT_OK;
 }
 
+int WritePMBR(struct drive *drive) {
+  return WriteAt(drive, &drive->pmbr, sizeof(struct pmbr), 0);
+}
+
 int Save(struct drive *drive, const uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count) {
-  int count;  /* byte count to write */
-  int nwrote;
-
   require(buf);
-  count = sector_bytes * sector_count;
+  return WriteAt(drive, buf, sector_bytes * sector_count,
+                 sector * sector_bytes);
+}
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
-    return CGPT_FAILED;
+// A range of sectors read from the drive in a single request.
+struct region {
+  uint8_t *buf;
+  uint64_t sector;
+  uint64_t count;
+};
 
-  nwrote = write(drive->fd, buf, count);
-  if (nwrote < count)
-    return CGPT_FAILED;
+// Reads a region, leaving region->buf NULL if it can't be read.
+static void LoadRegion(struct drive *drive, struct region *region,
+                       uint64_t sector, uint64_t count) {
+  region->sector = sector;
+  region->count = count;
+  region->buf = malloc(count * drive->gpt.sector_bytes);
+  if (region->buf &&
+      CGPT_OK != Load(drive, region->buf, sector, drive->gpt.sector_bytes,
+                      count)) {
+    free(region->buf);
+    region->buf = NULL;
+  }
+}
 
-  return CGPT_OK;
+// Like Load(), but copies the sectors from 'region' if it holds all of them.
+static int LoadFromRegion(struct drive *drive, const struct region *region,
+                          uint8_t *buf, uint64_t sector, uint64_t count) {
+  if (region->buf && sector >= region->sector &&
+      count <= region->count && sector - region->sector <=
+      region->count - count) {
+    memcpy(buf, region->buf + (sector - region->sector) *
+           drive->gpt.sector_bytes, count * drive->gpt.sector_bytes);
+    return CGPT_OK;
+  }
+  return Load(drive, buf, sector, drive->gpt.sector_bytes, count);
 }
 
 static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
+  const GptHeader *valid1 = NULL, *valid2 = NULL;
+  size_t entries_alloc_size;
+  struct region primary = { NULL }, secondary = { NULL };
+  uint64_t entries_sectors;
+  int ret = -1;
+
   drive->gpt.sector_bytes = sector_bytes;
   if (drive->size % drive->gpt.sector_bytes) {
     Error("Media size (%llu) is not a multiple of sector size(%d)\n",
@@ -165,10 +341,7 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
 
   drive->gpt.primary_header = malloc(drive->gpt.sector_bytes);
   drive->gpt.secondary_header = malloc(drive->gpt.sector_bytes);
-  drive->gpt.primary_entries = malloc(GPT_ENTRIES_ALLOC_SIZE);
-  drive->gpt.secondary_entries = malloc(GPT_ENTRIES_ALLOC_SIZE);
-  if (!drive->gpt.primary_header || !drive->gpt.secondary_header ||
-      !drive->gpt.primary_entries || !drive->gpt.secondary_entries)
+  if (!drive->gpt.primary_header || !drive->gpt.secondary_header)
     return -1;
 
   /* TODO(namnguyen): Remove this and totally trust gpt_drive_sectors. */
@@ -176,56 +349,90 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
     drive->gpt.gpt_drive_sectors = drive->gpt.streaming_drive_sectors;
   } /* Else, we trust gpt.gpt_drive_sectors. */
 
+  // Read each half of the GPT in a single request, assuming the usual
+  // layout. Anything outside of these regions is read on its own below.
+  entries_sectors = (DEFAULT_NUMBER_OF_ENTRIES * sizeof(GptEntry) +
+                     drive->gpt.sector_bytes - 1) / drive->gpt.sector_bytes;
+  if (drive->gpt.gpt_drive_sectors >=
+      2 * (GPT_HEADER_SECTORS + entries_sectors) + GPT_PMBR_SECTORS) {
+    LoadRegion(drive, &primary, 0,
+               GPT_PMBR_SECTORS + GPT_HEADER_SECTORS + entries_sectors);
+    LoadRegion(drive, &secondary,
+               drive->gpt.gpt_drive_sectors - GPT_HEADER_SECTORS -
+               entries_sectors, GPT_HEADER_SECTORS + entries_sectors);
+  }
+  if (primary.buf) {
+    memcpy(&drive->pmbr, primary.buf, sizeof(struct pmbr));
+    drive->pmbr_loaded = 1;
+  }
+
   // Read the data.
-  if (CGPT_OK != Load(drive, drive->gpt.primary_header,
-                      GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+  if (CGPT_OK != LoadFromRegion(drive, &primary, drive->gpt.primary_header,
+                                GPT_PMBR_SECTORS, GPT_HEADER_SECTORS)) {
     Error("Cannot read primary GPT header\n");
-    return -1;
+    goto out;
   }
-  if (CGPT_OK != Load(drive, drive->gpt.secondary_header,
-                      drive->gpt.gpt_drive_sectors - GPT_PMBR_SECTORS,
-                      drive->gpt.sector_bytes, GPT_HEADER_SECTORS)) {
+  if (CGPT_OK != LoadFromRegion(drive, &secondary,
+                                drive->gpt.secondary_header,
+                                drive->gpt.gpt_drive_sectors -
+                                GPT_PMBR_SECTORS, GPT_HEADER_SECTORS)) {
     Error("Cannot read secondary GPT header\n");
-    return -1;
+    goto out;
   }
   GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
+  GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
   if (CheckHeader(primary_header, 0, drive->gpt.streaming_drive_sectors,
                   drive->gpt.gpt_drive_sectors,
                   drive->gpt.flags,
-                  drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, drive->gpt.primary_entries,
-                        primary_header->entries_lba,
-                        drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(primary_header,
-                          drive->gpt.sector_bytes))) {
+                  drive->gpt.sector_bytes) == 0)
+    valid1 = primary_header;
+  if (CheckHeader(secondary_header, 1, drive->gpt.streaming_drive_sectors,
+                  drive->gpt.gpt_drive_sectors,
+                  drive->gpt.flags,
+                  drive->gpt.sector_bytes) == 0)
+    valid2 = secondary_header;
+
+  // Both arrays must be able to hold the entries described by either header.
+  entries_alloc_size = CalculateEntriesAllocSize(valid1, valid2,
+                                                 drive->gpt.sector_bytes);
+  drive->gpt.primary_entries = calloc(1, entries_alloc_size);
+  drive->gpt.secondary_entries = calloc(1, entries_alloc_size);
+  if (!drive->gpt.primary_entries || !drive->gpt.secondary_entries)
+    goto out;
+
+  if (valid1) {
+    if (CGPT_OK != LoadFromRegion(drive, &primary, drive->gpt.primary_entries,
+                                  primary_header->entries_lba,
+                                  CalculateEntriesSectors(primary_header,
+                                    drive->gpt.sector_bytes))) {
       Error("Cannot read primary partition entry array\n");
-      return -1;
+      goto out;
     }
   } else {
     Warning("Primary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
              GPT_HEADER_SIGNATURE_SIZE) ? "invalid" : "being ignored");
   }
-  GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
-  if (CheckHeader(secondary_header, 1, drive->gpt.streaming_drive_sectors,
-                  drive->gpt.gpt_drive_sectors,
-                  drive->gpt.flags,
-                  drive->gpt.sector_bytes) == 0) {
-    if (CGPT_OK != Load(drive, drive->gpt.secondary_entries,
-                        secondary_header->entries_lba,
-                        drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(secondary_header,
-                          drive->gpt.sector_bytes))) {
+  if (valid2) {
+    if (CGPT_OK != LoadFromRegion(drive, &secondary,
+                                  drive->gpt.secondary_entries,
+                                  secondary_header->entries_lba,
+                                  CalculateEntriesSectors(secondary_header,
+                                    drive->gpt.sector_bytes))) {
       Error("Cannot read secondary partition entry array\n");
-      return -1;
+      goto out;
     }
   } else {
     Warning("Secondary GPT header is %s\n",
       memcmp(primary_header->signature, GPT_HEADER_SIGNATURE_IGNORED,
              GPT_HEADER_SIGNATURE_SIZE) ? "invalid" : "being ignored");
   }
-  return 0;
+  ret = 0;
+
+out:
+  free(primary.buf);
+  free(secondary.buf);
+  return ret;
 }
 
 static int GptSave(struct drive *drive) {
@@ -253,7 +460,8 @@ static int GptSave(struct drive *drive) {
     }
 
     // Sync primary GPT before touching secondary so one is always valid.
-    if (drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1))
+    if (drive->fd >= 0 &&
+        (drive->gpt.modified & (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1)))
       if (fsync(drive->fd) < 0 && errno == EIO) {
         errors++;
         Error("I/O error when trying to write primary GPT\n");
@@ -314,6 +522,39 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
   return 0;
 }
 
+// Loads the GPT of an MTD device from the RW_GPT section of NOR flash. The
+// section is kept in memory until DriveClose().
+static int NorDriveOpen(const char *drive_path, struct drive *drive,
+                        uint64_t drive_size) {
+  drive->fd = -1;
+  if (drive_size == 0 && GetMtdSize(drive_path, &drive_size) != 0) {
+    Error("Cannot get the size of %s.\n", drive_path);
+    return CGPT_FAILED;
+  }
+  if (ReadNorFlash(&drive->nor_gpt, &drive->nor_size,
+                   &drive->nor_fmap, &drive->nor_fmap_size) != 0)
+    return CGPT_FAILED;
+  drive->nor_original = malloc(drive->nor_size);
+  if (!drive->nor_original) {
+    Error("Cannot allocate %u bytes for RW_GPT.\n", drive->nor_size);
+    goto error_close;
+  }
+  memcpy(drive->nor_original, drive->nor_gpt, drive->nor_size);
+
+  // Partitions are on the MTD device, GPT structs are in RW_GPT.
+  drive->size = drive_size;
+  drive->gpt.flags = GPT_FLAG_EXTERNAL;
+  drive->gpt.gpt_drive_sectors = drive->nor_size / 512;
+  if (GptLoad(drive, 512))
+    goto error_close;
+
+  return CGPT_OK;
+
+error_close:
+  (void) DriveClose(drive, 0);
+  return CGPT_FAILED;
+}
+
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size) {
   uint32_t sector_bytes;
@@ -321,14 +562,45 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   require(drive_path);
   require(drive);
 
+  if (batch.active) {
+    // Commands in a batch may leave out the drive size of the batch.
+    if (strcmp(drive_path, batch.path) ||
+        (drive_size && drive_size != batch.size)) {
+      Error("Only %s can be used in a batch.\n", batch.path);
+      return CGPT_FAILED;
+    }
+    // Commands in a batch share the data loaded by DriveBatchBegin().
+    *drive = batch.drive;
+    return CGPT_OK;
+  }
+
   // Clear struct for proper error handling.
   memset(drive, 0, sizeof(struct drive));
 
+  if (IsMtd(drive_path))
+    return NorDriveOpen(drive_path, drive, drive_size);
+
   drive->fd = open(drive_path, mode |
 #if !defined(HAVE_MACOS) && !defined(__FreeBSD__)
 		               O_LARGEFILE |
 #endif
 			       O_NOFOLLOW);
+#ifdef O_DIRECT
+  if (mode & O_DIRECT) {
+    // Some file systems (e.g. tmpfs) don't support O_DIRECT.
+    if (drive->fd == -1 && errno == EINVAL) {
+      Warning("%s doesn't support direct I/O, using buffered reads\n",
+              drive_path);
+      drive->fd = open(drive_path, (mode & ~O_DIRECT) |
+#if !defined(HAVE_MACOS) && !defined(__FreeBSD__)
+                       O_LARGEFILE |
+#endif
+                       O_NOFOLLOW);
+    } else if (drive->fd != -1) {
+      drive->direct_io = 1;
+    }
+  }
+#endif
   if (drive->fd == -1) {
     Error("Can't open %s: %s\n", drive_path, strerror(errno));
     return CGPT_FAILED;
@@ -341,6 +613,14 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     goto error_close;
   }
 
+#ifdef HAVE_SPARSE_FILES
+  // Image files are often sparse; don't fill in their holes with zeros.
+  struct stat stat;
+  if (fstat(drive->fd, &stat) == 0 && S_ISREG(stat.st_mode) &&
+      stat.st_blksize > 0)
+    drive->sparse_block = stat.st_blksize;
+#endif
+
   drive->gpt.gpt_drive_sectors = gpt_drive_size / sector_bytes;
   if (drive_size == 0) {
     drive->size = gpt_drive_size;
@@ -367,6 +647,12 @@ error_close:
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
 
+  if (batch.active && drive != &batch.drive) {
+    // Keep all changes in memory; DriveBatchEnd() writes them out once.
+    batch.drive = *drive;
+    return CGPT_OK;
+  }
+
   if (update_as_needed) {
     if (GptSave(drive)) {
         errors++;
@@ -382,6 +668,21 @@ int DriveClose(struct drive *drive, int update_as_needed) {
   free(drive->gpt.secondary_entries);
   drive->gpt.secondary_entries = NULL;
 
+  if (drive->nor_gpt) {
+    // Write back only the sectors of RW_GPT that changed, if any.
+    if (update_as_needed && !errors &&
+        WriteNorFlash(drive->nor_original, drive->nor_gpt, drive->nor_size,
+                      drive->nor_fmap, drive->nor_fmap_size))
+      errors++;
+    free(drive->nor_gpt);
+    drive->nor_gpt = NULL;
+    free(drive->nor_original);
+    drive->nor_original = NULL;
+    free(drive->nor_fmap);
+    drive->nor_fmap = NULL;
+    return errors ? CGPT_FAILED : CGPT_OK;
+  }
+
   // Sync early! Only sync file descriptor here, and leave the whole system sync
   // outside cgpt because whole system sync would trigger tons of disk accesses
   // and timeout tests.
@@ -392,6 +693,21 @@ int DriveClose(struct drive *drive, int update_as_needed) {
   return errors ? CGPT_FAILED : CGPT_OK;
 }
 
+int DriveBatchBegin(const char *drive_path, uint64_t drive_size) {
+  require(!batch.active);
+  if (CGPT_OK != DriveOpen(drive_path, &batch.drive, O_RDWR, drive_size))
+    return CGPT_FAILED;
+  batch.path = drive_path;
+  batch.size = drive_size;
+  batch.active = 1;
+  return CGPT_OK;
+}
+
+int DriveBatchEnd(int update_as_needed) {
+  require(batch.active);
+  batch.active = 0;
+  return DriveClose(&batch.drive, update_as_needed);
+}
 
 /* GUID conversion functions. Accepted format:
  *
@@ -850,6 +1166,45 @@ void UpdateAllEntries(struct drive *drive) {
   UpdateCrc(&drive->gpt);
 }
 
+void UpdateEntry(struct drive *drive, uint32_t index, const GptEntry *old) {
+  GptData *gpt = &drive->gpt;
+  GptHeader *primary_header = (GptHeader*)gpt->primary_header;
+  GptHeader *secondary_header = (GptHeader*)gpt->secondary_header;
+  size_t entries_size = primary_header->size_of_entry *
+      primary_header->number_of_entries;
+  size_t offset = index * primary_header->size_of_entry;
+  GptEntry *entry;
+
+  // Patching needs both copies in sync apart from this entry, so that they
+  // share one correct entries CRC.
+  if (gpt->valid_headers != MASK_BOTH || gpt->valid_entries != MASK_BOTH ||
+      !memcmp(primary_header->signature, GPT_HEADER_SIGNATURE2,
+              GPT_HEADER_SIGNATURE_SIZE) ||
+      !IsSynonymous(primary_header, secondary_header) ||
+      primary_header->entries_crc32 != secondary_header->entries_crc32 ||
+      index >= primary_header->number_of_entries) {
+    UpdateAllEntries(drive);
+    return;
+  }
+
+  entry = GetEntry(gpt, PRIMARY, index);
+  memcpy(GetEntry(gpt, SECONDARY, index), entry, sizeof(GptEntry));
+  primary_header->entries_crc32 = Crc32Patch(primary_header->entries_crc32,
+                                             entries_size, offset, old, entry,
+                                             sizeof(GptEntry));
+  secondary_header->entries_crc32 = primary_header->entries_crc32;
+
+  // UpdateCrc() would recompute the entries CRC, so only redo the headers.
+  primary_header->header_crc32 = 0;
+  primary_header->header_crc32 = Crc32(
+      (const uint8_t *)primary_header, sizeof(GptHeader));
+  secondary_header->header_crc32 = 0;
+  secondary_header->header_crc32 = Crc32(
+      (const uint8_t *)secondary_header, sizeof(GptHeader));
+  gpt->modified |= (GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1 |
+                    GPT_MODIFIED_HEADER2 | GPT_MODIFIED_ENTRIES2);
+}
+
 int IsUnused(struct drive *drive, int secondary, uint32_t index) {
   GptEntry *entry;
   entry = GetEntry(&drive->gpt, secondary, index);
@@ -10,14 +10,13 @@
 #include "vboot_host.h"
 
 static void AllocAndClear(uint8_t **buf, uint64_t size) {
-  if (*buf) {
-    memset(*buf, 0, size);
-  } else {
-    *buf = calloc(1, size);
-    if (!*buf) {
-      Error("Cannot allocate %" PRIu64 " bytes.\n", size);
-      abort();
-    }
+  // The existing buffer may be smaller, for example entries loaded from a
+  // table with fewer entries.
+  free(*buf);
+  *buf = calloc(1, size);
+  if (!*buf) {
+    Error("Cannot allocate %" PRIu64 " bytes.\n", size);
+    abort();
   }
 }
 
@@ -61,7 +60,15 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
 
     /* Calculate number of entries */
     h->size_of_entry = sizeof(GptEntry);
-    h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+    h->number_of_entries = params->entries ? params->entries :
+                           DEFAULT_NUMBER_OF_ENTRIES;
+    if (h->number_of_entries > MAX_NUMBER_OF_ENTRIES ||
+        h->number_of_entries < MIN_NUMBER_OF_ENTRIES ||
+        (!(drive->gpt.flags & GPT_FLAG_EXTERNAL) &&
+         h->number_of_entries < DEFAULT_NUMBER_OF_ENTRIES)) {
+      Error("Invalid number of entries: %u.\n", h->number_of_entries);
+      return -1;
+    }
     if (drive->gpt.flags & GPT_FLAG_EXTERNAL) {
       // We might have smaller space for the GPT table. Scale accordingly.
       //
@@ -104,7 +111,8 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
       h->last_usable_lba = (drive->gpt.streaming_drive_sectors - 1);
     }
 
-    size_t entries_size = h->number_of_entries * h->size_of_entry;
+    size_t entries_size = CalculateEntriesAllocSize(h, NULL,
+                                                    drive->gpt.sector_bytes);
     AllocAndClear(&drive->gpt.primary_entries, entries_size);
     AllocAndClear(&drive->gpt.secondary_entries, entries_size);
 
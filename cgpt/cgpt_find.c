@@ -4,6 +4,7 @@
  */
 
 #include <ctype.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -11,27 +12,48 @@
 
 #include "cgpt.h"
 #include "cgptlib_internal.h"
-#include "cgpt_nor.h"
 #include "vboot_host.h"
 
 #define BUFSIZE 1024
+#define FIND_MAX_THREADS 16
+
+// A partition that matched the search criteria.
+struct find_match {
+  int partnum;
+  GptEntry entry;
+};
+
+// All matches found on one drive. Drives may be searched concurrently, so
+// matches are kept here and reported later in the order of the drives.
+struct find_result {
+  char *filename;
+  struct find_match *matches;
+  int num_matches;
+};
+
+// Drives to be searched by worker threads.
+struct find_job {
+  CgptFindParams *params;
+  struct find_result *results;
+  int num_results;
+  int next;  // index of the next drive to search, protected by lock
+  pthread_mutex_t lock;
+};
 
 // fill comparebuf with the data to be examined, returning true on success.
-static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
+static int FillBuffer(uint8_t *comparebuf, int fd, uint64_t pos,
                        uint64_t count) {
-  uint8_t *bufptr = params->comparebuf;
-
-  if (-1 == lseek(fd, pos, SEEK_SET))
-    return 0;
+  uint8_t *bufptr = comparebuf;
 
   // keep reading until done or error
   while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+    ssize_t bytes_read = pread(fd, bufptr, count, pos);
     // negative means error, 0 means (unexpected) EOF
     if (bytes_read <= 0)
       return 0;
     count -= bytes_read;
     bufptr += bytes_read;
+    pos += bytes_read;
   }
 
   return 1;
@@ -39,7 +61,7 @@ static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
 
 // check partition data content. return true for match, 0 for no match or error
 static int match_content(CgptFindParams *params, struct drive *drive,
-                             GptEntry *entry) {
+                         GptEntry *entry, uint8_t *comparebuf) {
   uint64_t part_size;
 
   if (!params->matchlen)
@@ -53,7 +75,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Read the partition data.
-  if (!FillBuffer(params, drive->fd,
+  if (!FillBuffer(comparebuf, drive->fd,
     (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset,
                   params->matchlen)) {
     Error("unable to read partition data\n");
@@ -61,7 +83,7 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   }
 
   // Compare it
-  if (0 == memcmp(params->matchbuf, params->comparebuf, params->matchlen)) {
+  if (0 == memcmp(params->matchbuf, comparebuf, params->matchlen)) {
     return 1;
   }
 
@@ -111,12 +133,13 @@ static void chromeos_mtd_show(CgptFindParams *params, const char *filename,
 
 // This returns true if a GPT partition matches the search criteria. If a match
 // isn't found (or if the file doesn't contain a GPT), it returns false. The
-// filename and partition number that matched is left in a global, since we
-// could have multiple hits.
+// partitions that matched are added to 'result', since we could have multiple
+// hits. This may run in several threads, so it must not change 'params'.
 static int gpt_search(CgptFindParams *params, struct drive *drive,
-                      const char *filename) {
+                      struct find_result *result, uint8_t *comparebuf) {
   int i;
   GptEntry *entry;
+  struct find_match *matches;
   int retval = 0;
   char partlabel[GPT_PARTNAME_LEN];
 
@@ -144,32 +167,120 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
       if (!strncmp(params->label, partlabel, sizeof(partlabel)))
         found = 1;
     }
-    if (found && match_content(params, drive, entry)) {
-      params->hits++;
+    if (found && match_content(params, drive, entry, comparebuf)) {
+      matches = realloc(result->matches,
+                        (result->num_matches + 1) * sizeof(*matches));
+      if (!matches) {
+        Error("Out of memory.\n");
+        return retval;
+      }
+      result->matches = matches;
+      matches[result->num_matches].partnum = i + 1;
+      matches[result->num_matches].entry = *entry;
+      result->num_matches++;
       retval++;
-      showmatch(params, filename, i+1, entry);
-      if (!params->match_partnum)
-        params->match_partnum = i+1;
     }
   }
 
   return retval;
 }
 
-static int do_search(CgptFindParams *params, const char *fileName) {
+// Searches one drive, adding partitions that matched to 'result'.
+static int search_drive(CgptFindParams *params, struct find_result *result,
+                        uint8_t *comparebuf) {
   int retval;
   struct drive drive;
 
-  if (CGPT_OK != DriveOpen(fileName, &drive, O_RDONLY, params->drive_size))
+  if (CGPT_OK != DriveOpen(result->filename, &drive, O_RDONLY,
+                           params->drive_size))
     return 0;
 
-  retval = gpt_search(params, &drive, fileName);
+  retval = gpt_search(params, &drive, result, comparebuf);
 
   (void) DriveClose(&drive, 0);
 
   return retval;
 }
 
+// Shows the matches in 'result' and counts them in 'params'. Returns the
+// number of matches.
+static int report_matches(CgptFindParams *params, struct find_result *result) {
+  int i;
+  struct find_match *match;
+
+  for (i = 0; i < result->num_matches; i++) {
+    match = &result->matches[i];
+    params->hits++;
+    showmatch(params, result->filename, match->partnum, &match->entry);
+    if (!params->match_partnum)
+      params->match_partnum = match->partnum;
+  }
+  return result->num_matches;
+}
+
+static int do_search(CgptFindParams *params, const char *fileName) {
+  struct find_result result = { (char *)fileName, NULL, 0 };
+  int retval;
+
+  search_drive(params, &result, params->comparebuf);
+  retval = report_matches(params, &result);
+  free(result.matches);
+
+  return retval;
+}
+
+static void *find_worker(void *arg) {
+  struct find_job *job = arg;
+  uint8_t *comparebuf = NULL;
+  int i;
+
+  if (job->params->matchlen) {
+    comparebuf = malloc(job->params->matchlen);
+    if (!comparebuf)
+      return NULL;
+  }
+
+  while (1) {
+    pthread_mutex_lock(&job->lock);
+    i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (i >= job->num_results)
+      break;
+    search_drive(job->params, &job->results[i], comparebuf);
+  }
+
+  free(comparebuf);
+  return NULL;
+}
+
+// Searches all the drives in 'results' concurrently, then reports the matches
+// in the same order as the drives are listed. Returns the number of drives
+// that had any match.
+static int search_drives(CgptFindParams *params, struct find_result *results,
+                         int num_results) {
+  pthread_t threads[FIND_MAX_THREADS];
+  struct find_job job = { params, results, num_results, 0 };
+  int i, num_threads = 0, found = 0;
+
+  pthread_mutex_init(&job.lock, NULL);
+  while (num_threads < FIND_MAX_THREADS && num_threads < num_results - 1) {
+    if (pthread_create(&threads[num_threads], NULL, find_worker, &job))
+      break;
+    num_threads++;
+  }
+  // This thread also searches, so it works even if no threads were created.
+  find_worker(&job);
+  for (i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&job.lock);
+
+  for (i = 0; i < num_results; i++) {
+    if (report_matches(params, &results[i]))
+      found++;
+  }
+  return found;
+}
+
 
 #define PROC_MTD "/proc/mtd"
 #define PROC_PARTITIONS "/proc/partitions"
@@ -222,6 +333,8 @@ static int scan_real_devs(CgptFindParams *params) {
   char partname_prev[MAX_PARTITION_NAME_LEN];
   FILE *fp;
   char *pathname;
+  struct find_result *results = NULL, *new_results;
+  int i, num_results = 0;
 
   fp = fopen(PROC_PARTITIONS, "re");
   if (!fp) {
@@ -245,8 +358,14 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
+        new_results = realloc(results,
+                              (num_results + 1) * sizeof(*results));
+        if (new_results) {
+          results = new_results;
+          memset(&results[num_results], 0, sizeof(*results));
+          results[num_results].filename = strdup(pathname);
+          if (results[num_results].filename)
+            num_results++;
         }
       }
     }
@@ -256,6 +375,14 @@ static int scan_real_devs(CgptFindParams *params) {
 
   fclose(fp);
 
+  // Search the drives in parallel; there may be many of them.
+  found += search_drives(params, results, num_results);
+  for (i = 0; i < num_results; i++) {
+    free(results[i].filename);
+    free(results[i].matches);
+  }
+  free(results);
+
   fp = fopen(PROC_MTD, "re");
   if (!fp) {
     free(line);
@@ -271,30 +398,15 @@ static int scan_real_devs(CgptFindParams *params) {
                partname, &sz, &erasesz, name) != 4)
       continue;
     if (strcmp(partname, "mtd0") == 0) {
-      char temp_dir[] = "/tmp/cgpt_find.XXXXXX";
-      if (params->drive_size == 0) {
-        if (GetMtdSize("/dev/mtd0", &params->drive_size) != 0) {
-          perror("GetMtdSize");
-          goto cleanup;
-        }
-      }
-      if (ReadNorFlash(temp_dir) != 0) {
-        perror("ReadNorFlash");
-        goto cleanup;
-      }
-      char nor_file[64];
-      if (snprintf(nor_file, sizeof(nor_file), "%s/rw_gpt", temp_dir) > 0) {
-        params->show_fn = chromeos_mtd_show;
-        if (do_search(params, nor_file)) {
-          found++;
-        }
-        params->show_fn = NULL;
+      // DriveOpen() reads the GPT from the RW_GPT section of NOR flash.
+      params->show_fn = chromeos_mtd_show;
+      if (do_search(params, "/dev/mtd0")) {
+        found++;
       }
-      RemoveDir(temp_dir);
+      params->show_fn = NULL;
       break;
     }
   }
-cleanup:
   fclose(fp);
   free(line);
   return found;
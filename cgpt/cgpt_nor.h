@@ -2,33 +2,34 @@
  * Use of this source code is governed by a BSD-style license that can be
  * found in the LICENSE file.
  *
- * This module provides some utility functions to use "flashrom" to read from
- * and write to NOR flash.
+ * This module provides some utility functions to use "flashrom" to read the
+ * GPT from NOR flash into memory and to write it back.
  */
 
 #ifndef VBOOT_REFERENCE_CGPT_NOR_H_
 #define VBOOT_REFERENCE_CGPT_NOR_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 // Obtain the MTD size from its sysfs node. |mtd_device| should point to
 // a dev node such as /dev/mtd0. This function returns 0 on success.
 int GetMtdSize(const char *mtd_device, uint64_t *size);
 
-// Exec |argv| in |cwd|. Return -1 on error, or exit code on success. |argv|
-// must be terminated with a NULL element as is required by execv().
-int ForkExecV(const char *cwd, const char *const argv[]);
-
-// Similar to ForkExecV but with a vararg instead of an array of pointers.
-int ForkExecL(const char *cwd, const char *cmd, ...);
-
-// Exec "rm" to remove |dir|.
-int RemoveDir(const char *dir);
-
-// Read RW_GPT from NOR flash to "rw_gpt" in a temp dir |temp_dir_template|.
-// |temp_dir_template| is passed to mkdtemp() so it must satisfy all
-// requirements by mkdtemp().
-int ReadNorFlash(char *temp_dir_template);
-
-// Write "rw_gpt" back to NOR flash. We write the file in two parts for safety.
-int WriteNorFlash(const char *dir);
+// Check if |device_path| is an MTD character device.
+bool IsMtd(const char *device_path);
+
+// Read RW_GPT from NOR flash into a buffer allocated in |*data|, and the FMAP
+// of the flash into one allocated in |*fmap|, which the caller must free. This
+// function returns 0 on success.
+int ReadNorFlash(uint8_t **data, uint32_t *size,
+                 uint8_t **fmap, uint32_t *fmap_size);
+
+// Write |data| back to NOR flash in two parts for safety, RW_GPT_PRIMARY and
+// RW_GPT_SECONDARY. If |original| holds the RW_GPT contents as read, and
+// |fmap| the FMAP read along with it, only the 512-byte sectors that differ
+// from |original| are written. This function returns 0 on success.
+int WriteNorFlash(const uint8_t *original, uint8_t *data, uint32_t size,
+                  uint8_t *fmap, uint32_t fmap_size);
 
 #endif  /* VBOOT_REFERENCE_CGPT_NOR_H_ */
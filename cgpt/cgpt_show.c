@@ -5,6 +5,7 @@
 
 #define __STDC_FORMAT_MACROS
 
+#include <pthread.h>
 #include <string.h>
 
 #include "cgpt.h"
@@ -178,21 +179,108 @@ static void EntriesDetails(struct drive *drive, const int secondary, int raw) {
   }
 }
 
-static int GptShow(struct drive *drive, CgptShowParams *params) {
-  int gpt_retval;
-  if (GPT_SUCCESS != (gpt_retval = GptValidityCheck(&drive->gpt))) {
-    Error("GptValidityCheck() returned %d: %s\n",
-          gpt_retval, GptError(gpt_retval));
-    return CGPT_FAILED;
+#define SHOW_MAX_THREADS 16
+
+// Prints 's' as a JSON string.
+static void JsonString(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
   }
+  putchar('"');
+}
 
-  if (params->partition) {                      // show single partition
+static void JsonHeader(struct drive *drive, int secondary) {
+  GptHeader *header = (GptHeader *)(secondary ? drive->gpt.secondary_header :
+                                    drive->gpt.primary_header);
+  uint8_t *entries = secondary ? drive->gpt.secondary_entries :
+      drive->gpt.primary_entries;
+  uint32_t mask = secondary ? MASK_SECONDARY : MASK_PRIMARY;
+  char buf[GUID_STRLEN];
+
+  printf("  \"%s\": {\"status\": \"%s\"", secondary ? "secondary" : "primary",
+         (drive->gpt.ignored & mask) ? "ignored" :
+         (drive->gpt.valid_headers & mask) ? "valid" : "invalid");
+  if (!(drive->gpt.valid_headers & mask) || (drive->gpt.ignored & mask)) {
+    printf("},\n");
+    return;
+  }
+  GuidToStr(&header->disk_uuid, buf, sizeof(buf));
+  printf(", \"my_lba\": %" PRIu64 ", \"alternate_lba\": %" PRIu64
+         ", \"first_usable_lba\": %" PRIu64 ", \"last_usable_lba\": %" PRIu64
+         ", \"disk_uuid\": \"%s\", \"entries_lba\": %" PRIu64
+         ", \"number_of_entries\": %u, \"size_of_entry\": %u"
+         ", \"entries_valid\": %s},\n",
+         header->my_lba, header->alternate_lba, header->first_usable_lba,
+         header->last_usable_lba, buf, header->entries_lba,
+         header->number_of_entries, header->size_of_entry,
+         (drive->gpt.valid_entries & mask) &&
+         header->entries_crc32 == Crc32(entries, header->size_of_entry *
+                                        header->number_of_entries) ?
+         "true" : "false");
+}
 
-    if (params->partition > GetNumberOfEntries(drive)) {
-      Error("invalid partition number: %d\n", params->partition);
-      return CGPT_FAILED;
-    }
+static void JsonEntry(GptEntry *entry, uint32_t index, int raw, int *first) {
+  uint8_t label[GPT_PARTNAME_LEN];
+  char type[GUID_STRLEN], type_guid[GUID_STRLEN], unique[GUID_STRLEN];
+  unsigned int attrs = entry->attrs.fields.gpt_att;
 
+  UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
+              label, sizeof(label));
+  GuidToStr(&entry->type, type_guid, sizeof(type_guid));
+  if (raw || CGPT_OK != ResolveType(&entry->type, type))
+    strcpy(type, type_guid);
+  GuidToStr(&entry->unique, unique, sizeof(unique));
+
+  printf("%s    {\"number\": %u, \"start\": %" PRIu64 ", \"size\": %" PRIu64
+         ", \"label\": ", *first ? "" : ",\n", index + 1,
+         entry->starting_lba, entry->ending_lba - entry->starting_lba + 1);
+  JsonString((const char *)label);
+  printf(", \"type\": \"%s\", \"type_guid\": \"%s\", \"unique_guid\": \"%s\""
+         ", \"attributes\": %u, \"priority\": %d, \"tries\": %d"
+         ", \"successful\": %d, \"required\": %d, \"legacy_boot\": %d}",
+         type, type_guid, unique, attrs, GetEntryPriority(entry),
+         GetEntryTries(entry), GetEntrySuccessful(entry),
+         GetEntryRequired(entry), GetEntryLegacyBoot(entry));
+  *first = 0;
+}
+
+// Prints a drive that passed GptValidityCheck() as a JSON object.
+static void GptShowJson(struct drive *drive, const char *name,
+                        CgptShowParams *params) {
+  uint32_t i;
+  GptEntry *entry;
+  int first = 1;
+
+  printf("{\n  \"drive\": ");
+  JsonString(name);
+  printf(",\n  \"size\": %" PRIu64 ",\n  \"sector_bytes\": %u,\n"
+         "  \"drive_sectors\": %" PRIu64 ",\n  \"valid\": %s,\n",
+         drive->size, drive->gpt.sector_bytes, drive->gpt.gpt_drive_sectors,
+         (drive->gpt.valid_headers == MASK_BOTH &&
+          drive->gpt.valid_entries == MASK_BOTH) ? "true" : "false");
+  JsonHeader(drive, 0);
+  JsonHeader(drive, 1);
+  printf("  \"partitions\": [\n");
+  for (i = 0; i < GetNumberOfEntries(drive); i++) {
+    if (params->partition && i != params->partition - 1)
+      continue;
+    entry = GetEntry(&drive->gpt, ANY_VALID, i);
+    if (GuidIsZero(&entry->type))
+      continue;
+    JsonEntry(entry, i, params->numeric, &first);
+  }
+  printf("%s  ]\n}", first ? "" : "\n");
+}
+
+static int GptShowText(struct drive *drive, CgptShowParams *params) {
+  if (params->partition) {                      // show single partition
     uint32_t index = params->partition - 1;
     GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
     char buf[256];                      // scratch buffer for string conversion
@@ -283,6 +371,9 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
         printf("    Drive Size (blocks): %" PRIu64 "\n",
                drive->gpt.gpt_drive_sectors);
       }
+      printf("    GPT Load: %u reads, %" PRIu64 " bytes, %" PRIu64 " us%s\n",
+             drive->io.reads, drive->io.bytes, drive->io.usecs,
+             drive->direct_io ? " (direct I/O)" : "");
       printf("\n");
     }
 
@@ -394,17 +485,152 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
   return CGPT_OK;
 }
 
+// Shows a loaded drive; 'gpt_retval' is the result of GptValidityCheck().
+static int GptShow(struct drive *drive, const char *name, int gpt_retval,
+                   CgptShowParams *params) {
+  if (GPT_SUCCESS != gpt_retval) {
+    Error("GptValidityCheck() returned %d: %s\n",
+          gpt_retval, GptError(gpt_retval));
+    if (params->json) {
+      printf("{\n  \"drive\": ");
+      JsonString(name);
+      printf(",\n  \"error\": ");
+      JsonString(GptError(gpt_retval));
+      printf("\n}");
+    }
+    return CGPT_FAILED;
+  }
+
+  if (params->partition > GetNumberOfEntries(drive)) {
+    Error("invalid partition number: %d\n", params->partition);
+    return CGPT_FAILED;
+  }
+
+  if (params->json) {
+    GptShowJson(drive, name, params);
+    return CGPT_OK;
+  }
+  return GptShowText(drive, params);
+}
+
+// A drive loaded by a worker thread, to be shown by the main thread.
+struct show_drive {
+  const char *name;
+  struct drive drive;
+  int open_retval;
+  int gpt_retval;
+};
+
+struct show_job {
+  CgptShowParams *params;
+  struct show_drive *drives;
+  int num_drives;
+  int next;  // index of the next drive to load, protected by lock
+  pthread_mutex_t lock;
+};
+
+// Open mode for the drives being shown.
+static int ShowOpenMode(const CgptShowParams *params) {
+  int mode = O_RDONLY;
+#ifdef O_DIRECT
+  if (params->direct_io)
+    mode |= O_DIRECT;
+#endif
+  return mode;
+}
+
+static void *ShowWorker(void *arg) {
+  struct show_job *job = arg;
+  struct show_drive *d;
+  int i;
+
+  while (1) {
+    pthread_mutex_lock(&job->lock);
+    i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+    if (i >= job->num_drives)
+      break;
+    d = &job->drives[i];
+    d->open_retval = DriveOpen(d->name, &d->drive,
+                               ShowOpenMode(job->params),
+                               job->params->drive_size);
+    if (d->open_retval == CGPT_OK)
+      d->gpt_retval = GptValidityCheck(&d->drive.gpt);
+  }
+  return NULL;
+}
+
+int CgptShowDrives(CgptShowParams *params, char *const drive_names[],
+                   int num_drives) {
+  pthread_t threads[SHOW_MAX_THREADS];
+  struct show_job job = { params, NULL, num_drives, 0 };
+  struct show_drive *d;
+  int i, num_threads = 0, errors = 0;
+
+  if (params == NULL || num_drives <= 0)
+    return CGPT_FAILED;
+
+  job.drives = calloc(num_drives, sizeof(*job.drives));
+  if (!job.drives)
+    return CGPT_FAILED;
+  for (i = 0; i < num_drives; i++)
+    job.drives[i].name = drive_names[i];
+
+  // Load the drives concurrently; most of the time is spent waiting on I/O.
+  pthread_mutex_init(&job.lock, NULL);
+  while (num_threads < SHOW_MAX_THREADS && num_threads < num_drives - 1) {
+    if (pthread_create(&threads[num_threads], NULL, ShowWorker, &job))
+      break;
+    num_threads++;
+  }
+  ShowWorker(&job);
+  for (i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&job.lock);
+
+  // Then print them in order.
+  if (params->json)
+    printf("[\n");
+  for (i = 0; i < num_drives; i++) {
+    d = &job.drives[i];
+    if (params->json && i)
+      printf(",\n");
+    else if (!params->json)
+      printf("%s%s:\n", i ? "\n" : "", d->name);
+    if (d->open_retval != CGPT_OK) {
+      errors++;
+      if (params->json) {
+        printf("{\n  \"drive\": ");
+        JsonString(d->name);
+        printf(",\n  \"error\": \"cannot open drive\"\n}");
+      }
+      continue;
+    }
+    if (CGPT_OK != GptShow(&d->drive, d->name, d->gpt_retval, params))
+      errors++;
+    DriveClose(&d->drive, 0);
+  }
+  if (params->json)
+    printf("\n]\n");
+
+  free(job.drives);
+  return errors ? CGPT_FAILED : CGPT_OK;
+}
+
 int CgptShow(CgptShowParams *params) {
   struct drive drive;
 
   if (params == NULL)
     return CGPT_FAILED;
 
-  if (CGPT_OK != DriveOpen(params->drive_name, &drive, O_RDONLY,
+  if (CGPT_OK != DriveOpen(params->drive_name, &drive, ShowOpenMode(params),
                            params->drive_size))
     return CGPT_FAILED;
 
-  int ret = GptShow(&drive, params);
+  int ret = GptShow(&drive, params->drive_name,
+                    GptValidityCheck(&drive.gpt), params);
+  if (params->json)
+    printf("\n");
   DriveClose(&drive, 0);
   return ret;
 }
@@ -0,0 +1,197 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+#define MAX_BATCH_ARGS 64
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] DRIVE\n\n"
+         "Run a list of commands on DRIVE, loading the GPT once and writing\n"
+         "all changes at once. If any command fails, nothing is written.\n\n"
+         "Each line of the script is a command with its options, but without\n"
+         "DRIVE, for example \"add -i 2 -P 3\". Empty lines and lines starting\n"
+         "with '#' are ignored. Supported commands are:\n"
+         "  add, create, edit, legacy, prioritize, repair, show\n\n"
+         "Options:\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside;\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE\n"
+         "  -f FILE      Read commands from FILE; default is stdin\n"
+         "\n", progname);
+}
+
+static const struct {
+  const char *name;
+  int (*fp)(int argc, char *argv[]);
+} batch_cmds[] = {
+  {"add", cmd_add},
+  {"create", cmd_create},
+  {"edit", cmd_edit},
+  {"legacy", cmd_legacy},
+  {"prioritize", cmd_prioritize},
+  {"repair", cmd_repair},
+  {"show", cmd_show},
+};
+
+// Splits 'line' in place into words separated by spaces. Words can be quoted
+// with ' or ", and a backslash escapes the next character outside of single
+// quotes. Returns the number of words, or -1 on error.
+static int SplitLine(char *line, char *argv[], int max_args) {
+  char *s = line, *d;
+  int argc = 0;
+  char quote;
+
+  while (1) {
+    while (isspace((unsigned char)*s))
+      s++;
+    if (!*s || *s == '#')
+      return argc;
+    if (argc >= max_args) {
+      Error("too many arguments\n");
+      return -1;
+    }
+
+    argv[argc++] = d = s;
+    quote = 0;
+    for (; *s && (quote || !isspace((unsigned char)*s)); s++) {
+      if (quote && *s == quote) {
+        quote = 0;
+      } else if (!quote && (*s == '\'' || *s == '"')) {
+        quote = *s;
+      } else if (quote != '\'' && *s == '\\' && s[1]) {
+        *d++ = *++s;
+      } else {
+        *d++ = *s;
+      }
+    }
+    if (quote) {
+      Error("unterminated quote\n");
+      return -1;
+    }
+    if (*s)
+      s++;
+    *d = '\0';
+  }
+}
+
+// Runs one line of script on 'drive_name'.
+static int RunLine(char *line, char *drive_name) {
+  char *argv[MAX_BATCH_ARGS + 3];
+  int argc, i;
+
+  // Same layout as the command line: progname, command, options, drive.
+  argc = SplitLine(line, argv + 1, MAX_BATCH_ARGS);
+  if (argc <= 0)
+    return argc;
+
+  for (i = 0; i < ARRAY_COUNT(batch_cmds); i++) {
+    if (!strcmp(argv[1], batch_cmds[i].name))
+      break;
+  }
+  if (i == ARRAY_COUNT(batch_cmds)) {
+    Error("unsupported command in batch: %s\n", argv[1]);
+    return -1;
+  }
+
+  argv[0] = (char *)progname;
+  argv[++argc] = drive_name;
+  argv[++argc] = NULL;
+  optind = 2;
+  return batch_cmds[i].fp(argc, argv) == CGPT_OK ? 0 : -1;
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  uint64_t drive_size = 0;
+  const char *script = NULL;
+  char *drive_name, *line = NULL;
+  size_t line_size = 0;
+  FILE *fp = stdin;
+  int lineno = 0, errors = 0;
+
+  int c;
+  char* e = 0;
+  int errorcnt = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hf:D:")) != -1)
+  {
+    switch (c)
+    {
+    case 'D':
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+    case 'f':
+      script = optarg;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    return CGPT_FAILED;
+  }
+  drive_name = argv[optind];
+
+  if (script && strcmp(script, "-")) {
+    fp = fopen(script, "r");
+    if (!fp) {
+      Error("Can't open %s: %s\n", script, strerror(errno));
+      return CGPT_FAILED;
+    }
+  }
+
+  if (CGPT_OK != DriveBatchBegin(drive_name, drive_size)) {
+    if (fp != stdin)
+      fclose(fp);
+    return CGPT_FAILED;
+  }
+
+  while (getline(&line, &line_size, fp) != -1) {
+    lineno++;
+    if (RunLine(line, drive_name)) {
+      Error("batch failed at line %d, nothing is written\n", lineno);
+      errors++;
+      break;
+    }
+  }
+  free(line);
+  if (fp != stdin)
+    fclose(fp);
+
+  if (CGPT_OK != DriveBatchEnd(!errors))
+    errors++;
+  return errors ? CGPT_FAILED : CGPT_OK;
+}
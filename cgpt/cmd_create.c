@@ -22,6 +22,8 @@ static void Usage(void)
          "  -z           Zero the blocks of the GPT table and entries\n"
          "  -p NUM       Size (in blocks) of the disk to pad between the\n"
          "                 primary GPT header and its entries, default 0\n"
+         "  -n NUM       Number of partition entries, default 128\n"
+         "                 (at most 4096, and at least 128 unless -D is set)\n"
          "\n", progname);
 }
 
@@ -34,7 +36,7 @@ int cmd_create(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hzp:D:")) != -1)
+  while ((c=getopt(argc, argv, ":hzp:n:D:")) != -1)
   {
     switch (c)
     {
@@ -49,6 +51,10 @@ int cmd_create(int argc, char *argv[]) {
       params.padding = strtoull(optarg, &e, 0);
       errorcnt += check_int_parse(c, e);
       break;
+    case 'n':
+      params.entries = strtoul(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
     case 'h':
       Usage();
       return CGPT_OK;
@@ -16,8 +16,9 @@ extern const char* progname;
 
 static void Usage(void)
 {
-  printf("\nUsage: %s show [OPTIONS] DRIVE\n\n"
-         "Display the GPT table.\n\n"
+  printf("\nUsage: %s show [OPTIONS] DRIVE [DRIVE...]\n\n"
+         "Display the GPT table. Several drives are loaded concurrently and\n"
+         "shown in the order given.\n\n"
          "Units are blocks by default.\n\n"
          "Options:\n"
          "  -D NUM       Size (in bytes) of the disk where partitions reside;\n"
@@ -28,6 +29,8 @@ static void Usage(void)
          "  -q           Quick output\n"
          "  -i NUM       Show specified partition only\n"
          "  -d           Debug output (including invalid headers)\n"
+         "  -O           Read the drive with O_DIRECT, bypassing the page cache\n"
+         "  -j, --json   Output in JSON; an array for several drives\n"
          "\n"
          "When using -i, specific fields may be displayed using one of:\n"
          "  -b  first block (a.k.a. start of partition)\n"
@@ -44,8 +47,14 @@ static void Usage(void)
          "\n", progname);
 }
 
+static const struct option long_opts[] = {
+  {"json", 0, NULL, 'j'},
+  {NULL, 0, NULL, 0},
+};
+
 int cmd_show(int argc, char *argv[]) {
   CgptShowParams params;
+  static char outbuf[64 * 1024];
   memset(&params, 0, sizeof(params));
 
   int c;
@@ -53,7 +62,8 @@ int cmd_show(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPRBAdD:")) != -1)
+  while ((c=getopt_long(argc, argv, ":hnvqi:bstulSTPRBAdOjD:", long_opts,
+                        NULL)) != -1)
   {
     switch (c)
     {
@@ -101,6 +111,12 @@ int cmd_show(int argc, char *argv[]) {
     case 'd':
       params.debug = 1;
       break;
+    case 'O':
+      params.direct_io = 1;
+      break;
+    case 'j':
+      params.json = 1;
+      break;
 
     case 'h':
       Usage();
@@ -122,6 +138,10 @@ int cmd_show(int argc, char *argv[]) {
     Error("-i required when displaying a single item\n");
     errorcnt++;
   }
+  if (params.json && params.single_item) {
+    Error("-%c can't be used with --json\n", params.single_item);
+    errorcnt++;
+  }
   if (errorcnt)
   {
     Usage();
@@ -134,6 +154,12 @@ int cmd_show(int argc, char *argv[]) {
     return CGPT_FAILED;
   }
 
+  if (argc - optind > 1) {
+    // Output for many drives goes out in large writes.
+    setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+    return CgptShowDrives(&params, argv + optind, argc - optind);
+  }
+
   params.drive_name = argv[optind];
 
   return CgptShow(&params);
@@ -17,7 +17,7 @@
 #include "2tpm_bootmode.h"
 #include "vb2_common.h"
 
-vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
+static vb2_error_t fw_phase1(struct vb2_context *ctx)
 {
 	vb2_error_t rv;
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -109,7 +109,16 @@ vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
+vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = fw_phase1(ctx);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_PHASE1, start_ms);
+	return rv;
+}
+
+static vb2_error_t fw_phase2(struct vb2_context *ctx)
 {
 	/*
 	 * Use the slot from the last boot if this is a resume.  Do not set
@@ -142,28 +151,63 @@ vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = fw_phase2(ctx);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_PHASE2, start_ms);
+	return rv;
+}
+
 vb2_error_t vb2api_extend_hash(struct vb2_context *ctx,
 		       const void *buf,
 		       uint32_t size)
+{
+	struct vb2_hash_segment seg = { .buf = buf, .size = size };
+
+	return vb2api_extend_hash_sg(ctx, &seg, 1);
+}
+
+vb2_error_t vb2api_extend_hash_sg(struct vb2_context *ctx,
+				  const struct vb2_hash_segment *segs,
+				  uint32_t count)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_digest_context *dc = (struct vb2_digest_context *)
 		vb2_member_of(sd, sd->hash_offset);
+	uint32_t total = 0;
+	uint32_t start_ms;
+	uint32_t i;
+	vb2_error_t rv = VB2_SUCCESS;
 
 	/* Must have initialized hash digest work area */
 	if (!sd->hash_size)
 		return VB2_ERROR_API_EXTEND_HASH_WORKBUF;
 
 	/* Don't extend past the data we expect to hash */
-	if (!size || size > sd->hash_remaining_size)
+	for (i = 0; i < count; i++) {
+		if (segs[i].size > sd->hash_remaining_size - total)
+			return VB2_ERROR_API_EXTEND_HASH_SIZE;
+		total += segs[i].size;
+	}
+	if (!total)
 		return VB2_ERROR_API_EXTEND_HASH_SIZE;
 
-	sd->hash_remaining_size -= size;
+	sd->hash_remaining_size -= total;
 
-	if (dc->using_hwcrypto)
-		return vb2ex_hwcrypto_digest_extend(buf, size);
-	else
-		return vb2_digest_extend(dc, buf, size);
+	start_ms = vb2ex_mtime();
+	if (dc->using_hwcrypto) {
+		for (i = 0; i < count && rv == VB2_SUCCESS; i++) {
+			if (segs[i].size)
+				rv = vb2ex_hwcrypto_digest_extend(
+					segs[i].buf, segs[i].size);
+		}
+	} else {
+		rv = vb2_digest_extend_sg(dc, segs, count);
+	}
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_BODY, start_ms);
+	return rv;
 }
 
 vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
@@ -199,17 +243,35 @@ vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
+static vb2_error_t fw_phase3(struct vb2_context *ctx)
 {
+	uint32_t start_ms;
+	vb2_error_t rv;
+
 	/* Verify firmware keyblock */
-	VB2_TRY(vb2_load_fw_keyblock(ctx), ctx, VB2_RECOVERY_RO_INVALID_RW);
+	start_ms = vb2ex_mtime();
+	rv = vb2_load_fw_keyblock(ctx);
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_KEYBLOCK, start_ms);
+	VB2_TRY(rv, ctx, VB2_RECOVERY_RO_INVALID_RW);
 
 	/* Verify firmware preamble */
-	VB2_TRY(vb2_load_fw_preamble(ctx), ctx, VB2_RECOVERY_RO_INVALID_RW);
+	start_ms = vb2ex_mtime();
+	rv = vb2_load_fw_preamble(ctx);
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_PREAMBLE, start_ms);
+	VB2_TRY(rv, ctx, VB2_RECOVERY_RO_INVALID_RW);
 
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = fw_phase3(ctx);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_PHASE3, start_ms);
+	return rv;
+}
+
 vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -297,7 +359,7 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 	return vb2_digest_init(dc, key.hash_alg);
 }
 
-vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
+static vb2_error_t check_hash_get_digest(struct vb2_context *ctx,
 					 void *digest_out,
 					 uint32_t digest_out_size)
 {
@@ -373,6 +435,18 @@ vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
+					 void *digest_out,
+					 uint32_t digest_out_size)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = check_hash_get_digest(ctx, digest_out,
+					       digest_out_size);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_BODY, start_ms);
+	return rv;
+}
+
 int vb2api_check_hash(struct vb2_context *ctx)
 {
 	return vb2api_check_hash_get_digest(ctx, NULL, 0);
@@ -82,7 +82,7 @@ static vb2_error_t auxfw_sync_check_update(struct vb2_context *ctx,
 	return vb2ex_auxfw_check(severity);
 }
 
-vb2_error_t vb2api_auxfw_sync(struct vb2_context *ctx)
+static vb2_error_t auxfw_sync(struct vb2_context *ctx)
 {
 	enum vb2_auxfw_update_severity fw_update = VB2_AUXFW_NO_UPDATE;
 
@@ -101,3 +101,12 @@ vb2_error_t vb2api_auxfw_sync(struct vb2_context *ctx)
 
 	return vb2ex_auxfw_finalize(ctx);
 }
+
+vb2_error_t vb2api_auxfw_sync(struct vb2_context *ctx)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = auxfw_sync(ctx);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_AUXFW_SYNC, start_ms);
+	return rv;
+}
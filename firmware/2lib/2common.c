@@ -60,11 +60,16 @@ void vb2_workbuf_init(struct vb2_workbuf *wb, uint8_t *buf, uint32_t size)
 	/* Align the buffer so allocations will be aligned */
 	if (vb2_align(&wb->buf, &wb->size, VB2_WORKBUF_ALIGN, 0))
 		wb->size = 0;
+
+	/* No high-water mark unless the caller asks for one */
+	wb->peak_base = wb->buf;
+	wb->peak = NULL;
 }
 
-void *vb2_workbuf_alloc(struct vb2_workbuf *wb, uint32_t size)
+void *(vb2_workbuf_alloc)(struct vb2_workbuf *wb, uint32_t size)
 {
 	uint8_t *ptr = wb->buf;
+	uint32_t used;
 
 	/* Round up size to work buffer alignment */
 	size = vb2_wb_round_up(size);
@@ -75,11 +80,17 @@ void *vb2_workbuf_alloc(struct vb2_workbuf *wb, uint32_t size)
 	wb->buf += size;
 	wb->size -= size;
 
+	if (wb->peak) {
+		used = vb2_offset_of(wb->peak_base, wb->buf);
+		if (used > *wb->peak)
+			*wb->peak = used;
+	}
+
 	return ptr;
 }
 
-void *vb2_workbuf_realloc(struct vb2_workbuf *wb, uint32_t oldsize,
-			  uint32_t newsize)
+void *(vb2_workbuf_realloc)(struct vb2_workbuf *wb, uint32_t oldsize,
+			    uint32_t newsize)
 {
 	/*
 	 * Just free and allocate to update the size.  No need to move/copy
@@ -87,7 +98,7 @@ void *vb2_workbuf_realloc(struct vb2_workbuf *wb, uint32_t oldsize,
 	 * old one.  The new allocation can fail, if the new size is too big.
 	 */
 	vb2_workbuf_free(wb, oldsize);
-	return vb2_workbuf_alloc(wb, newsize);
+	return (vb2_workbuf_alloc)(wb, newsize);
 }
 
 void vb2_workbuf_free(struct vb2_workbuf *wb, uint32_t size)
@@ -99,6 +110,55 @@ void vb2_workbuf_free(struct vb2_workbuf *wb, uint32_t size)
 	wb->size += size;
 }
 
+#if WORKBUF_PROFILE
+static struct vb2_workbuf_site workbuf_sites[VB2_WORKBUF_PROFILE_SITES];
+
+static void workbuf_record(const char *func, uint32_t size)
+{
+	struct vb2_workbuf_site *site;
+	int i;
+
+	for (i = 0; i < VB2_WORKBUF_PROFILE_SITES; i++) {
+		site = workbuf_sites + i;
+		if (!site->func)
+			site->func = func;
+		else if (strcmp(site->func, func))
+			continue;
+
+		site->count++;
+		if (size > site->max_size)
+			site->max_size = size;
+		return;
+	}
+
+	/* Table full; drop the allocation rather than misattribute it */
+}
+
+void *vb2_workbuf_alloc_at(struct vb2_workbuf *wb, uint32_t size,
+			   const char *func)
+{
+	workbuf_record(func, size);
+	return (vb2_workbuf_alloc)(wb, size);
+}
+
+void *vb2_workbuf_realloc_at(struct vb2_workbuf *wb, uint32_t oldsize,
+			     uint32_t newsize, const char *func)
+{
+	workbuf_record(func, newsize);
+	return (vb2_workbuf_realloc)(wb, oldsize, newsize);
+}
+
+const struct vb2_workbuf_site *vb2_workbuf_get_sites(void)
+{
+	return workbuf_sites;
+}
+
+void vb2_workbuf_clear_sites(void)
+{
+	memset(workbuf_sites, 0, sizeof(workbuf_sites));
+}
+#endif
+
 ptrdiff_t vb2_offset_of(const void *base, const void *ptr)
 {
 	return (uintptr_t)ptr - (uintptr_t)base;
@@ -188,13 +248,28 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 			    struct vb2_signature *sig,
 			    const struct vb2_public_key *key,
 			    const struct vb2_workbuf *wb)
+{
+	struct vb2_hash_segment seg = { .buf = data, .size = size };
+
+	return vb2_verify_data_sg(&seg, 1, sig, key, wb);
+}
+
+vb2_error_t vb2_verify_data_sg(const struct vb2_hash_segment *segs,
+			       uint32_t count, struct vb2_signature *sig,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb)
 {
 	struct vb2_workbuf wblocal = *wb;
 	struct vb2_digest_context *dc;
 	uint8_t *digest;
 	uint32_t digest_size;
+	uint32_t remaining = sig->data_size;
+	uint32_t size;
+	uint32_t i;
 
-	if (sig->data_size > size) {
+	for (i = 0; i < count && remaining; i++)
+		remaining -= VB2_MIN(segs[i].size, remaining);
+	if (remaining) {
 		VB2_DEBUG("Data buffer smaller than length of signed data.\n");
 		return VB2_ERROR_VDATA_NOT_ENOUGH_DATA;
 	}
@@ -213,8 +288,15 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 	if (!dc)
 		return VB2_ERROR_VDATA_WORKBUF_HASHING;
 
+	/* Hash the signed data, which may end partway through a segment */
 	VB2_TRY(vb2_digest_init(dc, key->hash_alg));
-	VB2_TRY(vb2_digest_extend(dc, data, sig->data_size));
+	remaining = sig->data_size;
+	for (i = 0; i < count && remaining; i++) {
+		size = VB2_MIN(segs[i].size, remaining);
+		if (size)
+			VB2_TRY(vb2_digest_extend(dc, segs[i].buf, size));
+		remaining -= size;
+	}
 	VB2_TRY(vb2_digest_finalize(dc, digest, digest_size));
 
 	vb2_workbuf_free(&wblocal, sizeof(*dc));
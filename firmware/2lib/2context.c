@@ -15,12 +15,18 @@ void vb2_workbuf_from_ctx(struct vb2_context *ctx, struct vb2_workbuf *wb)
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	vb2_workbuf_init(wb, (void *)sd + sd->workbuf_used,
 			 sd->workbuf_size - sd->workbuf_used);
+
+	/* Track the high-water mark of the whole context work buffer */
+	wb->peak_base = (void *)sd;
+	wb->peak = &sd->workbuf_peak;
 }
 
 void vb2_set_workbuf_used(struct vb2_context *ctx, uint32_t used)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	sd->workbuf_used = vb2_wb_round_up(used);
+	if (sd->workbuf_used > sd->workbuf_peak)
+		sd->workbuf_peak = sd->workbuf_used;
 }
 
 vb2_error_t vb2api_init(void *workbuf, uint32_t size,
@@ -44,6 +50,7 @@ vb2_error_t vb2api_init(void *workbuf, uint32_t size,
 	sd->struct_version_minor = VB2_SHARED_DATA_VERSION_MINOR;
 	sd->workbuf_size = size;
 	sd->workbuf_used = vb2_wb_round_up(sizeof(*sd));
+	sd->workbuf_peak = sd->workbuf_used;
 
 	*ctxptr = &sd->ctx;
 	return VB2_SUCCESS;
@@ -120,6 +120,55 @@ static vb2_error_t check_ec_hash(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+/**
+ * Update the specified EC one block at a time, rewriting only the blocks
+ * which don't match their expected hashes, and verifying each as it is
+ * written.
+ *
+ * @param ctx		Vboot2 context
+ * @param select	Which firmware image to update
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if there are no expected
+ * block hashes, or other non-zero error code.
+ */
+static vb2_error_t update_ec_blocks(struct vb2_context *ctx,
+				    enum vb2_firmware_selection select)
+{
+	const uint8_t *hexp;
+	const uint8_t *heff;
+	int heff_len;
+	uint32_t block_size, block_count, updated = 0;
+	uint32_t i;
+
+	VB2_TRY(vb2ex_ec_get_expected_block_hashes(select, &hexp, &block_size,
+						   &block_count));
+	if (!hexp || !block_size || !block_count) {
+		VB2_DEBUG("Invalid block hashes for %s\n",
+			  image_name_to_string(select));
+		return VB2_ERROR_EC_BLOCK_HASHES;
+	}
+
+	for (i = 0; i < block_count; i++, hexp += VB2_SHA256_DIGEST_SIZE) {
+		VB2_TRY(vb2ex_ec_hash_block(select, i, &heff, &heff_len));
+		if (heff_len == VB2_SHA256_DIGEST_SIZE &&
+		    !vb2_safe_memcmp(heff, hexp, VB2_SHA256_DIGEST_SIZE))
+			continue;
+
+		VB2_TRY(vb2ex_ec_update_block(select, i));
+		updated++;
+
+		VB2_TRY(vb2ex_ec_hash_block(select, i, &heff, &heff_len));
+		if (heff_len != VB2_SHA256_DIGEST_SIZE ||
+		    vb2_safe_memcmp(heff, hexp, VB2_SHA256_DIGEST_SIZE)) {
+			VB2_DEBUG("Block %u still differs after update\n", i);
+			return VB2_ERROR_EC_BLOCK_VERIFY;
+		}
+	}
+
+	VB2_DEBUG("Updated %u of %u blocks of %u bytes\n",
+		  updated, block_count, block_size);
+	return VB2_SUCCESS;
+}
+
 /**
  * Update the specified EC and verify the update succeeded
  *
@@ -131,9 +180,13 @@ static vb2_error_t update_ec(struct vb2_context *ctx,
 			     enum vb2_firmware_selection select)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	vb2_error_t rv;
 
 	VB2_DEBUG("Updating %s...\n", image_name_to_string(select));
-	VB2_TRY(vb2ex_ec_update_image(select), ctx, VB2_RECOVERY_EC_UPDATE);
+	rv = update_ec_blocks(ctx, select);
+	if (rv == VB2_ERROR_EX_UNIMPLEMENTED)
+		rv = vb2ex_ec_update_image(select);
+	VB2_TRY(rv, ctx, VB2_RECOVERY_EC_UPDATE);
 
 	/* Verify the EC was updated properly */
 	sd->flags &= ~SYNC_FLAG(select);
@@ -334,7 +387,7 @@ static vb2_error_t ec_sync_phase2(struct vb2_context *ctx)
 	return sync_ec(ctx);
 }
 
-vb2_error_t vb2api_ec_sync(struct vb2_context *ctx)
+static vb2_error_t ec_sync(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 
@@ -370,3 +423,12 @@ vb2_error_t vb2api_ec_sync(struct vb2_context *ctx)
 
 	return VB2_SUCCESS;
 }
+
+vb2_error_t vb2api_ec_sync(struct vb2_context *ctx)
+{
+	uint32_t start_ms = vb2ex_mtime();
+	vb2_error_t rv = ec_sync(ctx);
+
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_EC_SYNC, start_ms);
+	return rv;
+}
@@ -49,6 +49,12 @@ uint32_t vb2api_get_firmware_size(struct vb2_context *ctx)
 	return pre->body_signature.data_size;
 }
 
+void vb2_add_boot_time(struct vb2_context *ctx, enum vb2_boot_time phase,
+		       uint32_t start_ms)
+{
+	vb2_get_sd(ctx)->boot_time_ms[phase] += vb2ex_mtime() - start_ms;
+}
+
 test_mockable
 vb2_error_t vb2_read_gbb_header(struct vb2_context *ctx,
 				struct vb2_gbb_header *gbb)
@@ -496,9 +502,16 @@ void vb2api_export_vbsd(struct vb2_context *ctx, void *dest)
 		vbsd->firmware_index = 0xff;
 	else
 		vbsd->firmware_index = sd->fw_slot;
+
+	memcpy(vbsd->boot_time_ms, sd->boot_time_ms,
+	       sizeof(vbsd->boot_time_ms));
 }
 _Static_assert(VB2_VBSD_SIZE == sizeof(VbSharedDataHeader),
 	       "VB2_VBSD_SIZE incorrect");
+_Static_assert(VB2_BOOT_TIME_COUNT == VBSD_BOOT_TIME_COUNT &&
+	       VB2_BOOT_TIME_KERNEL_PART == VBSD_BOOT_TIME_KERNEL_PART &&
+	       VB2_BOOT_TIME_LOAD_KERNEL == VBSD_BOOT_TIME_LOAD_KERNEL,
+	       "VBSD_BOOT_TIME_* do not match enum vb2_boot_time");
 
 int vb2api_phone_recovery_enabled(struct vb2_context *ctx)
 {
@@ -680,6 +693,19 @@ char *vb2api_get_debug_info(struct vb2_context *ctx)
 	/* Add GBB flags */
 	DEBUG_INFO_APPEND("\ngbb.flags: %#.8x", gbb->flags);
 
+	/* Add work buffer usage, before reading keys below adds to it */
+	DEBUG_INFO_APPEND("\nworkbuf: used=%#x peak=%#x size=%#x",
+			  sd->workbuf_used, sd->workbuf_peak, sd->workbuf_size);
+#if WORKBUF_PROFILE
+	{
+		const struct vb2_workbuf_site *site = vb2_workbuf_get_sites();
+		for (i = 0; i < VB2_WORKBUF_PROFILE_SITES && site[i].func; i++)
+			DEBUG_INFO_APPEND("\n  %s: %u allocs, max %#x",
+					  site[i].func, site[i].count,
+					  site[i].max_size);
+	}
+#endif
+
 	/* Add sha1sum for Root & Recovery keys */
 	{
 		struct vb2_packed_key *key;
@@ -112,6 +112,21 @@ vb2_error_t vb2_digest_extend(struct vb2_digest_context *dc, const uint8_t *buf,
 	}
 }
 
+vb2_error_t vb2_digest_extend_sg(struct vb2_digest_context *dc,
+				 const struct vb2_hash_segment *segs,
+				 uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (segs[i].size)
+			VB2_TRY(vb2_digest_extend(dc, segs[i].buf,
+						  segs[i].size));
+	}
+
+	return VB2_SUCCESS;
+}
+
 test_mockable
 vb2_error_t vb2_digest_finalize(struct vb2_digest_context *dc, uint8_t *digest,
 				uint32_t digest_size)
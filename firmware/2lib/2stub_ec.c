@@ -0,0 +1,32 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Stub implementations of optional EC sync APIs, which may be implemented by
+ * the caller.
+ */
+
+#include "2api.h"
+
+__attribute__((weak))
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *block_size, uint32_t *block_count)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_ec_hash_block(enum vb2_firmware_selection select,
+				uint32_t block, const uint8_t **hash,
+				int *hash_size)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;  /* Should not be called. */
+}
+
+__attribute__((weak))
+vb2_error_t vb2ex_ec_update_block(enum vb2_firmware_selection select,
+				  uint32_t block)
+{
+	return VB2_ERROR_EX_UNIMPLEMENTED;  /* Should not be called. */
+}
@@ -659,6 +659,23 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag);
 vb2_error_t vb2api_extend_hash(struct vb2_context *ctx, const void *buf,
 			       uint32_t size);
 
+/**
+ * Extend the hash started by vb2api_init_hash() with a list of segments.
+ *
+ * Same as calling vb2api_extend_hash() on each segment in order, but lets
+ * the caller hash data which is scattered in memory (e.g. a body split over
+ * several flash mappings) without copying it into one buffer first.  Empty
+ * segments are skipped, but the segments must not all be empty.
+ *
+ * @param ctx		Vboot context
+ * @param segs		Segments of data to hash
+ * @param count		Number of segments
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2api_extend_hash_sg(struct vb2_context *ctx,
+				  const struct vb2_hash_segment *segs,
+				  uint32_t count);
+
 /**
  * Check the hash value started by vb2api_init_hash().
  *
@@ -1266,6 +1283,50 @@ vb2_error_t vb2ex_ec_get_expected_image_hash(enum vb2_firmware_selection select,
  */
 vb2_error_t vb2ex_ec_update_image(enum vb2_firmware_selection select);
 
+/**
+ * Get the expected SHA-256 hashes of each block of the selected EC image.
+ *
+ * Optional.  If implemented, EC sync updates the image one block at a time
+ * with vb2ex_ec_hash_block() and vb2ex_ec_update_block(), instead of calling
+ * vb2ex_ec_update_image().  Only the blocks which differ are written, so an
+ * update after a small change is quick, and an interrupted update resumes
+ * where it stopped on the next boot.  The hash of the whole image is still
+ * checked afterwards.
+ *
+ * @param select	Image to get expected hashes for (RO or RW).
+ * @param hashes	Pointer to block_count consecutive SHA-256 hashes.
+ * @param block_size	Pointer to the size of each block in bytes.
+ * @param block_count	Pointer to the number of blocks.
+ * @return VB2_SUCCESS, VB2_ERROR_EX_UNIMPLEMENTED if there are no block
+ * hashes for the image, or other error code on error.
+ */
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *block_size, uint32_t *block_count);
+
+/**
+ * Read the SHA-256 hash of one block of the selected EC image.
+ *
+ * @param select	Image to get hash of (RO or RW).
+ * @param block		Index of the block.
+ * @param hash		Pointer to the hash.
+ * @param hash_size	Pointer to the hash size (in bytes).
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_ec_hash_block(enum vb2_firmware_selection select,
+				uint32_t block, const uint8_t **hash,
+				int *hash_size);
+
+/**
+ * Update one block of the selected EC image to the expected version.
+ *
+ * @param select	Image to update (RO or RW).
+ * @param block		Index of the block.
+ * @return VB2_SUCCESS, or error code on error.
+ */
+vb2_error_t vb2ex_ec_update_block(enum vb2_firmware_selection select,
+				  uint32_t block);
+
 /**
  * Lock the EC code to prevent updates until the EC is rebooted.
  * Subsequent calls to vb2ex_ec_update_image() with the same region this
@@ -109,6 +109,14 @@ static inline uint32_t vb2_wb_round_up(uint32_t v)
 struct vb2_workbuf {
 	uint8_t *buf;
 	uint32_t size;
+
+	/*
+	 * High-water mark to raise on each allocation, or NULL.  It holds the
+	 * largest offset from peak_base which has been allocated, and is
+	 * shared by every copy of the work buffer.
+	 */
+	uint8_t *peak_base;
+	uint32_t *peak;
 };
 
 /**
@@ -167,6 +175,49 @@ void *vb2_workbuf_realloc(struct vb2_workbuf *wb, uint32_t oldsize,
  */
 void vb2_workbuf_free(struct vb2_workbuf *wb, uint32_t size);
 
+#if WORKBUF_PROFILE
+/* Number of allocating functions recorded by the work buffer profiler */
+#define VB2_WORKBUF_PROFILE_SITES 32
+
+/* Work buffer allocations made by one function */
+struct vb2_workbuf_site {
+	/* Name of the function, or NULL if the entry is unused */
+	const char *func;
+
+	/* Number of allocations, and size of the largest one in bytes */
+	uint32_t count;
+	uint32_t max_size;
+};
+
+void *vb2_workbuf_alloc_at(struct vb2_workbuf *wb, uint32_t size,
+			   const char *func);
+void *vb2_workbuf_realloc_at(struct vb2_workbuf *wb, uint32_t oldsize,
+			     uint32_t newsize, const char *func);
+
+/*
+ * When profiling, record each allocation against the function making it.
+ * vb2_workbuf_alloc() and vb2_workbuf_realloc() themselves are defined with
+ * their names in parentheses, which keeps these macros from applying.
+ */
+#define vb2_workbuf_alloc(wb, size) \
+	vb2_workbuf_alloc_at(wb, size, __func__)
+#define vb2_workbuf_realloc(wb, oldsize, newsize) \
+	vb2_workbuf_realloc_at(wb, oldsize, newsize, __func__)
+
+/**
+ * Get the work buffer allocations recorded so far.
+ *
+ * @return An array of VB2_WORKBUF_PROFILE_SITES entries, in the order the
+ * functions first allocated.
+ */
+const struct vb2_workbuf_site *vb2_workbuf_get_sites(void);
+
+/**
+ * Forget the work buffer allocations recorded so far.
+ */
+void vb2_workbuf_clear_sites(void);
+#endif
+
 /* Check if a pointer is aligned on an align-byte boundary */
 #define vb2_aligned(ptr, align) (!(((uintptr_t)(ptr)) & ((align) - 1)))
 
@@ -380,6 +431,24 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 			    const struct vb2_public_key *key,
 			    const struct vb2_workbuf *wb);
 
+/**
+ * Verify data scattered over a list of segments matches signature.
+ *
+ * Like vb2_verify_data(), but the signed data is the first sig->data_size
+ * bytes of the segments taken in order, so it need not be contiguous.
+ *
+ * @param segs		Segments of data to verify
+ * @param count		Number of segments
+ * @param sig		Signature of data (destroyed in process)
+ * @param key		Key to use to validate signature
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_verify_data_sg(const struct vb2_hash_segment *segs,
+			       uint32_t count, struct vb2_signature *sig,
+			       const struct vb2_public_key *key,
+			       const struct vb2_workbuf *wb);
+
 /**
  * Check the validity of a keyblock structure.
  *
@@ -66,6 +66,16 @@ void vb2_workbuf_from_ctx(struct vb2_context *ctx, struct vb2_workbuf *wb);
  */
 void vb2_set_workbuf_used(struct vb2_context *ctx, uint32_t used);
 
+/**
+ * Add the time elapsed since a start time to a boot phase.
+ *
+ * @param ctx		Vboot context
+ * @param phase		Boot phase; see enum vb2_boot_time
+ * @param start_ms	Value of vb2ex_mtime() at the start
+ */
+void vb2_add_boot_time(struct vb2_context *ctx, enum vb2_boot_time phase,
+		       uint32_t start_ms);
+
 /**
  * Read the GBB header.
  *
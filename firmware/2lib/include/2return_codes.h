@@ -607,6 +607,12 @@ enum vb2_return_code {
 	/* Escape from NO_BOOT mode is detected. */
 	VB2_ERROR_ESCAPE_NO_BOOT,
 
+	/* Invalid expected EC block hashes in update_ec_blocks() */
+	VB2_ERROR_EC_BLOCK_HASHES,
+
+	/* EC block doesn't match its expected hash after update_ec_blocks() */
+	VB2_ERROR_EC_BLOCK_VERIFY,
+
 	/**********************************************************************
 	 * API-level errors
 	 */
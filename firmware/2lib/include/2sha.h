@@ -106,6 +106,15 @@ struct vb2_digest_context {
 	int using_hwcrypto;
 };
 
+/*
+ * One segment of data to hash, for hashing data which is not contiguous in
+ * memory without copying it together first.
+ */
+struct vb2_hash_segment {
+	const void *buf;
+	uint32_t size;
+};
+
 /*
  * Serializable data structure that can store any vboot hash. Layout used in
  * CBFS attributes that need to be backwards-compatible -- do not change!
@@ -226,6 +235,18 @@ vb2_error_t vb2_digest_init(struct vb2_digest_context *dc,
 vb2_error_t vb2_digest_extend(struct vb2_digest_context *dc, const uint8_t *buf,
 			      uint32_t size);
 
+/**
+ * Extend a digest's hash with a list of segments of data, in order.
+ *
+ * @param dc		Digest context
+ * @param segs		Segments to hash
+ * @param count		Number of segments
+ * @return VB2_SUCCESS, or non-zero on error.
+ */
+vb2_error_t vb2_digest_extend_sg(struct vb2_digest_context *dc,
+				 const struct vb2_hash_segment *segs,
+				 uint32_t count);
+
 /**
  * Finalize a digest and store the result.
  *
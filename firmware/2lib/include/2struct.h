@@ -21,6 +21,9 @@
 #include "2crypto.h"
 #include "2sysincludes.h"
 
+/* Number of kernel partitions timed in vb2_shared_data.boot_time_ms[] */
+#define VB2_BOOT_TIME_KERNEL_PARTS 4
+
 /* Flags for vb2_shared_data.flags */
 enum vb2_shared_data_flags {
 	/* User has explicitly and physically requested recovery */
@@ -87,12 +90,43 @@ enum vb2_shared_data_status {
 
 };
 
+/* Boot phases timed in vb2_shared_data.boot_time_ms[] */
+enum vb2_boot_time {
+	/* vb2api_fw_phase1(), vb2api_fw_phase2() and vb2api_fw_phase3() */
+	VB2_BOOT_TIME_FW_PHASE1 = 0,
+	VB2_BOOT_TIME_FW_PHASE2,
+	VB2_BOOT_TIME_FW_PHASE3,
+
+	/* Firmware keyblock and preamble verification, part of phase 3 */
+	VB2_BOOT_TIME_FW_KEYBLOCK,
+	VB2_BOOT_TIME_FW_PREAMBLE,
+
+	/* Hashing and verifying the firmware body */
+	VB2_BOOT_TIME_FW_BODY,
+
+	/* vb2api_ec_sync() and vb2api_auxfw_sync() */
+	VB2_BOOT_TIME_EC_SYNC,
+	VB2_BOOT_TIME_AUXFW_SYNC,
+
+	/* All LoadKernel() calls */
+	VB2_BOOT_TIME_LOAD_KERNEL,
+
+	/*
+	 * Loading and verifying each of the first kernel partitions tried by
+	 * the last LoadKernel() call.
+	 */
+	VB2_BOOT_TIME_KERNEL_PART,
+
+	VB2_BOOT_TIME_COUNT =
+		VB2_BOOT_TIME_KERNEL_PART + VB2_BOOT_TIME_KERNEL_PARTS,
+};
+
 /* "V2SD" = vb2_shared_data.magic */
 #define VB2_SHARED_DATA_MAGIC 0x44533256
 
 /* Current version of vb2_shared_data struct */
 #define VB2_SHARED_DATA_VERSION_MAJOR 3
-#define VB2_SHARED_DATA_VERSION_MINOR 0
+#define VB2_SHARED_DATA_VERSION_MINOR 2
 
 /* MAX_SIZE should not be changed without bumping up DATA_VERSION_MAJOR. */
 #define VB2_CONTEXT_MAX_SIZE 384
@@ -249,6 +283,26 @@ struct vb2_shared_data {
 	 */
 	uint32_t kernel_key_offset;
 	uint32_t kernel_key_size;
+
+	/**********************************************************************
+	 * Fields added in minor version 1.
+	 */
+
+	/*
+	 * Time spent in each boot phase in milliseconds, as measured by
+	 * vb2ex_mtime(); see enum vb2_boot_time.
+	 */
+	uint32_t boot_time_ms[VB2_BOOT_TIME_COUNT];
+
+	/**********************************************************************
+	 * Fields added in minor version 2.
+	 */
+
+	/*
+	 * Most work buffer ever in use, in bytes, counting both workbuf_used
+	 * and temporary allocations from vb2_workbuf_from_ctx().
+	 */
+	uint32_t workbuf_peak;
 } __attribute__((packed));
 
 /****************************************************************************/
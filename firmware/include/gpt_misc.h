@@ -69,6 +69,9 @@ enum {
 /* If this bit is 1, the GPT is stored in another from the streaming data */
 #define GPT_FLAG_EXTERNAL	0x1
 
+/* Kernels GptInit() can list for GptNextKernelEntry(); more means a rescan */
+#define GPT_MAX_KERNEL_CANDIDATES 16
+
 /*
  * A note about stored_on_device and gpt_drive_sectors:
  *
@@ -114,6 +117,17 @@ typedef struct {
 	/* Internal variables */
 	uint8_t valid_headers, valid_entries, ignored;
 	int current_priority;
+	/*
+	 * Kernel entries that can be tried, by descending priority and then by
+	 * index, as found by GptInit().  Only used if kernel_candidates_valid
+	 * is set; otherwise GptNextKernelEntry() scans all entries.
+	 */
+	struct {
+		uint16_t index;
+		uint8_t priority;
+	} kernel_candidates[GPT_MAX_KERNEL_CANDIDATES];
+	uint8_t num_kernel_candidates, next_kernel_candidate;
+	uint8_t kernel_candidates_valid;
 } GptData;
 
 /**
@@ -11,6 +11,48 @@
 #include "gpt.h"
 #include "vboot_api.h"
 
+/* Return 1 if the entry is a kernel GptNextKernelEntry() may return. */
+static int IsTriableKernel(const GptEntry *e)
+{
+	return IsKernelEntry(e) && GetEntryPriority(e) > 0 &&
+		(GetEntrySuccessful(e) || GetEntryTries(e));
+}
+
+/*
+ * List the kernels in the order GptNextKernelEntry() returns them: by
+ * descending priority, then by ascending index.
+ */
+static void BuildKernelCandidates(GptData *gpt)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	uint32_t i;
+	int j, prio;
+
+	gpt->num_kernel_candidates = 0;
+	gpt->next_kernel_candidate = 0;
+	gpt->kernel_candidates_valid = 0;
+
+	for (i = 0; i < header->number_of_entries; i++) {
+		if (!IsTriableKernel(entries + i))
+			continue;
+		if (gpt->num_kernel_candidates == GPT_MAX_KERNEL_CANDIDATES)
+			return;
+		prio = GetEntryPriority(entries + i);
+		/* Insert after all entries of the same or higher priority. */
+		for (j = gpt->num_kernel_candidates; j > 0; j--) {
+			if (gpt->kernel_candidates[j - 1].priority >= prio)
+				break;
+			gpt->kernel_candidates[j] =
+				gpt->kernel_candidates[j - 1];
+		}
+		gpt->kernel_candidates[j].index = i;
+		gpt->kernel_candidates[j].priority = prio;
+		gpt->num_kernel_candidates++;
+	}
+	gpt->kernel_candidates_valid = 1;
+}
+
 int GptInit(GptData *gpt)
 {
 	int retval;
@@ -18,6 +60,7 @@ int GptInit(GptData *gpt)
 	gpt->modified = 0;
 	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
 	gpt->current_priority = 999;
+	gpt->kernel_candidates_valid = 0;
 
 	retval = GptValidityCheck(gpt);
 	if (GPT_SUCCESS != retval) {
@@ -26,6 +69,7 @@ int GptInit(GptData *gpt)
 	}
 
 	GptRepair(gpt);
+	BuildKernelCandidates(gpt);
 	return GPT_SUCCESS;
 }
 
@@ -38,6 +82,38 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 	int new_prio = 0;
 	uint32_t i;
 
+	/*
+	 * Take the next kernel from the list built by GptInit(), as long as
+	 * it hasn't changed since then.
+	 */
+	while (gpt->kernel_candidates_valid &&
+	       gpt->next_kernel_candidate < gpt->num_kernel_candidates) {
+		i = gpt->kernel_candidates[gpt->next_kernel_candidate].index;
+		new_prio =
+			gpt->kernel_candidates[gpt->next_kernel_candidate].priority;
+		e = entries + i;
+		if (!IsTriableKernel(e) || GetEntryPriority(e) != new_prio) {
+			VB2_DEBUG("GptNextKernelEntry: partition %d changed, "
+				  "rescanning\n", i + 1);
+			gpt->kernel_candidates_valid = 0;
+			new_prio = 0;
+			break;
+		}
+		gpt->next_kernel_candidate++;
+		gpt->current_kernel = i;
+		gpt->current_priority = new_prio;
+		VB2_DEBUG("GptNextKernelEntry likes partition %d\n", i + 1);
+		*start_sector = e->starting_lba;
+		*size = e->ending_lba - e->starting_lba + 1;
+		return GPT_SUCCESS;
+	}
+	if (gpt->kernel_candidates_valid) {
+		gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		gpt->current_priority = 0;
+		VB2_DEBUG("GptNextKernelEntry no more kernels\n");
+		return GPT_ERROR_NO_VALID_KERNEL;
+	}
+
 	/*
 	 * If we already found a kernel, continue the scan at the current
 	 * kernel's priority, in case there is another kernel with the same
@@ -118,6 +194,7 @@ int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
  */
 int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 {
+	GptEntry old = *e;
 	int modified = 0;
 
 	if (!IsKernelEntry(e))
@@ -184,7 +261,16 @@ int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 	}
 
 	if (modified) {
-		GptModified(gpt);
+		GptEntryModified(gpt, e, &old);
+		/*
+		 * The kernel list from GptInit() stays in order if the current
+		 * kernel keeps its priority or can't be tried any more.
+		 */
+		if (gpt->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND ||
+		    e != (GptEntry *)gpt->primary_entries + gpt->current_kernel ||
+		    (IsTriableKernel(e) &&
+		     GetEntryPriority(e) != GetEntryPriority(&old)))
+			gpt->kernel_candidates_valid = 0;
 	}
 
 	return GPT_SUCCESS;
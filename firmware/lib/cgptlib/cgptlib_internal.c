@@ -19,6 +19,24 @@ size_t CalculateEntriesSectors(GptHeader* h, uint32_t sector_bytes)
 	return ret;
 }
 
+size_t CalculateEntriesAllocSize(const GptHeader *h1, const GptHeader *h2,
+				 uint32_t sector_bytes)
+{
+	size_t size = GPT_ENTRIES_ALLOC_SIZE, bytes;
+
+	if (h1) {
+		bytes = (size_t)h1->number_of_entries * h1->size_of_entry;
+		if (bytes > size)
+			size = bytes;
+	}
+	if (h2) {
+		bytes = (size_t)h2->number_of_entries * h2->size_of_entry;
+		if (bytes > size)
+			size = bytes;
+	}
+	return (size + sector_bytes - 1) / sector_bytes * sector_bytes;
+}
+
 int CheckParameters(GptData *gpt)
 {
 	/* Only support 512-byte or larger sectors that are a power of 2 */
@@ -101,10 +119,15 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	 */
 	if (h->size_of_entry != sizeof(GptEntry))
 		return 1;
+	/*
+	 * The number of entries is bounded so firmware can safely allocate
+	 * the arrays. On the same device there must be at least 16KB reserved
+	 * for the entries, as the UEFI spec requires.
+	 */
 	if ((h->number_of_entries < MIN_NUMBER_OF_ENTRIES) ||
 	    (h->number_of_entries > MAX_NUMBER_OF_ENTRIES) ||
 	    (!(flags & GPT_FLAG_EXTERNAL) &&
-	    h->number_of_entries != MAX_NUMBER_OF_ENTRIES))
+	    h->number_of_entries < DEFAULT_NUMBER_OF_ENTRIES))
 		return 1;
 
 	/*
@@ -159,20 +182,11 @@ int IsKernelEntry(const GptEntry *e)
 	return !memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
-int CheckEntries(GptEntry *entries, GptHeader *h)
+int CheckEntriesPairwise(GptEntry *entries, GptHeader *h)
 {
-	if (!entries)
-		return GPT_ERROR_INVALID_ENTRIES;
 	GptEntry *entry;
-	uint32_t crc32;
 	uint32_t i;
 
-	/* Check CRC before examining entries. */
-	crc32 = Crc32((const uint8_t *)entries,
-		      h->size_of_entry * h->number_of_entries);
-	if (crc32 != h->entries_crc32)
-		return GPT_ERROR_CRC_CORRUPTED;
-
 	/* Check all entries. */
 	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
 		GptEntry *e2;
@@ -211,6 +225,151 @@ int CheckEntries(GptEntry *entries, GptHeader *h)
 	return 0;
 }
 
+/* Moves index[root] down the max-heap of given size, keyed by starting LBA. */
+static void SiftDownByStartingLba(const GptEntry *entries, uint16_t *index,
+				  uint32_t root, uint32_t size)
+{
+	uint32_t child;
+	uint16_t tmp;
+
+	while ((child = 2 * root + 1) < size) {
+		if (child + 1 < size &&
+		    entries[index[child]].starting_lba <
+		    entries[index[child + 1]].starting_lba)
+			child++;
+		if (entries[index[root]].starting_lba >=
+		    entries[index[child]].starting_lba)
+			return;
+		tmp = index[root];
+		index[root] = index[child];
+		index[child] = tmp;
+		root = child;
+	}
+}
+
+/* Returns the hash slot for a unique GUID, in a table of given size. */
+static uint32_t GuidHash(const Guid *guid, uint32_t size)
+{
+	const uint8_t *p = guid->u.raw;
+	uint32_t hash = 2166136261u;  /* FNV-1a */
+	uint32_t i;
+
+	for (i = 0; i < sizeof(Guid); i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	return hash & (size - 1);
+}
+
+/*
+ * Scratch buffers for CheckEntries(): an index of the used entries, and a hash
+ * table of their unique GUIDs kept at most half full.  cgpt checks drives from
+ * several threads, so host builds keep a copy per thread.
+ */
+#ifdef CHROMEOS_ENVIRONMENT
+#define CHECK_ENTRIES_SCRATCH static __thread
+#else
+#define CHECK_ENTRIES_SCRATCH static
+#endif
+CHECK_ENTRIES_SCRATCH uint16_t check_entries_index[MAX_NUMBER_OF_ENTRIES];
+CHECK_ENTRIES_SCRATCH uint16_t check_entries_table[2 * MAX_NUMBER_OF_ENTRIES];
+
+/*
+ * Returns the error CheckEntriesPairwise() reports for a pair of overlapping
+ * entries, checking the entry which comes first in the table against the
+ * other.
+ */
+static int OverlapError(const GptEntry *e1, const GptEntry *e2)
+{
+	const GptEntry *tmp;
+
+	if (e2 < e1) {
+		tmp = e1;
+		e1 = e2;
+		e2 = tmp;
+	}
+	if ((e1->starting_lba >= e2->starting_lba) &&
+	    (e1->starting_lba <= e2->ending_lba))
+		return GPT_ERROR_START_LBA_OVERLAP;
+	if ((e1->ending_lba >= e2->starting_lba) &&
+	    (e1->ending_lba <= e2->ending_lba))
+		return GPT_ERROR_END_LBA_OVERLAP;
+	/* e1 contains e2, which starts inside e1. */
+	return GPT_ERROR_START_LBA_OVERLAP;
+}
+
+int CheckEntriesSorted(GptEntry *entries, GptHeader *h)
+{
+	uint16_t *index = check_entries_index;
+	uint16_t *table = check_entries_table;
+	uint32_t table_size = 2 * MAX_NUMBER_OF_ENTRIES;
+	uint32_t i, n = 0, slot;
+	uint16_t tmp;
+	GptEntry *entry;
+
+	if (h->number_of_entries > MAX_NUMBER_OF_ENTRIES)
+		return GPT_ERROR_INVALID_ENTRIES;
+
+	/* Keep the hash table at most half full. */
+	while (table_size / 2 >= 2 * h->number_of_entries &&
+	       table_size > 16)
+		table_size /= 2;
+	/* Table slots hold entry number + 1, so 0 is empty. */
+	memset(table, 0, table_size * sizeof(table[0]));
+
+	for (i = 0, entry = entries; i < h->number_of_entries; i++, entry++) {
+		if (IsUnusedEntry(entry))
+			continue;
+
+		if ((entry->starting_lba < h->first_usable_lba) ||
+		    (entry->ending_lba > h->last_usable_lba) ||
+		    (entry->ending_lba < entry->starting_lba))
+			return GPT_ERROR_OUT_OF_REGION;
+
+		for (slot = GuidHash(&entry->unique, table_size); table[slot];
+		     slot = (slot + 1) & (table_size - 1)) {
+			if (0 == memcmp(&entry->unique,
+					&entries[table[slot] - 1].unique,
+					sizeof(Guid)))
+				return GPT_ERROR_DUP_GUID;
+		}
+		table[slot] = i + 1;
+		index[n++] = i;
+	}
+
+	/* Heap sort, which needs neither recursion nor extra memory. */
+	for (i = n / 2; i > 0; i--)
+		SiftDownByStartingLba(entries, index, i - 1, n);
+	for (i = n; i > 1; i--) {
+		tmp = index[0];
+		index[0] = index[i - 1];
+		index[i - 1] = tmp;
+		SiftDownByStartingLba(entries, index, 0, i - 1);
+	}
+
+	/* Sorted valid ranges do not overlap if each starts after previous. */
+	for (i = 1; i < n; i++) {
+		if (entries[index[i]].starting_lba <=
+		    entries[index[i - 1]].ending_lba)
+			return OverlapError(&entries[index[i - 1]],
+					    &entries[index[i]]);
+	}
+	return 0;
+}
+
+int CheckEntries(GptEntry *entries, GptHeader *h)
+{
+	if (!entries)
+		return GPT_ERROR_INVALID_ENTRIES;
+	uint32_t crc32;
+
+	/* Check CRC before examining entries. */
+	crc32 = Crc32((const uint8_t *)entries,
+		      h->size_of_entry * h->number_of_entries);
+	if (crc32 != h->entries_crc32)
+		return GPT_ERROR_CRC_CORRUPTED;
+
+	return CheckEntriesSorted(entries, h);
+}
+
 int HeaderFieldsSame(GptHeader *h1, GptHeader *h2)
 {
 	if (memcmp(h1->signature, h2->signature, sizeof(h1->signature)))
@@ -465,6 +624,34 @@ void GptModified(GptData *gpt) {
 	GptRepair(gpt);
 }
 
+void GptEntryModified(GptData *gpt, const GptEntry *e, const GptEntry *old)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	uint32_t entries_size = header->size_of_entry *
+		header->number_of_entries;
+	size_t offset = (const uint8_t *)e - gpt->primary_entries;
+
+	/* The old CRC must be right for the primary entries to patch it. */
+	if (!(gpt->valid_headers & MASK_PRIMARY) ||
+	    !(gpt->valid_entries & MASK_PRIMARY) ||
+	    (const uint8_t *)e < gpt->primary_entries ||
+	    offset + sizeof(GptEntry) > entries_size) {
+		GptModified(gpt);
+		return;
+	}
+
+	header->entries_crc32 = Crc32Patch(header->entries_crc32,
+					   entries_size, offset, old, e,
+					   sizeof(GptEntry));
+	header->header_crc32 = HeaderCrc(header);
+	gpt->modified |= GPT_MODIFIED_HEADER1 | GPT_MODIFIED_ENTRIES1;
+
+	/* As in GptModified(), let the repair update the other copy. */
+	gpt->valid_headers = MASK_PRIMARY;
+	gpt->valid_entries = MASK_PRIMARY;
+	GptRepair(gpt);
+}
+
 
 const char *GptErrorText(int error_code)
 {
@@ -99,6 +99,18 @@ static uint32_t crc32_tab[] = {
 };
 
 
+/* x^(2^n) modulo the polynomial, for n = 0..31 */
+static const uint32_t crc32_x2n_tab[32] = {
+	0x40000000U, 0x20000000U, 0x08000000U, 0x00800000U, 0x00008000U,
+	0xedb88320U, 0xb1e6b092U, 0xa06a2517U, 0xed627daeU, 0x88d14467U,
+	0xd7bbfe6aU, 0xec447f11U, 0x8e7ea170U, 0x6427800eU, 0x4d47bae0U,
+	0x09fe548fU, 0x83852d0fU, 0x30362f1aU, 0x7b5a9cc3U, 0x31fec169U,
+	0x9fec022aU, 0x6c8dedc4U, 0x15d6874dU, 0x5fde7a4eU, 0xbad90e37U,
+	0x2e4e5eefU, 0x4eaba214U, 0xa8a472c0U, 0x429a969eU, 0x148d302aU,
+	0xc40ba6d0U, 0xc4e22c3cU
+};
+
+
 uint32_t Crc32(const void *buffer, uint32_t len)
 {
 	uint8_t *byte = (uint8_t *)buffer;
@@ -109,3 +121,58 @@ uint32_t Crc32(const void *buffer, uint32_t len)
 		value = crc32_tab[(value ^ byte[i]) & 0xff] ^ (value >> 8);
 	return value ^ ~0U;
 }
+
+/* Multiply a and b modulo the polynomial (in the reflected bit order). */
+static uint32_t crc32_multmod(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31;
+	uint32_t p = 0;
+
+	while (a) {
+		if (a & m) {
+			p ^= b;
+			a &= ~m;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ 0xedb88320U : b >> 1;
+	}
+	return p;
+}
+
+/* Return x^(8 * len) modulo the polynomial, i.e. the effect of len zeros. */
+static uint32_t crc32_zeros_op(uint32_t len)
+{
+	uint32_t p = 1U << 31;  /* x^0 */
+	int k = 3;  /* 2^3 bits per byte */
+
+	for (; len; len >>= 1, k++) {
+		if (len & 1)
+			p = crc32_multmod(crc32_x2n_tab[k & 31], p);
+	}
+	return p;
+}
+
+uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint32_t len2)
+{
+	return crc32_multmod(crc32_zeros_op(len2), crc1) ^ crc2;
+}
+
+uint32_t Crc32Patch(uint32_t crc, uint32_t len, uint32_t offset,
+		    const void *old_data, const void *new_data,
+		    uint32_t data_len)
+{
+	const uint8_t *old_byte = (const uint8_t *)old_data;
+	const uint8_t *new_byte = (const uint8_t *)new_data;
+	uint32_t delta = 0;
+	uint32_t i;
+
+	/*
+	 * The CRC is linear apart from its initial and final inversion, which
+	 * are the same for both versions of the buffer. So the change in the
+	 * CRC is the raw CRC of (old ^ new), shifted past the trailing bytes.
+	 */
+	for (i = 0; i < data_len; ++i)
+		delta = crc32_tab[(delta ^ old_byte[i] ^ new_byte[i]) & 0xff] ^
+			(delta >> 8);
+	return crc ^ Crc32Combine(delta, 0, len - offset - data_len);
+}
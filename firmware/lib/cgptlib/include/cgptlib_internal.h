@@ -58,10 +58,16 @@
 #define MAX_SIZE_OF_ENTRY 512
 #define SIZE_OF_ENTRY_MULTIPLE 8
 #define MIN_NUMBER_OF_ENTRIES 16
-#define MAX_NUMBER_OF_ENTRIES 128
+#define DEFAULT_NUMBER_OF_ENTRIES 128
+/* Bounds the memory needed for entries: 512KB for each array. */
+#define MAX_NUMBER_OF_ENTRIES 4096
 
-/* All GptData.(primary|secondary)_entries must be allocated to this size! */
-#define GPT_ENTRIES_ALLOC_SIZE (MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry))
+/*
+ * All GptData.(primary|secondary)_entries must be allocated to at least this
+ * size, and to CalculateEntriesAllocSize() if the headers have more entries.
+ * This is also the minimum size of entries stored on the same device.
+ */
+#define GPT_ENTRIES_ALLOC_SIZE (DEFAULT_NUMBER_OF_ENTRIES * sizeof(GptEntry))
 
 /* Defines GPT sizes */
 #define GPT_PMBR_SECTORS 1  /* size (in sectors) of PMBR */
@@ -99,6 +105,15 @@ int CheckHeader(GptHeader *h, int is_secondary,
 		uint64_t gpt_drive_sectors, uint32_t flags,
 		uint32_t sector_bytes);
 
+/**
+ * Return the number of bytes to allocate for each of the GptData entries
+ * arrays, so either array can hold the entries described by either header,
+ * rounded up to whole sectors. Headers which are NULL are ignored; others
+ * must have passed CheckHeader(). Never less than GPT_ENTRIES_ALLOC_SIZE.
+ */
+size_t CalculateEntriesAllocSize(const GptHeader *h1, const GptHeader *h2,
+				 uint32_t sector_bytes);
+
 /**
  * Calculate and return the header CRC.
  */
@@ -111,6 +126,24 @@ uint32_t HeaderCrc(GptHeader *h);
  */
 int CheckEntries(GptEntry *entries, GptHeader *h);
 
+/**
+ * Check entries by sorting them by starting LBA, without checking CRC.  This
+ * is O(n log n) and does the checks for CheckEntries(), using fixed scratch
+ * buffers for up to MAX_NUMBER_OF_ENTRIES.
+ *
+ * Returns 0 if entries are valid, or an error found.  With a single problem
+ * in the table, this is the error CheckEntriesPairwise() reports.
+ */
+int CheckEntriesSorted(GptEntry *entries, GptHeader *h);
+
+/**
+ * Check entries by comparing every pair of entries, without checking CRC.
+ * This is O(n^2), and kept as a reference for CheckEntriesSorted().
+ *
+ * Returns 0 if entries are valid, or the first error found.
+ */
+int CheckEntriesPairwise(GptEntry *entries, GptHeader *h);
+
 /**
  * Return 0 if the GptHeaders are the same for all fields which don't differ
  * between the primary and secondary headers - that is, all fields other than:
@@ -148,6 +181,12 @@ void GptRepair(GptData *gpt);
  */
 void GptModified(GptData *gpt);
 
+/**
+ * Like GptModified(), when only the primary entry e has changed from old.
+ * The entries CRC is patched instead of being recomputed over all entries.
+ */
+void GptEntryModified(GptData *gpt, const GptEntry *e, const GptEntry *old);
+
 /**
  * Return 1 if the entry is a Chrome OS kernel partition, else 0.
  */
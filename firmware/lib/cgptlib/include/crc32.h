@@ -10,4 +10,20 @@
 
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Return the CRC32 of the concatenation of two buffers, given crc1 of the
+ * first, crc2 of the second, and the length of the second buffer, in time
+ * O(log len2).
+ */
+uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint32_t len2);
+
+/**
+ * Return the CRC32 of a len-byte buffer whose CRC32 was crc, after the
+ * data_len bytes at offset changed from old_data to new_data. This only reads
+ * the changed bytes, and is O(log len) in the rest of the buffer.
+ */
+uint32_t Crc32Patch(uint32_t crc, uint32_t len, uint32_t offset,
+		    const void *old_data, const void *new_data,
+		    uint32_t data_len);
+
 #endif  /* VBOOT_REFERENCE_CRC32_H_ */
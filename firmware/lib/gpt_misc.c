@@ -11,6 +11,84 @@
 #include "gpt.h"
 #include "vboot_api.h"
 
+/**
+ * Grow both entries buffers (keeping their contents) if they are too small
+ * for the entries described by the given (valid) header.
+ *
+ * Returns 0 if successful, 1 if error.
+ */
+static int GrowEntries(GptData *gptdata, size_t *alloc_size,
+		       const GptHeader *header)
+{
+	size_t size = CalculateEntriesAllocSize(header, NULL,
+						gptdata->sector_bytes);
+	uint8_t *primary, *secondary;
+
+	if (size <= *alloc_size)
+		return 0;
+
+	primary = (uint8_t *)malloc(size);
+	secondary = (uint8_t *)malloc(size);
+	if (!primary || !secondary) {
+		free(primary);
+		free(secondary);
+		return 1;
+	}
+	memcpy(primary, gptdata->primary_entries, *alloc_size);
+	memcpy(secondary, gptdata->secondary_entries, *alloc_size);
+	memset(primary + *alloc_size, 0, size - *alloc_size);
+	memset(secondary + *alloc_size, 0, size - *alloc_size);
+	free(gptdata->primary_entries);
+	free(gptdata->secondary_entries);
+	gptdata->primary_entries = primary;
+	gptdata->secondary_entries = secondary;
+	*alloc_size = size;
+	return 0;
+}
+
+/* A range of sectors read from the drive in a single request */
+struct gpt_region {
+	uint8_t *buf;
+	uint64_t lba;
+	uint64_t count;
+};
+
+/**
+ * Read a region of the drive, leaving region->buf NULL if it can't be read.
+ */
+static void ReadRegion(VbExDiskHandle_t disk_handle, const GptData *gptdata,
+		       struct gpt_region *region, uint64_t lba, uint64_t count)
+{
+	region->lba = lba;
+	region->count = count;
+	region->buf = (uint8_t *)malloc(count * gptdata->sector_bytes);
+	if (region->buf &&
+	    0 != VbExDiskRead(disk_handle, lba, count, region->buf)) {
+		VB2_DEBUG("Read error in GPT region at %u\n", (uint32_t)lba);
+		free(region->buf);
+		region->buf = NULL;
+	}
+}
+
+/**
+ * Like VbExDiskRead(), but copy the sectors from the region if it holds all
+ * of them.
+ */
+static vb2_error_t ReadFromRegion(VbExDiskHandle_t disk_handle,
+				  const GptData *gptdata,
+				  const struct gpt_region *region,
+				  uint64_t lba, uint64_t count, uint8_t *buf)
+{
+	if (region->buf && lba >= region->lba && count <= region->count &&
+	    lba - region->lba <= region->count - count) {
+		memcpy(buf, region->buf +
+		       (lba - region->lba) * gptdata->sector_bytes,
+		       count * gptdata->sector_bytes);
+		return VB2_SUCCESS;
+	}
+	return VbExDiskRead(disk_handle, lba, count, buf);
+}
+
 /**
  * Allocate and read GPT data from the drive.
  *
@@ -22,6 +100,10 @@
 int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 {
 	int primary_valid = 0, secondary_valid = 0;
+	size_t alloc_size = GPT_ENTRIES_ALLOC_SIZE;
+	struct gpt_region region = { NULL };
+	uint64_t region_sectors;
+	int coalesce;
 
 	/* No data to be written yet */
 	gptdata->modified = 0;
@@ -46,8 +128,24 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	    gptdata->secondary_entries == NULL)
 		return 1;
 
+	/*
+	 * Read each half of the GPT in a single request, assuming the usual
+	 * layout of a header next to default-sized entries.  Anything outside
+	 * of the region, or in a region which can't be read, is read on its
+	 * own.
+	 */
+	region_sectors = GPT_HEADER_SECTORS +
+		(DEFAULT_NUMBER_OF_ENTRIES * sizeof(GptEntry) +
+		 gptdata->sector_bytes - 1) / gptdata->sector_bytes;
+	coalesce = gptdata->gpt_drive_sectors >=
+		GPT_PMBR_SECTORS + 2 * region_sectors;
+
 	/* Read primary header from the drive, skipping the protective MBR */
-	if (0 != VbExDiskRead(disk_handle, 1, 1, gptdata->primary_header)) {
+	if (coalesce)
+		ReadRegion(disk_handle, gptdata, &region, GPT_PMBR_SECTORS,
+			   region_sectors);
+	if (0 != ReadFromRegion(disk_handle, gptdata, &region, 1, 1,
+				gptdata->primary_header)) {
 		VB2_DEBUG("Read error in primary GPT header\n");
 		memset(gptdata->primary_header, 0, gptdata->sector_bytes);
 	}
@@ -59,17 +157,29 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			gptdata->gpt_drive_sectors,
 			gptdata->flags,
 			gptdata->sector_bytes)) {
-		primary_valid = 1;
+		if (0 == GrowEntries(gptdata, &alloc_size, primary_header)) {
+			primary_valid = 1;
+		} else {
+			/*
+			 * Drop the header, so GptInit() doesn't check entries
+			 * which don't fit in the buffers either.
+			 */
+			VB2_DEBUG("Can't allocate primary GPT entries\n");
+			memset(gptdata->primary_header, 0,
+			       gptdata->sector_bytes);
+		}
+	}
+	if (primary_valid) {
 		uint64_t entries_bytes =
 				(uint64_t)primary_header->number_of_entries
 				* primary_header->size_of_entry;
 		uint64_t entries_sectors =
 				(entries_bytes + gptdata->sector_bytes - 1)
 				/ gptdata->sector_bytes;
-		if (0 != VbExDiskRead(disk_handle,
-				      primary_header->entries_lba,
-				      entries_sectors,
-				      gptdata->primary_entries)) {
+		if (0 != ReadFromRegion(disk_handle, gptdata, &region,
+					primary_header->entries_lba,
+					entries_sectors,
+					gptdata->primary_entries)) {
 			VB2_DEBUG("Read error in primary GPT entries\n");
 			primary_valid = 0;
 		}
@@ -82,8 +192,15 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	}
 
 	/* Read secondary header from the end of the drive */
-	if (0 != VbExDiskRead(disk_handle, gptdata->gpt_drive_sectors - 1, 1,
-			      gptdata->secondary_header)) {
+	free(region.buf);
+	region.buf = NULL;
+	if (coalesce)
+		ReadRegion(disk_handle, gptdata, &region,
+			   gptdata->gpt_drive_sectors - region_sectors,
+			   region_sectors);
+	if (0 != ReadFromRegion(disk_handle, gptdata, &region,
+				gptdata->gpt_drive_sectors - 1, 1,
+				gptdata->secondary_header)) {
 		VB2_DEBUG("Read error in secondary GPT header\n");
 		memset(gptdata->secondary_header, 0, gptdata->sector_bytes);
 	}
@@ -95,17 +212,25 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			gptdata->gpt_drive_sectors,
 			gptdata->flags,
 			gptdata->sector_bytes)) {
-		secondary_valid = 1;
+		if (0 == GrowEntries(gptdata, &alloc_size, secondary_header)) {
+			secondary_valid = 1;
+		} else {
+			VB2_DEBUG("Can't allocate secondary GPT entries\n");
+			memset(gptdata->secondary_header, 0,
+			       gptdata->sector_bytes);
+		}
+	}
+	if (secondary_valid) {
 		uint64_t entries_bytes =
 				(uint64_t)secondary_header->number_of_entries
 				* secondary_header->size_of_entry;
 		uint64_t entries_sectors =
 				(entries_bytes + gptdata->sector_bytes - 1)
 				/ gptdata->sector_bytes;
-		if (0 != VbExDiskRead(disk_handle,
-				      secondary_header->entries_lba,
-				      entries_sectors,
-				      gptdata->secondary_entries)) {
+		if (0 != ReadFromRegion(disk_handle, gptdata, &region,
+					secondary_header->entries_lba,
+					entries_sectors,
+					gptdata->secondary_entries)) {
 			VB2_DEBUG("Read error in secondary GPT entries\n");
 			secondary_valid = 0;
 		}
@@ -117,6 +242,8 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 			  ? "invalid" : "being ignored");
 	}
 
+	free(region.buf);
+
 	/* Return 0 if least one GPT header was valid */
 	return (primary_valid || secondary_valid) ? 0 : 1;
 }
@@ -141,7 +268,8 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 
 	entries_bytes = (uint64_t)header->number_of_entries
 			* header->size_of_entry;
-	entries_sectors = entries_bytes / gptdata->sector_bytes;
+	entries_sectors = (entries_bytes + gptdata->sector_bytes - 1) /
+			  gptdata->sector_bytes;
 
 	/*
 	 * TODO(namnguyen): Preserve padding between primary GPT header and
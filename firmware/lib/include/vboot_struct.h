@@ -22,7 +22,7 @@ extern "C" {
 #define VB_SHARED_DATA_MAGIC 0x44536256
 
 /* Version for struct_version */
-#define VB_SHARED_DATA_VERSION 2
+#define VB_SHARED_DATA_VERSION 3
 
 /*
  * Flags for VbSharedDataHeader
@@ -53,6 +53,21 @@ extern "C" {
 /* NvStorage uses 64-byte record, not 16-byte */
 #define VBSD_NVDATA_V2                   0x00100000
 
+/* Indices of VbSharedDataHeader.boot_time_ms */
+#define VBSD_BOOT_TIME_FW_PHASE1         0
+#define VBSD_BOOT_TIME_FW_PHASE2         1
+#define VBSD_BOOT_TIME_FW_PHASE3         2
+#define VBSD_BOOT_TIME_FW_KEYBLOCK       3
+#define VBSD_BOOT_TIME_FW_PREAMBLE       4
+#define VBSD_BOOT_TIME_FW_BODY           5
+#define VBSD_BOOT_TIME_EC_SYNC           6
+#define VBSD_BOOT_TIME_AUXFW_SYNC        7
+#define VBSD_BOOT_TIME_LOAD_KERNEL       8
+/* First of VBSD_BOOT_TIME_KERNEL_PARTS kernel partition entries */
+#define VBSD_BOOT_TIME_KERNEL_PART       9
+#define VBSD_BOOT_TIME_KERNEL_PARTS      4
+#define VBSD_BOOT_TIME_COUNT             13
+
 /* Number of kernel calls to track.  Must be power of 2. */
 #define VBSD_MAX_KERNEL_CALLS 4
 
@@ -145,19 +160,31 @@ typedef struct VbSharedDataHeader {
 	/* Kernel lowest version found */
 	uint32_t kernel_version_lowest;
 
+	/*
+	 * Fields added in version 3.  Before accessing, make sure that
+	 * struct_version >= 3
+	 */
+	/* Time spent in boot phases in milliseconds; see VBSD_BOOT_TIME_* */
+	uint32_t boot_time_ms[VBSD_BOOT_TIME_COUNT];
+
 } __attribute__((packed)) VbSharedDataHeader;
 
 /* Size of VbSharedDataheader for each version */
 #define VB_SHARED_DATA_HEADER_SIZE_V1 1072
 #define VB_SHARED_DATA_HEADER_SIZE_V2 1096
+#define VB_SHARED_DATA_HEADER_SIZE_V3 1148
 
 _Static_assert(VB_SHARED_DATA_HEADER_SIZE_V1
 	       == offsetof(VbSharedDataHeader, recovery_reason),
 	       "VB_SHARED_DATA_HEADER_SIZE_V1 incorrect");
 
-_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V2 == sizeof(VbSharedDataHeader),
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V2
+	       == offsetof(VbSharedDataHeader, boot_time_ms),
 	       "VB_SHARED_DATA_HEADER_SIZE_V2 incorrect");
 
+_Static_assert(VB_SHARED_DATA_HEADER_SIZE_V3 == sizeof(VbSharedDataHeader),
+	       "VB_SHARED_DATA_HEADER_SIZE_V3 incorrect");
+
 #ifdef __cplusplus
 }
 #endif  /* __cplusplus */
@@ -443,10 +443,15 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	VbSharedDataKernelCall shcall;
 	int found_partitions = 0;
 	uint32_t lowest_version = LOWEST_TPM_VERSION;
+	uint32_t start_ms = vb2ex_mtime();
 	vb2_error_t rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
 
+	/* Only keep the partition times of this call. */
+	memset(&sd->boot_time_ms[VB2_BOOT_TIME_KERNEL_PART], 0,
+	       VB2_BOOT_TIME_KERNEL_PARTS * sizeof(sd->boot_time_ms[0]));
+
 	/* Clear output params in case we fail */
 	params->partition_number = 0;
 	params->bootloader_address = 0;
@@ -517,6 +522,7 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 
 		/* Found at least one kernel partition. */
 		found_partitions++;
+		uint32_t part_start_ms = vb2ex_mtime();
 
 		/* Set up the stream */
 		VbExStream_t stream = NULL;
@@ -548,6 +554,10 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 					&wb);
 		VbExStreamClose(stream);
 
+		if (found_partitions <= VB2_BOOT_TIME_KERNEL_PARTS)
+			vb2_add_boot_time(ctx, VB2_BOOT_TIME_KERNEL_PART +
+					  found_partitions - 1, part_start_ms);
+
 		if (rv != VB2_SUCCESS) {
 			VB2_DEBUG("Marking kernel as invalid.\n");
 			GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
@@ -646,5 +656,6 @@ vb2_error_t LoadKernel(struct vb2_context *ctx, LoadKernelParams *params)
 	}
 
 	shcall.return_code = (uint8_t)rv;
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_LOAD_KERNEL, start_ms);
 	return rv;
 }
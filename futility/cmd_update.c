@@ -27,6 +27,9 @@ enum {
 	OPT_MODEL,
 	OPT_OUTPUT_DIR,
 	OPT_PD_IMAGE,
+	OPT_PLAN,
+	OPT_PLAN_SPEED,
+	OPT_PROP_CACHE,
 	OPT_QUIRKS,
 	OPT_QUIRKS_LIST,
 	OPT_REPACK,
@@ -35,6 +38,7 @@ enum {
 	OPT_SIGNATURE,
 	OPT_SYS_PROPS,
 	OPT_UNPACK,
+	OPT_VERIFY_HASH,
 	OPT_WRITE_PROTECTION,
 };
 
@@ -66,11 +70,15 @@ static struct option const long_opts[] = {
 	{"model", 1, NULL, OPT_MODEL},
 	{"output_dir", 1, NULL, OPT_OUTPUT_DIR},
 	{"pd_image", 1, NULL, OPT_PD_IMAGE},
+	{"plan", 0, NULL, OPT_PLAN},
+	{"plan_speed", 1, NULL, OPT_PLAN_SPEED},
+	{"prop_cache", 1, NULL, OPT_PROP_CACHE},
 	{"quirks", 1, NULL, OPT_QUIRKS},
 	{"repack", 1, NULL, OPT_REPACK},
 	{"signature_id", 1, NULL, OPT_SIGNATURE},
 	{"sys_props", 1, NULL, OPT_SYS_PROPS},
 	{"unpack", 1, NULL, OPT_UNPACK},
+	{"verify_hash", 0, NULL, OPT_VERIFY_HASH},
 	{"wp", 1, NULL, OPT_WRITE_PROTECTION},
 
 	/* TODO(hungte) Remove following deprecated options. */
@@ -113,6 +121,10 @@ static void print_help(int argc, char *argv[])
 		"    --unpack=DIR    \tExtracts archive to DIR\n"
 		"-p, --programmer=PRG\tChange AP (host) flashrom programmer\n"
 		"    --fast          \tReduce read cycles and do not verify\n"
+		"    --verify_hash   \tVerify only written sections by hash\n"
+		"    --plan          \tPrint the update plan in JSON, no write\n"
+		"    --plan_speed=SPD\tThroughput for --plan, in format\n"
+		"                    \t  PRG=READ/WRITE/ERASE[/BLOCK] (KB/s)\n"
 		"    --quirks=LIST   \tSpecify the quirks to apply\n"
 		"    --list-quirks   \tPrint all available quirks\n"
 		"-m, --mode=MODE     \tRun updater in specified mode\n"
@@ -133,6 +145,7 @@ static void print_help(int argc, char *argv[])
 		"    --servo_port=PRT\tOverride servod port, implies --servo\n"
 		"    --signature_id=S\tOverride signature ID for key files\n"
 		"    --sys_props=LIST\tList of system properties to override\n"
+		"    --prop_cache=F  \tCache system properties in file F\n"
 		"-d, --debug         \tPrint debugging messages\n"
 		"-v, --verbose       \tPrint verbose messages\n"
 		"",
@@ -187,6 +200,12 @@ static int do_update(int argc, char *argv[])
 		case OPT_PD_IMAGE:
 			args.pd_image = optarg;
 			break;
+		case OPT_PLAN:
+			args.do_plan = 1;
+			break;
+		case OPT_PLAN_SPEED:
+			args.plan_speed = optarg;
+			break;
 		case OPT_REPACK:
 			args.repack = optarg;
 			break;
@@ -218,6 +237,9 @@ static int do_update(int argc, char *argv[])
 		case OPT_SYS_PROPS:
 			args.sys_props = optarg;
 			break;
+		case OPT_PROP_CACHE:
+			args.prop_cache = optarg;
+			break;
 		case OPT_MANIFEST:
 			args.do_manifest = 1;
 			break;
@@ -233,6 +255,9 @@ static int do_update(int argc, char *argv[])
 		case OPT_FAST:
 			args.fast_update = 1;
 			break;
+		case OPT_VERIFY_HASH:
+			args.verify_hash = 1;
+			break;
 		case OPT_GBB_FLAGS:
 			args.gbb_flags = strtoul(optarg, &endptr, 0);
 			if (*endptr) {
@@ -313,10 +338,13 @@ static int do_update(int argc, char *argv[])
 			ERROR("%s\n", updater_error_messages[r]);
 			errorcnt++;
 		}
-		/* Use stdout for the final result. */
-		printf(">> %s: Firmware updater %s.\n",
-			errorcnt ? "FAILED": "DONE",
-			errorcnt ? "aborted" : "exits successfully");
+		/* Use stdout for the final result, or the plan. */
+		if (args.do_plan)
+			print_json_plan(cfg->plan, r);
+		else
+			printf(">> %s: Firmware updater %s.\n",
+				errorcnt ? "FAILED": "DONE",
+				errorcnt ? "aborted" : "exits successfully");
 	}
 
 	if (do_servo_cpu_fw_spi)
@@ -7,6 +7,12 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "2rsa.h"
 #include "crossystem.h"
@@ -36,21 +42,18 @@ enum rootkey_compat_result {
 /*
  * Gets the system property by given type.
  * If the property was not loaded yet, invoke the property getter function
- * and cache the result.
+ * and cache the result. Properties from crossystem are fetched together, and
+ * if a cache file was specified, the property is loaded from (or added to) the
+ * cache file.
  * Returns the property value.
  */
 int get_system_property(enum system_property_type property_type,
 			struct updater_config *cfg)
 {
-	struct system_property *prop;
-
 	assert(property_type < SYS_PROP_MAX);
-	prop = &cfg->system_properties[property_type];
-	if (!prop->initialized) {
-		prop->initialized = 1;
-		prop->value = prop->getter();
-	}
-	return prop->value;
+	return fetch_system_property(cfg->system_properties,
+				     ARRAY_SIZE(cfg->system_properties),
+				     property_type, cfg->prop_cache);
 }
 
 static void print_system_properties(struct updater_config *cfg)
@@ -296,6 +299,12 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 		return -1;
 	}
 
+	if (cfg->plan) {
+		INFO("(plan) %s slot %s on next boot, try_count=%d.\n",
+		     has_update ? "Try" : "Keep", slot, tries);
+		plan_set_try(cfg->plan, slot, tries);
+		return 0;
+	}
 	if (cfg->emulation) {
 		INFO("(emulation) %s slot %s on next boot, try_count=%d.\n",
 		     has_update ? "Try" : "Keep", slot, tries);
@@ -323,23 +332,109 @@ static int set_try_cookies(struct updater_config *cfg, const char *target,
 	return 0;
 }
 
+/* Size of blocks to compare when writing to emulation target. */
+#define EMULATION_BLOCK_SIZE 4096
+
+/*
+ * Opens and maps the emulation target file (for first write).
+ * Returns 0 if success, non-zero if error.
+ */
+static int open_emulation_target(struct emulation_target *target,
+				 const char *filename)
+{
+	struct firmware_image *image = &target->image;
+
+	if (image->data)
+		return 0;
+
+	target->fd = open(filename, O_RDWR);
+	if (target->fd < 0) {
+		ERROR("Cannot open %s: %s\n", filename, strerror(errno));
+		return -1;
+	}
+	if (futil_map_file(target->fd, MAP_RW, &image->data, &image->size)) {
+		close(target->fd);
+		image->data = NULL;
+		return -1;
+	}
+	image->file_name = (char *)filename;
+	return 0;
+}
+
+/* Unmaps and closes the emulation target file, if opened. */
+static void close_emulation_target(struct emulation_target *target)
+{
+	struct firmware_image *image = &target->image;
+
+	if (!image->data)
+		return;
+	futil_unmap_file(target->fd, MAP_RW, image->data, image->size);
+	close(target->fd);
+	memset(target, 0, sizeof(*target));
+}
+
+/*
+ * Writes data to the emulation target at given offset, but only the blocks
+ * that are different from current contents.
+ * Returns number of bytes written, or -1 on error.
+ */
+static int64_t write_emulation_target(struct emulation_target *target,
+				      uint32_t offset, const uint8_t *data,
+				      uint32_t size)
+{
+	const uint8_t *current = target->image.data + offset;
+	uint32_t start, end, len;
+	int64_t written = 0;
+
+	for (start = 0; start < size; start = end) {
+		len = VB2_MIN(EMULATION_BLOCK_SIZE, size - start);
+		if (memcmp(current + start, data + start, len) == 0) {
+			end = start + len;
+			continue;
+		}
+		/* Merge all following changed blocks into one write. */
+		for (end = start + len; end < size; end += len) {
+			len = VB2_MIN(EMULATION_BLOCK_SIZE, size - end);
+			if (memcmp(current + end, data + end, len) == 0)
+				break;
+		}
+		if (pwrite(target->fd, data + start, end - start,
+			   offset + start) != end - start) {
+			ERROR("Failed writing to %s: %s\n",
+			      target->image.file_name, strerror(errno));
+			return -1;
+		}
+		written += end - start;
+	}
+	return written;
+}
+
 /*
  * Emulates writing to firmware.
  * Returns 0 if success, non-zero if error.
  */
-static int emulate_write_firmware(const char *filename,
+static int emulate_write_firmware(struct updater_config *cfg,
 				  const struct firmware_image *image,
 				  const char *section_name)
 {
-	struct firmware_image to_image = {0};
+	struct emulation_target *target = &cfg->emulation_target;
+	struct firmware_image *to_image = &target->image;
 	struct firmware_section from, to;
+	int64_t written;
 	int errorcnt = 0;
 
 	from.data = image->data;
 	from.size = image->size;
 
-	if (load_firmware_image(&to_image, filename, NULL)) {
-		ERROR("Cannot load image from %s.\n", filename);
+	if (open_emulation_target(target, cfg->emulation)) {
+		ERROR("Cannot load image from %s.\n", cfg->emulation);
+		return -1;
+	}
+	/* The FMAP may be changed by previous writes so always find again. */
+	to_image->fmap_header = fmap_find(to_image->data, to_image->size);
+	if (!to_image->fmap_header) {
+		ERROR("Invalid image file (missing FMAP): %s\n",
+		      cfg->emulation);
 		return -1;
 	}
 
@@ -350,38 +445,107 @@ static int emulate_write_firmware(const char *filename,
 			      section_name, image->file_name);
 			errorcnt++;
 		}
-		find_firmware_section(&to, &to_image, section_name);
+		find_firmware_section(&to, to_image, section_name);
 		if (!to.data) {
 			ERROR("No section %s in destination image %s.\n",
-			      section_name, filename);
+			      section_name, cfg->emulation);
 			errorcnt++;
 		}
-	} else if (image->size != to_image.size) {
+	} else if (image->size != to_image->size) {
 		ERROR("Image size is different (%s:%d != %s:%d)\n",
-		      image->file_name, image->size, to_image.file_name,
-		      to_image.size);
+		      image->file_name, image->size, to_image->file_name,
+		      to_image->size);
 		errorcnt++;
 	} else {
-		to.data = to_image.data;
-		to.size = to_image.size;
+		to.data = to_image->data;
+		to.size = to_image->size;
 	}
 
 	if (!errorcnt) {
 		size_t to_write = VB2_MIN(to.size, from.size);
 
 		assert(from.data && to.data);
-		VB2_DEBUG("Writing %zu bytes\n", to_write);
-		memcpy(to.data, from.data, to_write);
+		written = write_emulation_target(
+				target, to.data - to_image->data, from.data,
+				to_write);
+		if (written < 0)
+			errorcnt++;
+		else
+			VB2_DEBUG("Wrote %" PRId64 " of %zu bytes\n",
+				  written, to_write);
 	}
 
-	if (!errorcnt && vb2_write_file(
-			filename, to_image.data, to_image.size)) {
-		ERROR("Failed writing to file: %s\n", filename);
-		errorcnt++;
+	return errorcnt;
+}
+
+/*
+ * Verifies a section (or whole image if section_name is NULL) written to the
+ * system firmware, by reading back only the written region and comparing the
+ * SHA-256 digest with digest of the expected contents.
+ * Returns 0 if success, non-zero if error.
+ */
+static int verify_firmware(struct updater_config *cfg,
+			   const struct firmware_image *image,
+			   const char *section_name)
+{
+	struct firmware_section section = {image->data, image->size}, to;
+	uint8_t expected[VB2_SHA256_DIGEST_SIZE], actual[VB2_SHA256_DIGEST_SIZE];
+	const char *name = section_name ? section_name : "whole image";
+	const char *path;
+	uint32_t offset = 0;
+	struct timespec start, end;
+	long elapsed_ms;
+
+	if (section_name)
+		find_firmware_section(&section, image, section_name);
+	if (!section.data)
+		return -1;
+	offset = section.data - image->data;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (cfg->emulation) {
+		/* The section may be in different offset on target. */
+		struct firmware_image *target = &cfg->emulation_target.image;
+
+		path = cfg->emulation;
+		if (section_name) {
+			find_firmware_section(&to, target, section_name);
+			if (!to.data)
+				return -1;
+			offset = to.data - target->data;
+			section.size = VB2_MIN(section.size, to.size);
+		}
+	} else {
+		path = create_temp_file(&cfg->tempfiles);
+		if (!path)
+			return -1;
+		if (read_system_firmware_section(image, section_name, path,
+						 cfg->verbosity + 1)) {
+			ERROR("Failed reading %s back from %s.\n", name,
+			      image->programmer);
+			return -1;
+		}
 	}
 
-	free_firmware_image(&to_image);
-	return errorcnt;
+	if (vb2_digest_buffer(section.data, section.size, VB2_HASH_SHA256,
+			      expected, sizeof(expected)) ||
+	    digest_file_region(path, offset, section.size, VB2_HASH_SHA256,
+			       actual, sizeof(actual))) {
+		ERROR("Failed calculating digest of %s.\n", name);
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 +
+		     (end.tv_nsec - start.tv_nsec) / 1000000;
+
+	if (memcmp(expected, actual, sizeof(expected)) != 0) {
+		ERROR("Verification failed for %s on %s (%zu bytes).\n",
+		      name, image->programmer, section.size);
+		return -1;
+	}
+	INFO("Verified %s on %s (%zu bytes) in %ld ms.\n", name,
+	     image->programmer, section.size, elapsed_ms);
+	return 0;
 }
 
 /*
@@ -394,21 +558,32 @@ static int write_firmware(struct updater_config *cfg,
 			  const char *section_name)
 {
 	struct firmware_image *diff_image = NULL;
+	int r;
+
+	if (cfg->plan)
+		return plan_add_write(cfg->plan, image, image == &cfg->image ?
+				      &cfg->image_current : NULL,
+				      section_name);
 
 	if (cfg->emulation) {
 		INFO("(emulation) Writing %s from %s to %s (emu=%s).\n",
 		     section_name ? section_name : "whole image",
 		     image->file_name, image->programmer, cfg->emulation);
 
-		return emulate_write_firmware(
-				cfg->emulation, image, section_name);
-	}
+		r = emulate_write_firmware(cfg, image, section_name);
+	} else {
+		if (cfg->fast_update && image == &cfg->image &&
+		    cfg->image_current.data)
+			diff_image = &cfg->image_current;
 
-	if (cfg->fast_update && image == &cfg->image && cfg->image_current.data)
-		diff_image = &cfg->image_current;
+		r = write_system_firmware(image, diff_image, section_name,
+					  &cfg->tempfiles, cfg->verbosity + 1,
+					  cfg->verify_hash);
+	}
 
-	return write_system_firmware(image, diff_image, section_name,
-				     &cfg->tempfiles, cfg->verbosity + 1);
+	if (!r && cfg->verify_hash)
+		r = verify_firmware(cfg, image, section_name);
+	return r;
 }
 
 /*
@@ -429,7 +604,7 @@ static int has_valid_update(struct updater_config *cfg,
 		return 0;
 	}
 	/* Currently only host emulation is supported. */
-	if (cfg->emulation && !is_host) {
+	if (cfg->emulation && !cfg->plan && !is_host) {
 		INFO("(emulation) Update %s from %s to %s (%d bytes), "
 		     "skipped for non-host targets in emulation.\n",
 		     section_name ? section_name : "whole image",
@@ -517,6 +692,7 @@ static int preserve_management_engine(struct updater_config *cfg,
 	if (section_is_filled_with(&section, 0xFF)) {
 		VB2_DEBUG("ME is probably locked - preserving %s.\n",
 			  FMAP_SI_DESC);
+		plan_add_preserved(cfg->plan, FMAP_SI_DESC);
 		return preserve_firmware_section(
 				image_from, image_to, FMAP_SI_DESC);
 	}
@@ -524,6 +700,7 @@ static int preserve_management_engine(struct updater_config *cfg,
 	if (try_apply_quirk(QUIRK_PRESERVE_ME, cfg) > 0) {
 		VB2_DEBUG("ME needs to be preserved - preserving %s.\n",
 			  FMAP_SI_ME);
+		plan_add_preserved(cfg->plan, FMAP_SI_ME);
 		return preserve_firmware_section(
 				image_from, image_to, FMAP_SI_ME);
 	}
@@ -532,7 +709,8 @@ static int preserve_management_engine(struct updater_config *cfg,
 }
 
 /* Preserve firmware sections by FMAP area flags. */
-static int preserve_fmap_sections(struct firmware_image *from,
+static int preserve_fmap_sections(struct updater_config *cfg,
+				  struct firmware_image *from,
 				  struct firmware_image *to,
 				  int *count)
 {
@@ -553,6 +731,7 @@ static int preserve_fmap_sections(struct firmware_image *from,
 		}
 		VB2_DEBUG("Preserve FMAP area: %.*s\n", FMAP_NAMELEN,
 			  ah->area_name);
+		plan_add_preserved(cfg->plan, ah->area_name);
 		errcnt += preserve_firmware_section(from, to, ah->area_name);
 		(*count)++;
 	}
@@ -564,7 +743,8 @@ static int preserve_fmap_sections(struct firmware_image *from,
  * Preserve old images without "preserve" information in FMAP.
  * We have to use the legacy hard-coded list of names.
  */
-static int preserve_known_sections(struct firmware_image *from,
+static int preserve_known_sections(struct updater_config *cfg,
+				   struct firmware_image *from,
 				   struct firmware_image *to)
 {
 	int errcnt = 0, i;
@@ -581,6 +761,7 @@ static int preserve_known_sections(struct firmware_image *from,
 		if (!firmware_section_exists(from, names[i]))
 			continue;
 		VB2_DEBUG("Preserve firmware section: %s\n", names[i]);
+		plan_add_preserved(cfg->plan, names[i]);
 		errcnt += preserve_firmware_section(from, to, names[i]);
 	}
 	return errcnt;
@@ -597,13 +778,14 @@ static int preserve_images(struct updater_config *cfg)
 	int errcnt = 0, found;
 	struct firmware_image *from = &cfg->image_current, *to = &cfg->image;
 
+	plan_add_preserved(cfg->plan, FMAP_RO_GBB);
 	errcnt += preserve_gbb(from, to, !cfg->factory_update,
 			       cfg->override_gbb_flags, cfg->gbb_flags);
 	errcnt += preserve_management_engine(cfg, from, to);
-	errcnt += preserve_fmap_sections(from, to, &found);
+	errcnt += preserve_fmap_sections(cfg, from, to, &found);
 
 	if (!found)
-		errcnt += preserve_known_sections(from, to);
+		errcnt += preserve_known_sections(cfg, from, to);
 
 	return errcnt;
 }
@@ -1013,6 +1195,8 @@ static enum updater_error_codes update_try_rw_firmware(
 	int has_update = 1;
 	int is_vboot2 = get_system_property(SYS_PROP_FW_VBOOT2, cfg);
 
+	plan_set_mode(cfg->plan, "try-rw");
+	plan_add_preserved(cfg->plan, FMAP_RO_GBB);
 	preserve_gbb(image_from, image_to, 1, 0, 0);
 	if (!wp_enabled && section_needs_update(
 			image_from, image_to, FMAP_RO_SECTION))
@@ -1079,6 +1263,7 @@ static enum updater_error_codes update_rw_firmware(
 	STATUS("RW UPDATE: Updating RW sections (%s, %s, %s, and %s).\n",
 	       FMAP_RW_SECTION_A, FMAP_RW_SECTION_B, FMAP_RW_SHARED,
 	       FMAP_RW_LEGACY);
+	plan_set_mode(cfg->plan, "rw");
 
 	INFO("Checking compatibility...\n");
 	if (check_compatible_root_key(image_from, image_to))
@@ -1108,6 +1293,7 @@ static enum updater_error_codes update_legacy_firmware(
 		struct firmware_image *image_to)
 {
 	STATUS("LEGACY UPDATE: Updating firmware %s.\n", FMAP_RW_LEGACY);
+	plan_set_mode(cfg->plan, "legacy");
 
 	if (write_firmware(cfg, image_to, FMAP_RW_LEGACY))
 		return UPDATE_ERR_WRITE_FIRMWARE;
@@ -1126,6 +1312,7 @@ static enum updater_error_codes update_whole_firmware(
 		struct firmware_image *image_to)
 {
 	STATUS("FULL UPDATE: Updating whole firmware image(s), RO+RW.\n");
+	plan_set_mode(cfg->plan, "full");
 
 	if (preserve_images(cfg))
 		VB2_DEBUG("Failed to preserve some sections - ignore.\n");
@@ -1204,6 +1391,8 @@ enum updater_error_codes update_firmware(struct updater_config *cfg)
 			cfg->check_platform = 0;
 		} else if (ret)
 			return UPDATE_ERR_SYSTEM_IMAGE;
+		plan_add_read(cfg->plan, image_from->programmer,
+			      image_from->size);
 	}
 	STATUS("Current system: %s (RO:%s, RW/A:%s, RW/B:%s).\n",
 	       image_from->file_name, image_from->ro_version,
@@ -1477,9 +1666,17 @@ int updater_setup_config(struct updater_config *cfg,
 	/* Setup values that may change output or decision of other argument. */
 	cfg->verbosity = arg->verbosity;
 	cfg->fast_update = arg->fast_update;
+	cfg->verify_hash = arg->verify_hash;
+	cfg->prop_cache = arg->prop_cache;
 	cfg->factory_update = arg->is_factory;
 	if (arg->force_update)
 		cfg->force_update = 1;
+	if (arg->do_plan) {
+		cfg->plan = plan_new(arg->plan_speed);
+		if (!cfg->plan)
+			return ++errorcnt;
+		plan_set_fast_update(cfg->plan, cfg->fast_update);
+	}
 
 	/* Check incompatible options and return early. */
 	if (arg->do_manifest) {
@@ -1660,6 +1857,8 @@ void updater_delete_config(struct updater_config *cfg)
 	free_firmware_image(&cfg->image_current);
 	free_firmware_image(&cfg->ec_image);
 	free_firmware_image(&cfg->pd_image);
+	close_emulation_target(&cfg->emulation_target);
+	plan_delete(cfg->plan);
 	remove_all_temp_files(&cfg->tempfiles);
 	if (cfg->archive)
 		archive_close(cfg->archive);
@@ -56,6 +56,18 @@ enum {
 	EC_RECOVERY_DONE
 };
 
+/*
+ * The file to write in emulation mode. It is opened and mapped once on first
+ * write, and only the changed blocks are written back (by pwrite).
+ */
+struct emulation_target {
+	int fd;
+	struct firmware_image image;
+};
+
+/* Plan of an update (for --plan), declared in updater_plan.c. */
+struct update_plan;
+
 struct updater_config {
 	struct firmware_image image, image_current;
 	struct firmware_image ec_image, pd_image;
@@ -69,8 +81,12 @@ struct updater_config {
 	int factory_update;
 	int check_platform;
 	int fast_update;
+	int verify_hash;
 	int verbosity;
+	const char *prop_cache;
 	const char *emulation;
+	struct emulation_target emulation_target;
+	struct update_plan *plan;
 	int override_gbb_flags;
 	uint32_t gbb_flags;
 };
@@ -80,11 +96,13 @@ struct updater_config_arguments {
 	char *archive, *quirks, *mode;
 	const char *programmer, *write_protection;
 	char *model, *signature_id;
-	char *emulation, *sys_props;
+	char *emulation, *sys_props, *prop_cache;
 	char *output_dir;
 	char *repack, *unpack;
+	char *plan_speed;
 	int is_factory, try_update, force_update, do_manifest, host_only;
-	int fast_update;
+	int do_plan;
+	int fast_update, verify_hash;
 	int verbosity;
 	int override_gbb_flags;
 	uint32_t gbb_flags;
@@ -104,10 +122,14 @@ struct model_config {
 	int is_white_label;
 };
 
+/* Content-addressed cache of images, declared in updater_archive.c. */
+struct image_cache;
+
 struct manifest {
 	int num;
 	struct model_config *models;
 	struct archive *archive;
+	struct image_cache *image_cache;
 	int default_model;
 	int has_keyset;
 };
@@ -249,7 +271,12 @@ struct manifest *new_manifest_from_archive(struct archive *archive);
 /* Releases all resources allocated by given manifest object. */
 void delete_manifest(struct manifest *manifest);
 
-/* Prints the information of objects in manifest (models and images) in JSON. */
+/*
+ * Prints the information of objects in manifest (models and images) in JSON.
+ * Images shared by multiple models are loaded only once, and for manifests
+ * with more than one model the de-duplication statistics are also printed
+ * (as "_dedup").
+ */
 void print_json_manifest(const struct manifest *manifest);
 
 /*
@@ -280,4 +307,43 @@ int model_apply_white_label(
 		const char *signature_id,
 		const char *image);
 
+/* Functions from updater_plan.c */
+
+/*
+ * Allocates a new update plan object. The throughputs is an optional list of
+ * NAME=READ/WRITE/ERASE[/BLOCK] (in KB/s and bytes) to override default
+ * throughputs of programmers.
+ * Returns the new plan, or NULL on failure.
+ */
+struct update_plan *plan_new(const char *throughputs);
+
+/* Releases all resources allocated by given plan. */
+void plan_delete(struct update_plan *plan);
+
+/*
+ * Records a write of given section (or whole image if section_name is NULL)
+ * from image. If current is not NULL, only erase blocks that are different
+ * from current contents are considered as changed.
+ * Returns 0 on success, otherwise failure.
+ */
+int plan_add_write(struct update_plan *plan,
+		   const struct firmware_image *image,
+		   const struct firmware_image *current,
+		   const char *section_name);
+
+/*
+ * Functions below record information in the plan, and do nothing if plan is
+ * NULL (not in --plan mode).
+ */
+void plan_add_read(struct update_plan *plan, const char *programmer,
+		   uint32_t size);
+void plan_set_mode(struct update_plan *plan, const char *mode);
+void plan_set_fast_update(struct update_plan *plan, int fast_update);
+void plan_set_try(struct update_plan *plan, const char *slot, int tries);
+void plan_add_preserved(struct update_plan *plan, const char *section_name);
+
+/* Prints the plan in JSON format, with the result from update_firmware. */
+void print_json_plan(const struct update_plan *plan,
+		     enum updater_error_codes result);
+
 #endif  /* VBOOT_REFERENCE_FUTILITY_UPDATER_H_ */
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fts.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -745,6 +746,120 @@ static void find_patches_for_model(struct model_config *model,
 	}
 }
 
+/*
+ * Images in a Unified Build archive are usually shared by many models, either
+ * by referring to the same file or by different files with same contents.
+ * The image cache keeps every image file loaded from archive, indexed by both
+ * file name and contents (size and SHA-256 digest), so each unique image is
+ * read, parsed (FMAP and versions) and key-checked only once.
+ */
+struct image_blob {
+	char *file_name;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	/* The blob that owns the parsed image; may be this blob itself. */
+	struct image_blob *content;
+	/* Fields below are only valid when content == this blob. */
+	struct firmware_image image;
+	int load_result;
+	char *root_key_hash, *recovery_key_hash;
+	struct image_blob *next;
+};
+
+struct image_cache {
+	struct image_blob *blobs;
+	int num_loads;
+	int num_files;
+	int num_unique;
+	uint64_t shared_bytes;
+};
+
+/* Releases all resources allocated by given image cache. */
+static void delete_image_cache(struct image_cache *cache)
+{
+	struct image_blob *blob, *next;
+
+	if (!cache)
+		return;
+	for (blob = cache->blobs; blob; blob = next) {
+		next = blob->next;
+		if (blob->content == blob) {
+			free_firmware_image(&blob->image);
+			free(blob->root_key_hash);
+			free(blob->recovery_key_hash);
+		}
+		free(blob->file_name);
+		free(blob);
+	}
+	free(cache);
+}
+
+/*
+ * Loads an image from archive using the image cache.
+ * The returned image is owned by the cache and must not be modified; use
+ * copy_firmware_image if changes are needed.
+ * Returns the blob holding parsed image (check blob->load_result), or NULL
+ * if the file cannot be read.
+ */
+static struct image_blob *image_cache_load(struct image_cache *cache,
+					   struct archive *archive,
+					   const char *file_name)
+{
+	struct image_blob *blob, *found = NULL;
+	uint8_t *data = NULL;
+	uint32_t size = 0;
+
+	cache->num_loads++;
+	for (blob = cache->blobs; blob; blob = blob->next) {
+		if (strcmp(blob->file_name, file_name) != 0)
+			continue;
+		VB2_DEBUG("Reuse loaded image: %s\n", file_name);
+		cache->shared_bytes += blob->content->image.size;
+		return blob->content;
+	}
+
+	if (!archive_has_entry(archive, file_name)) {
+		ERROR("Does not exist: %s\n", file_name);
+		return NULL;
+	}
+	if (archive_read_file(archive, file_name, &data, &size, NULL)) {
+		ERROR("Failed to load %s\n", file_name);
+		return NULL;
+	}
+
+	blob = (struct image_blob *)calloc(1, sizeof(*blob));
+	if (!blob) {
+		ERROR("Internal error: failed to allocate buffer.\n");
+		free(data);
+		return NULL;
+	}
+	blob->file_name = strdup(file_name);
+	vb2_digest_buffer(data, size, VB2_HASH_SHA256, blob->digest,
+			  sizeof(blob->digest));
+	blob->next = cache->blobs;
+	cache->blobs = blob;
+	cache->num_files++;
+
+	for (found = blob->next; found; found = found->next) {
+		if (found->content != found ||
+		    found->image.size != size ||
+		    memcmp(found->digest, blob->digest, sizeof(blob->digest)))
+			continue;
+		VB2_DEBUG("Image %s has same contents as %s\n", file_name,
+			  found->file_name);
+		free(data);
+		cache->shared_bytes += size;
+		blob->content = found;
+		return found;
+	}
+
+	blob->content = blob;
+	blob->image.data = data;
+	blob->image.size = size;
+	blob->load_result = parse_firmware_image(&blob->image, file_name);
+	cache->num_unique++;
+	return blob;
+}
+
 /*
  * Adds and copies one new model config to the existing list of given manifest.
  * Returns a pointer to the newly allocated config, or NULL on failure.
@@ -963,18 +1078,26 @@ struct manifest *new_manifest_from_archive(struct archive *archive)
 
 	manifest.archive = archive;
 	manifest.default_model = -1;
+	manifest.image_cache = (struct image_cache *)calloc(
+			1, sizeof(*manifest.image_cache));
+	if (!manifest.image_cache) {
+		ERROR("Internal error: memory allocation error.\n");
+		return NULL;
+	}
 	archive_walk(archive, &manifest, manifest_scan_entries);
 	if (manifest.num == 0) {
 		const char *image_name = NULL;
-		struct firmware_image image = {0};
+		struct image_blob *blob;
 
 		/* Try to load from current folder. */
 		if (archive_has_entry(archive, old_host_image_name))
 			image_name = old_host_image_name;
 		else if (archive_has_entry(archive, host_image_name))
 			image_name = host_image_name;
-		else
+		else {
+			delete_image_cache(manifest.image_cache);
 			return 0;
+		}
 
 		model.image = strdup(image_name);
 		if (archive_has_entry(archive, ec_name))
@@ -982,15 +1105,18 @@ struct manifest *new_manifest_from_archive(struct archive *archive)
 		if (archive_has_entry(archive, pd_name))
 			model.pd_image = strdup(pd_name);
 		/* Extract model name from FWID: $Vendor_$Platform.$Version */
-		if (!load_firmware_image(&image, image_name, archive)) {
+		blob = image_cache_load(manifest.image_cache, archive,
+					image_name);
+		if (blob && !blob->load_result) {
+			char *version = strdup(blob->image.ro_version);
 			char *token = NULL;
-			if (strtok(image.ro_version, "_"))
+			if (strtok(version, "_"))
 				token = strtok(NULL, ".");
 			if (token && *token) {
 				str_convert(token, tolower);
 				model.name = strdup(token);
 			}
-			free_firmware_image(&image);
+			free(version);
 		}
 		if (!model.name)
 			model.name = strdup(DEFAULT_MODEL_NAME);
@@ -1002,12 +1128,14 @@ struct manifest *new_manifest_from_archive(struct archive *archive)
 	VB2_DEBUG("%d model(s) loaded.\n", manifest.num);
 	if (!manifest.num) {
 		ERROR("No valid configurations found from archive.\n");
+		delete_image_cache(manifest.image_cache);
 		return NULL;
 	}
 
 	new_manifest = (struct manifest *)malloc(sizeof(manifest));
 	if (!new_manifest) {
 		ERROR("Internal error: memory allocation error.\n");
+		delete_image_cache(manifest.image_cache);
 		return NULL;
 	}
 	memcpy(new_manifest, &manifest, sizeof(manifest));
@@ -1031,6 +1159,7 @@ void delete_manifest(struct manifest *manifest)
 		free(model->patches.vblock_b);
 	}
 	free(manifest->models);
+	delete_image_cache(manifest->image_cache);
 	free(manifest);
 }
 
@@ -1047,37 +1176,73 @@ static const char *get_gbb_key_hash(const struct vb2_gbb_header *gbb,
 	return packed_key_sha1_string(key);
 }
 
-/* Prints the information of given image file in JSON format. */
+/*
+ * Prints the key hashes from GBB of given image in JSON format.
+ * The (static) buffer from packed_key_sha1_string can't be used twice in one
+ * printf so we have to print the keys separately.
+ */
+static void print_json_keys(const struct vb2_gbb_header *gbb, int indent)
+{
+	printf("\n%*s\"keys\": { \"root\": \"%s\", ",
+	       indent, "",
+	       get_gbb_key_hash(gbb, gbb->rootkey_offset, gbb->rootkey_size));
+	printf("\"recovery\": \"%s\" },",
+	       get_gbb_key_hash(gbb, gbb->recovery_key_offset,
+				gbb->recovery_key_size));
+}
+
+/*
+ * Prints the information of given image file in JSON format.
+ * Images are loaded from the cache, and only copied when the model needs
+ * patches; key hashes for unpatched images are computed once per contents.
+ */
 static void print_json_image(
 		const char *name, const char *fpath, struct model_config *m,
-		struct archive *archive, int indent, int is_host)
+		struct archive *archive, struct image_cache *cache,
+		int indent, int is_host)
 {
 	struct firmware_image image = {0};
+	struct image_blob *blob;
 	const struct vb2_gbb_header *gbb = NULL;
+	const struct patch_config *p = &m->patches;
+	int need_patch = p->rootkey || p->vblock_a || p->vblock_b;
+
 	if (!fpath)
 		return;
-	if (load_firmware_image(&image, fpath, archive))
+	blob = image_cache_load(cache, archive, fpath);
+	if (!blob || blob->load_result)
 		return;
-	if (is_host)
-		gbb = find_gbb(&image);
-	else
+	if (!is_host)
 		printf(",\n");
 	printf("%*s\"%s\": { \"versions\": { \"ro\": \"%s\", \"rw\": \"%s\" },",
-	       indent, "", name, image.ro_version, image.rw_version_a);
+	       indent, "", name, blob->image.ro_version,
+	       blob->image.rw_version_a);
 	indent += 2;
-	if (is_host && patch_image_by_model(&image, m, archive) != 0) {
-		ERROR("Failed to patch images by model: %s\n", m->name);
-	} else if (gbb) {
-		printf("\n%*s\"keys\": { \"root\": \"%s\", ",
-		       indent, "",
-		       get_gbb_key_hash(gbb, gbb->rootkey_offset,
-					gbb->rootkey_size));
-		printf("\"recovery\": \"%s\" },",
-		       get_gbb_key_hash(gbb, gbb->recovery_key_offset,
-					gbb->recovery_key_size));
+	if (is_host && need_patch) {
+		if (copy_firmware_image(&image, &blob->image))
+			return;
+		gbb = find_gbb(&image);
+		if (patch_image_by_model(&image, m, archive) != 0)
+			ERROR("Failed to patch images by model: %s\n", m->name);
+		else if (gbb)
+			print_json_keys(gbb, indent);
+		free_firmware_image(&image);
+	} else if (is_host) {
+		if (!blob->root_key_hash) {
+			gbb = find_gbb(&blob->image);
+			blob->root_key_hash = strdup(gbb ? get_gbb_key_hash(
+					gbb, gbb->rootkey_offset,
+					gbb->rootkey_size) : "");
+			blob->recovery_key_hash = strdup(gbb ? get_gbb_key_hash(
+					gbb, gbb->recovery_key_offset,
+					gbb->recovery_key_size) : "");
+		}
+		if (*blob->root_key_hash)
+			printf("\n%*s\"keys\": { \"root\": \"%s\", "
+			       "\"recovery\": \"%s\" },", indent, "",
+			       blob->root_key_hash, blob->recovery_key_hash);
 	}
 	printf("\n%*s\"image\": \"%s\" }", indent, "", fpath);
-	free_firmware_image(&image);
 }
 
 /* Prints the information of objects in manifest (models and images) in JSON. */
@@ -1085,15 +1250,24 @@ void print_json_manifest(const struct manifest *manifest)
 {
 	int i, indent;
 	struct archive *ar = manifest->archive;
+	struct image_cache *cache = manifest->image_cache;
+
+	if (!cache) {
+		cache = (struct image_cache *)calloc(1, sizeof(*cache));
+		if (!cache) {
+			ERROR("Internal error: memory allocation error.\n");
+			return;
+		}
+	}
 
 	printf("{\n");
 	for (i = 0, indent = 2; i < manifest->num; i++) {
 		struct model_config *m = &manifest->models[i];
 		printf("%s%*s\"%s\": {\n", i ? ",\n" : "", indent, "", m->name);
 		indent += 2;
-		print_json_image("host", m->image, m, ar, indent, 1);
-		print_json_image("ec", m->ec_image, m, ar, indent, 0);
-		print_json_image("pd", m->pd_image, m, ar, indent, 0);
+		print_json_image("host", m->image, m, ar, cache, indent, 1);
+		print_json_image("ec", m->ec_image, m, ar, cache, indent, 0);
+		print_json_image("pd", m->pd_image, m, ar, cache, indent, 0);
 		if (m->patches.rootkey) {
 			struct patch_config *p = &m->patches;
 			printf(",\n%*s\"patches\": { \"rootkey\": \"%s\", "
@@ -1108,5 +1282,15 @@ void print_json_manifest(const struct manifest *manifest)
 		indent -= 2;
 		assert(indent == 2);
 	}
+	if (manifest->num > 1)
+		printf(",\n%*s\"_dedup\": { \"loads\": %d, \"files\": %d, "
+		       "\"unique\": %d, \"shared_bytes\": %" PRIu64 " }",
+		       indent, "", cache->num_loads, cache->num_files,
+		       cache->num_unique, cache->shared_bytes);
 	printf("\n}\n");
+	VB2_DEBUG("Image cache: %d loads, %d files, %d unique, %" PRIu64
+		  " bytes shared.\n", cache->num_loads, cache->num_files,
+		  cache->num_unique, cache->shared_bytes);
+	if (cache != manifest->image_cache)
+		delete_image_cache(cache);
 }
@@ -0,0 +1,424 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Planning (dry-run) firmware updates: instead of writing the firmware, the
+ * updater records what it would write and estimates the cost.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "updater.h"
+
+/* Throughput of a programmer, in KB/s, and the erase block size in bytes. */
+struct plan_throughput {
+	const char *programmer;
+	uint32_t read_kbps;
+	uint32_t write_kbps;
+	uint32_t erase_kbps;
+	uint32_t erase_block_size;
+};
+
+/*
+ * Default throughput of known programmers. The numbers are typical values
+ * measured on SPI flash chips and can be changed by --plan_speed.
+ * The first entry matching the programmer name (before ':') will be used, and
+ * the last entry is the fall back for unknown programmers.
+ */
+static const struct plan_throughput default_throughputs[] = {
+	{"host", 12000, 600, 400, 4096},
+	{"ec", 300, 60, 60, 4096},
+	{"raiden_debug_spi", 600, 120, 120, 4096},
+	{"ft2232_spi", 1200, 150, 150, 4096},
+	{"dummy", 1000000, 1000000, 1000000, 4096},
+	{"", 1000, 100, 100, 4096},
+};
+
+enum plan_op {
+	PLAN_READ,
+	PLAN_WRITE,
+};
+
+struct plan_step {
+	enum plan_op op;
+	const char *programmer;
+	char *section;
+	uint32_t offset, size;
+	/* Only valid for PLAN_WRITE. */
+	int has_diff;
+	uint32_t changed_bytes;
+	uint32_t erase_blocks;
+	uint32_t erase_block_size;
+	/* Cost */
+	uint64_t bytes_read, bytes_erased, bytes_written;
+	uint64_t time_us;
+	struct plan_step *next;
+};
+
+struct plan_name {
+	char *name;
+	struct plan_name *next;
+};
+
+struct update_plan {
+	const char *mode;
+	char *try_slot;
+	int try_count;
+	int fast_update;
+	struct plan_throughput *throughputs;
+	int num_throughputs;
+	struct plan_name *preserved;
+	struct plan_step *steps, *last_step;
+};
+
+/*
+ * Parses the throughput settings in format NAME=READ/WRITE/ERASE[/BLOCK],
+ * separated by space or ';'. Speeds are in KB/s and BLOCK is in bytes.
+ * Returns 0 on success, otherwise number of failures.
+ */
+static int plan_parse_throughputs(struct update_plan *plan, const char *list)
+{
+	char *buf = strdup(list), *token, *equ;
+	const char *delimiters = "; \t\n";
+	int errorcnt = 0;
+
+	for (token = strtok(buf, delimiters); token;
+	     token = strtok(NULL, delimiters)) {
+		struct plan_throughput t = {0};
+		int n;
+
+		equ = strchr(token, '=');
+		if (!equ) {
+			ERROR("Invalid throughput (no '='): %s\n", token);
+			errorcnt++;
+			continue;
+		}
+		*equ = '\0';
+		n = sscanf(equ + 1, "%" SCNu32 "/%" SCNu32 "/%" SCNu32
+			   "/%" SCNu32, &t.read_kbps, &t.write_kbps,
+			   &t.erase_kbps, &t.erase_block_size);
+		if (n < 3 || !t.read_kbps || !t.write_kbps || !t.erase_kbps ||
+		    (n == 4 && !t.erase_block_size)) {
+			ERROR("Invalid throughput for %s: %s\n", token,
+			      equ + 1);
+			errorcnt++;
+			continue;
+		}
+		if (n == 3)
+			t.erase_block_size = 4096;
+		t.programmer = strdup(token);
+
+		plan->throughputs = (struct plan_throughput *)realloc(
+				plan->throughputs,
+				(plan->num_throughputs + 1) * sizeof(t));
+		assert(plan->throughputs);
+		/* User settings must be matched before defaults. */
+		memmove(plan->throughputs + 1, plan->throughputs,
+			plan->num_throughputs * sizeof(t));
+		plan->throughputs[0] = t;
+		plan->num_throughputs++;
+	}
+	free(buf);
+	return errorcnt;
+}
+
+/*
+ * Allocates a new update plan object, with optional throughput settings.
+ * Returns the new plan, or NULL on failure.
+ */
+struct update_plan *plan_new(const char *throughputs)
+{
+	struct update_plan *plan;
+	int i;
+
+	plan = (struct update_plan *)calloc(1, sizeof(*plan));
+	if (!plan)
+		return NULL;
+
+	plan->num_throughputs = ARRAY_SIZE(default_throughputs);
+	plan->throughputs = (struct plan_throughput *)calloc(
+			plan->num_throughputs, sizeof(*plan->throughputs));
+	assert(plan->throughputs);
+	for (i = 0; i < plan->num_throughputs; i++) {
+		plan->throughputs[i] = default_throughputs[i];
+		plan->throughputs[i].programmer = strdup(
+				default_throughputs[i].programmer);
+	}
+
+	if (throughputs && plan_parse_throughputs(plan, throughputs)) {
+		plan_delete(plan);
+		return NULL;
+	}
+	return plan;
+}
+
+/* Releases all resources allocated by given plan. */
+void plan_delete(struct update_plan *plan)
+{
+	struct plan_step *step, *next_step;
+	struct plan_name *name, *next_name;
+	int i;
+
+	if (!plan)
+		return;
+	for (step = plan->steps; step; step = next_step) {
+		next_step = step->next;
+		free(step->section);
+		free(step);
+	}
+	for (name = plan->preserved; name; name = next_name) {
+		next_name = name->next;
+		free(name->name);
+		free(name);
+	}
+	for (i = 0; i < plan->num_throughputs; i++)
+		free((char *)plan->throughputs[i].programmer);
+	free(plan->throughputs);
+	free(plan->try_slot);
+	free(plan);
+}
+
+/* Finds the throughput settings for given programmer. */
+static const struct plan_throughput *plan_find_throughput(
+		const struct update_plan *plan, const char *programmer)
+{
+	size_t len = strcspn(programmer, ":");
+	int i;
+
+	for (i = 0; i < plan->num_throughputs; i++) {
+		const char *name = plan->throughputs[i].programmer;
+		if (strlen(name) == len && strncmp(name, programmer, len) == 0)
+			return &plan->throughputs[i];
+	}
+	/* The last entry is the default. */
+	return &plan->throughputs[plan->num_throughputs - 1];
+}
+
+/* Returns the time (in microseconds) to process given bytes. */
+static uint64_t plan_time_us(uint64_t bytes, uint32_t kbps)
+{
+	return bytes * 1000000 / ((uint64_t)kbps * 1024);
+}
+
+/* Allocates and appends a new step to plan. */
+static struct plan_step *plan_add_step(struct update_plan *plan,
+				       enum plan_op op,
+				       const char *programmer,
+				       const char *section_name)
+{
+	struct plan_step *step;
+
+	step = (struct plan_step *)calloc(1, sizeof(*step));
+	assert(step);
+	step->op = op;
+	step->programmer = programmer;
+	if (section_name)
+		step->section = strdup(section_name);
+	if (plan->last_step)
+		plan->last_step->next = step;
+	else
+		plan->steps = step;
+	plan->last_step = step;
+	return step;
+}
+
+/* Records that the firmware of given size will be read from programmer. */
+void plan_add_read(struct update_plan *plan, const char *programmer,
+		   uint32_t size)
+{
+	const struct plan_throughput *t;
+	struct plan_step *step;
+
+	if (!plan)
+		return;
+	t = plan_find_throughput(plan, programmer);
+	step = plan_add_step(plan, PLAN_READ, programmer, NULL);
+	step->size = size;
+	step->bytes_read = size;
+	step->time_us = plan_time_us(size, t->read_kbps);
+}
+
+/*
+ * Records a write of given section (or whole image if section_name is NULL)
+ * from image. If current is not NULL, only erase blocks that are different
+ * from current contents are considered as changed; otherwise all blocks in
+ * the section will be erased and written.
+ * Returns 0 on success, otherwise failure.
+ */
+int plan_add_write(struct update_plan *plan,
+		   const struct firmware_image *image,
+		   const struct firmware_image *current,
+		   const char *section_name)
+{
+	const struct plan_throughput *t;
+	struct firmware_section section = {image->data, image->size};
+	struct plan_step *step;
+	uint32_t offset = 0, block, i, len;
+
+	assert(plan);
+	if (section_name) {
+		find_firmware_section(&section, image, section_name);
+		if (!section.data) {
+			ERROR("No section %s in image %s.\n", section_name,
+			      image->file_name);
+			return -1;
+		}
+		offset = section.data - image->data;
+	}
+
+	t = plan_find_throughput(plan, image->programmer);
+	block = t->erase_block_size;
+	step = plan_add_step(plan, PLAN_WRITE, image->programmer,
+			     section_name);
+	step->offset = offset;
+	step->size = section.size;
+	step->erase_block_size = block;
+	step->has_diff = (current && current->data &&
+			  current->size == image->size);
+
+	/* Erase blocks are aligned to the flash, not the section. */
+	for (i = offset - offset % block; i < offset + section.size;
+	     i += block) {
+		uint32_t start = VB2_MAX(i, offset);
+		uint32_t end = VB2_MIN(i + block, offset + section.size);
+		uint32_t changed = 0, j;
+
+		len = end - start;
+		if (!step->has_diff) {
+			changed = len;
+		} else {
+			for (j = start; j < end; j++)
+				changed += image->data[j] != current->data[j];
+		}
+		if (!changed)
+			continue;
+		step->changed_bytes += changed;
+		step->erase_blocks++;
+	}
+
+	/*
+	 * Without --fast, flashrom reads the section to find what to erase,
+	 * and reads again to verify after writing.
+	 */
+	if (!plan->fast_update)
+		step->bytes_read = 2 * (uint64_t)section.size;
+	step->bytes_erased = (uint64_t)step->erase_blocks * block;
+	step->bytes_written = step->bytes_erased;
+	step->time_us = (plan_time_us(step->bytes_read, t->read_kbps) +
+			 plan_time_us(step->bytes_erased, t->erase_kbps) +
+			 plan_time_us(step->bytes_written, t->write_kbps));
+
+	INFO("(plan) %s %s: %u bytes changed in %u erase blocks.\n",
+	     image->programmer, section_name ? section_name : "whole image",
+	     step->changed_bytes, step->erase_blocks);
+	return 0;
+}
+
+/* Records the update mode decided by updater. */
+void plan_set_mode(struct update_plan *plan, const char *mode)
+{
+	if (plan)
+		plan->mode = mode;
+}
+
+/* Records whether the update will be performed with --fast. */
+void plan_set_fast_update(struct update_plan *plan, int fast_update)
+{
+	if (plan)
+		plan->fast_update = fast_update;
+}
+
+/* Records the slot and try count to be set for next boot. */
+void plan_set_try(struct update_plan *plan, const char *slot, int tries)
+{
+	if (!plan)
+		return;
+	free(plan->try_slot);
+	plan->try_slot = strdup(slot);
+	plan->try_count = tries;
+}
+
+/* Records a section that will be preserved from current firmware. */
+void plan_add_preserved(struct update_plan *plan, const char *section_name)
+{
+	struct plan_name *name, **last;
+
+	if (!plan)
+		return;
+	for (last = &plan->preserved; *last; last = &(*last)->next) {
+		if (strcmp((*last)->name, section_name) == 0)
+			return;
+	}
+	name = (struct plan_name *)calloc(1, sizeof(*name));
+	assert(name);
+	name->name = strndup(section_name, FMAP_NAMELEN);
+	*last = name;
+}
+
+/* Prints the plan in JSON format, with the result from update_firmware. */
+void print_json_plan(const struct update_plan *plan,
+		     enum updater_error_codes result)
+{
+	const struct plan_step *step;
+	const struct plan_name *name;
+	uint64_t bytes_read = 0, bytes_erased = 0, bytes_written = 0;
+	uint64_t time_us = 0;
+	uint32_t erase_blocks = 0;
+
+	printf("{\n  \"mode\": \"%s\",\n", plan->mode ? plan->mode : "none");
+	printf("  \"result\": { \"code\": %d, \"message\": \"%s\" },\n",
+	       result, updater_error_messages[
+			VB2_MIN(result, UPDATE_ERR_UNKNOWN)]);
+	printf("  \"fast\": %s,\n", plan->fast_update ? "true" : "false");
+	if (plan->try_slot)
+		printf("  \"try\": { \"slot\": \"%s\", \"count\": %d },\n",
+		       plan->try_slot, plan->try_count);
+
+	printf("  \"preserved\": [");
+	for (name = plan->preserved; name; name = name->next)
+		printf("%s\"%s\"", name == plan->preserved ? "" : ", ",
+		       name->name);
+	printf("],\n");
+
+	printf("  \"steps\": [");
+	for (step = plan->steps; step; step = step->next) {
+		printf("%s\n    { \"op\": \"%s\", \"programmer\": \"%s\", ",
+		       step == plan->steps ? "" : ",",
+		       step->op == PLAN_READ ? "read" : "write",
+		       step->programmer);
+		if (step->section)
+			printf("\"section\": \"%s\", ", step->section);
+		printf("\"offset\": %u, \"size\": %u,", step->offset,
+		       step->size);
+		if (step->op == PLAN_WRITE)
+			printf("\n      \"diff\": %s, \"changed_bytes\": %u, "
+			       "\"erase_blocks\": %u, "
+			       "\"erase_block_size\": %u,",
+			       step->has_diff ? "true" : "false",
+			       step->changed_bytes, step->erase_blocks,
+			       step->erase_block_size);
+		printf("\n      \"bytes_read\": %" PRIu64 ", "
+		       "\"bytes_erased\": %" PRIu64 ", "
+		       "\"bytes_written\": %" PRIu64 ", "
+		       "\"time_ms\": %" PRIu64 " }",
+		       step->bytes_read, step->bytes_erased,
+		       step->bytes_written, step->time_us / 1000);
+
+		bytes_read += step->bytes_read;
+		bytes_erased += step->bytes_erased;
+		bytes_written += step->bytes_written;
+		erase_blocks += step->erase_blocks;
+		time_us += step->time_us;
+	}
+	printf("%s],\n", plan->steps ? "\n  " : "");
+
+	printf("  \"total\": { \"bytes_read\": %" PRIu64 ", "
+	       "\"bytes_erased\": %" PRIu64 ", \"bytes_written\": %" PRIu64
+	       ", \"erase_blocks\": %u, \"time_ms\": %" PRIu64 " }\n}\n",
+	       bytes_read, bytes_erased, bytes_written, erase_blocks,
+	       time_us / 1000);
+}
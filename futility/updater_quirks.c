@@ -143,7 +143,10 @@ static int ec_ro_software_sync(struct updater_config *cfg)
 		      "update by EC RO software sync.\n");
 		return 1;
 	}
-	VbSetSystemPropertyInt("try_ro_sync", 1);
+	if (cfg->plan)
+		INFO("(plan) Schedule EC RO software sync on next boot.\n");
+	else
+		VbSetSystemPropertyInt("try_ro_sync", 1);
 	return 0;
 }
 
@@ -9,6 +9,7 @@
 #include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #if defined (__FreeBSD__)
 #include <sys/wait.h>
@@ -21,7 +22,9 @@
 #include "updater.h"
 
 #define COMMAND_BUFFER_SIZE 256
+#define DIGEST_BLOCK_SIZE 65536
 #define FLASHROM_OUTPUT_WP_PATTERN "write protect is "
+#define SYS_PROP_CACHE_TTL 300  /* Seconds. */
 
 enum flashrom_ops {
 	FLASHROM_READ,
@@ -34,7 +37,10 @@ static const char * const STR_REV = "rev",
 		  * const FLASHROM_OUTPUT_WP_ENABLED =
 			  FLASHROM_OUTPUT_WP_PATTERN "enabled",
 		  * const FLASHROM_OUTPUT_WP_DISABLED =
-			  FLASHROM_OUTPUT_WP_PATTERN "disabled";
+			  FLASHROM_OUTPUT_WP_PATTERN "disabled",
+		  * const BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id",
+		  * const CACHE_KEY_BOOT_ID = "boot_id",
+		  * const CACHE_KEY_TIMESTAMP = "timestamp";
 
 /*
  * Strips a string (usually from shell execution output) by removing all the
@@ -182,9 +188,6 @@ static int load_firmware_version(struct firmware_image *image,
 int load_firmware_image(struct firmware_image *image, const char *file_name,
 			struct archive *archive)
 {
-	int ret = IMAGE_LOAD_SUCCESS;
-	const char *section_a = NULL, *section_b = NULL;
-
 	if (!file_name) {
 		ERROR("No file name given\n");
 		return IMAGE_READ_FAILURE;
@@ -202,6 +205,20 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 		return IMAGE_READ_FAILURE;
 	}
 
+	return parse_firmware_image(image, file_name);
+}
+
+/*
+ * Parses a firmware image already loaded in image->data and image->size,
+ * and fills the FMAP and version information in image.
+ * Returns IMAGE_LOAD_SUCCESS on success, or IMAGE_PARSE_FAILURE for non-vboot
+ * images.
+ */
+int parse_firmware_image(struct firmware_image *image, const char *file_name)
+{
+	int ret = IMAGE_LOAD_SUCCESS;
+	const char *section_a = NULL, *section_b = NULL;
+
 	VB2_DEBUG("Image size: %d\n", image->size);
 	assert(image->data);
 	image->file_name = strdup(file_name);
@@ -236,6 +253,36 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 	return ret;
 }
 
+/*
+ * Duplicates a loaded firmware image so the copy can be modified (and freed)
+ * independently. The programmer of `to` is preserved.
+ * Returns 0 on success, otherwise failure.
+ */
+int copy_firmware_image(struct firmware_image *to,
+			const struct firmware_image *from)
+{
+	const char *programmer = to->programmer;
+
+	memset(to, 0, sizeof(*to));
+	to->programmer = programmer;
+	to->size = from->size;
+	to->data = (uint8_t *)malloc(from->size);
+	if (!to->data) {
+		ERROR("Failed to allocate %u bytes for %s.\n", from->size,
+		      from->file_name);
+		return -1;
+	}
+	memcpy(to->data, from->data, from->size);
+	if (from->fmap_header)
+		to->fmap_header = (FmapHeader *)(to->data +
+				((uint8_t *)from->fmap_header - from->data));
+	to->file_name = strdup(from->file_name);
+	to->ro_version = strdup(from->ro_version);
+	to->rw_version_a = strdup(from->rw_version_a);
+	to->rw_version_b = strdup(from->rw_version_b);
+	return 0;
+}
+
 /*
  * Generates a temporary file for snapshot of firmware image contents.
  *
@@ -655,16 +702,32 @@ int load_system_firmware(struct firmware_image *image,
 	return r;
 }
 
+/*
+ * Reads a section (or whole image if section_name is NULL) of system firmware
+ * into given file, using the programmer of image. Contents outside the
+ * section in the file are undefined.
+ * Returns 0 if success, non-zero if error.
+ */
+int read_system_firmware_section(const struct firmware_image *image,
+				 const char *section_name,
+				 const char *file_path,
+				 int verbosity)
+{
+	return host_flashrom(FLASHROM_READ, file_path, image->programmer,
+			     verbosity, section_name, NULL);
+}
+
 /*
  * Writes a section from given firmware image to system firmware.
  * If section_name is NULL, write whole image.
+ * If no_verify is set, flashrom will not read back to verify the contents.
  * Returns 0 if success, non-zero if error.
  */
 int write_system_firmware(const struct firmware_image *image,
 			  const struct firmware_image *diff_image,
 			  const char *section_name,
 			  struct tempfile *tempfiles,
-			  int verbosity)
+			  int verbosity, int no_verify)
 {
 	const char *tmp_path = get_firmware_image_temp_file(image, tempfiles);
 	const char *tmp_diff = NULL;
@@ -682,6 +745,8 @@ int write_system_firmware(const struct firmware_image *image,
 		if (!tmp_diff)
 			return -1;
 		ASPRINTF(&extra, "--noverify --diff=%s", tmp_diff);
+	} else if (no_verify) {
+		extra = strdup("--noverify");
 	}
 
 	r = host_flashrom(FLASHROM_WRITE, tmp_path, programmer, verbosity,
@@ -690,17 +755,255 @@ int write_system_firmware(const struct firmware_image *image,
 	return r;
 }
 
+/*
+ * Calculates the digest of a region in file, by reading the file block by
+ * block (so the region is never fully loaded in memory).
+ * Returns 0 if success, non-zero if error.
+ */
+int digest_file_region(const char *file_path, uint32_t offset, uint32_t size,
+		       enum vb2_hash_algorithm hash_alg, uint8_t *digest,
+		       uint32_t digest_size)
+{
+	struct vb2_digest_context dc;
+	uint8_t buf[DIGEST_BLOCK_SIZE];
+	FILE *fp;
+	size_t len;
+	int r = 0;
+
+	fp = fopen(file_path, "rb");
+	if (!fp) {
+		ERROR("Cannot open %s.\n", file_path);
+		return -1;
+	}
+	if (fseek(fp, offset, SEEK_SET) != 0 ||
+	    vb2_digest_init(&dc, hash_alg) != VB2_SUCCESS) {
+		fclose(fp);
+		return -1;
+	}
+	while (size && !r) {
+		len = fread(buf, 1, VB2_MIN(size, sizeof(buf)), fp);
+		if (!len) {
+			ERROR("Failed reading %s (%u bytes left).\n",
+			      file_path, size);
+			r = -1;
+			break;
+		}
+		r = vb2_digest_extend(&dc, buf, len);
+		size -= len;
+	}
+	fclose(fp);
+	if (!r)
+		r = vb2_digest_finalize(&dc, digest, digest_size);
+	return r;
+}
+
 /* Helper function to configure all properties. */
 void init_system_properties(struct system_property *props, int num)
 {
 	memset(props, 0, num * sizeof(*props));
 	assert(num >= SYS_PROP_MAX);
-	props[SYS_PROP_MAINFW_ACT].getter = host_get_mainfw_act;
-	props[SYS_PROP_TPM_FWVER].getter = host_get_tpm_fwver;
-	props[SYS_PROP_FW_VBOOT2].getter = host_get_fw_vboot2;
-	props[SYS_PROP_PLATFORM_VER].getter = host_get_platform_version;
-	props[SYS_PROP_WP_HW].getter = host_get_wp_hw;
-	props[SYS_PROP_WP_SW].getter = host_get_wp_sw;
+	props[SYS_PROP_MAINFW_ACT] = (struct system_property){
+		.name = "mainfw_act", .getter = host_get_mainfw_act,
+		.crossystem = 1 };
+	props[SYS_PROP_TPM_FWVER] = (struct system_property){
+		.name = "tpm_fwver", .getter = host_get_tpm_fwver,
+		.crossystem = 1 };
+	props[SYS_PROP_FW_VBOOT2] = (struct system_property){
+		.name = "fw_vboot2", .getter = host_get_fw_vboot2,
+		.crossystem = 1 };
+	props[SYS_PROP_PLATFORM_VER] = (struct system_property){
+		.name = "platform_ver", .getter = host_get_platform_version };
+	props[SYS_PROP_WP_HW] = (struct system_property){
+		.name = "wp_hw", .getter = host_get_wp_hw, .crossystem = 1 };
+	props[SYS_PROP_WP_SW] = (struct system_property){
+		.name = "wp_sw", .getter = host_get_wp_sw };
+}
+
+int fetch_crossystem_properties(struct system_property *props, int num)
+{
+	int i, fetched = 0;
+
+	for (i = 0; i < num; i++) {
+		if (props[i].initialized || !props[i].crossystem)
+			continue;
+		props[i].value = props[i].getter();
+		props[i].initialized = 1;
+		fetched++;
+	}
+	return fetched;
+}
+
+/*
+ * Reads the ID of current boot into buf.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int get_boot_id(char *buf, size_t size)
+{
+	FILE *fp = fopen(BOOT_ID_PATH, "r");
+	int r = -1;
+
+	if (!fp)
+		return r;
+	if (fgets(buf, size, fp)) {
+		strip_string(buf, NULL);
+		r = buf[0] ? 0 : -1;
+	}
+	fclose(fp);
+	return r;
+}
+
+/*
+ * Loads properties that are not initialized yet from the cache file, if it was
+ * created in the boot given by boot_id and has not expired.
+ * Returns the timestamp of the cache, or -1 if it can't be used.
+ */
+static long long load_system_properties_cache(struct system_property *props,
+					      int num, const char *cache_file,
+					      const char *boot_id)
+{
+	char line[COMMAND_BUFFER_SIZE], *value;
+	int i, valid = 0;
+	long long timestamp = -1, now = time(NULL);
+	FILE *fp = fopen(cache_file, "r");
+
+	if (!fp)
+		return -1;
+
+	/* The header (boot ID and timestamp) must come before values. */
+	while (fgets(line, sizeof(line), fp)) {
+		strip_string(line, NULL);
+		value = strchr(line, '=');
+		if (!value)
+			continue;
+		*value++ = '\0';
+
+		if (strcmp(line, CACHE_KEY_BOOT_ID) == 0) {
+			if (strcmp(value, boot_id) != 0)
+				break;
+			valid |= 1;
+			continue;
+		}
+		if (strcmp(line, CACHE_KEY_TIMESTAMP) == 0) {
+			timestamp = strtoll(value, NULL, 0);
+			if (timestamp > now ||
+			    now - timestamp > SYS_PROP_CACHE_TTL)
+				break;
+			valid |= 2;
+			continue;
+		}
+		if (valid != 3)
+			break;
+
+		for (i = 0; i < num; i++) {
+			if (props[i].initialized || !props[i].name ||
+			    strcmp(props[i].name, line) != 0)
+				continue;
+			props[i].value = strtol(value, NULL, 0);
+			props[i].initialized = 1;
+			props[i].cached = 1;
+			VB2_DEBUG("Loaded %s=%d from cache.\n", props[i].name,
+				  props[i].value);
+		}
+	}
+	fclose(fp);
+	if (valid != 3) {
+		VB2_DEBUG("Ignored stale cache: %s\n", cache_file);
+		return -1;
+	}
+	return timestamp;
+}
+
+/*
+ * Saves properties specified by the mask to the cache file, with the given
+ * timestamp.
+ * The file is replaced atomically so concurrent readers never see partial
+ * contents.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int save_system_properties_cache(const struct system_property *props,
+					int num, const uint8_t *mask,
+					const char *cache_file,
+					const char *boot_id,
+					long long timestamp)
+{
+	char *tmp_path = NULL;
+	FILE *fp;
+	int i, r = 0;
+
+	ASPRINTF(&tmp_path, "%s.%d", cache_file, getpid());
+	fp = fopen(tmp_path, "w");
+	if (!fp) {
+		VB2_DEBUG("Failed to create cache: %s\n", tmp_path);
+		free(tmp_path);
+		return -1;
+	}
+	fprintf(fp, "%s=%s\n", CACHE_KEY_BOOT_ID, boot_id);
+	fprintf(fp, "%s=%lld\n", CACHE_KEY_TIMESTAMP, timestamp);
+	for (i = 0; i < num; i++) {
+		/* Negative values are errors and should be retried. */
+		if (mask[i] && props[i].name && props[i].value >= 0)
+			fprintf(fp, "%s=%d\n", props[i].name, props[i].value);
+	}
+	if (fclose(fp) != 0 || rename(tmp_path, cache_file) != 0) {
+		VB2_DEBUG("Failed to save cache: %s\n", cache_file);
+		unlink(tmp_path);
+		r = -1;
+	}
+	free(tmp_path);
+	return r;
+}
+
+int fetch_system_property(struct system_property *props, int num, int index,
+			  const char *cache_file)
+{
+	char boot_id[COMMAND_BUFFER_SIZE];
+	uint8_t mask[SYS_PROP_MAX] = {0};
+	struct system_property *prop = &props[index];
+	long long timestamp = -1;
+	int i;
+
+	assert(num <= SYS_PROP_MAX && index < num);
+	if (prop->initialized)
+		return prop->value;
+
+	if (cache_file && get_boot_id(boot_id, sizeof(boot_id))) {
+		VB2_DEBUG("Unknown boot ID, not using cache %s.\n", cache_file);
+		cache_file = NULL;
+	}
+	if (cache_file) {
+		timestamp = load_system_properties_cache(props, num,
+							 cache_file, boot_id);
+		if (prop->initialized)
+			return prop->value;
+	}
+
+	if (prop->crossystem) {
+		for (i = 0; i < num; i++)
+			mask[i] = props[i].crossystem && !props[i].initialized;
+		fetch_crossystem_properties(props, num);
+	} else {
+		prop->value = prop->getter();
+		prop->initialized = 1;
+		mask[index] = 1;
+	}
+
+	if (!cache_file)
+		return prop->value;
+
+	/*
+	 * Add the values just fetched to the cache.  Values loaded from a cache
+	 * which is still valid are kept, along with its timestamp so they still
+	 * expire in time.
+	 */
+	if (timestamp < 0) {
+		timestamp = time(NULL);
+	} else {
+		for (i = 0; i < num; i++)
+			mask[i] |= props[i].cached;
+	}
+	save_system_properties_cache(props, num, mask, cache_file, boot_id,
+				     timestamp);
+	return prop->value;
 }
 
 /*
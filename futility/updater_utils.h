@@ -9,6 +9,7 @@
 #define VBOOT_REFERENCE_FUTILITY_UPDATER_UTILS_H_
 
 #include <stdio.h>
+#include "2sha.h"
 #include "fmap.h"
 
 #define ASPRINTF(strp, ...) do { if (asprintf(strp, __VA_ARGS__) >= 0) break; \
@@ -80,6 +81,22 @@ enum {
 int load_firmware_image(struct firmware_image *image, const char *file_name,
 			struct archive *archive);
 
+/*
+ * Parses a firmware image already loaded in image->data and image->size,
+ * and fills the FMAP and version information in image.
+ * Returns IMAGE_LOAD_SUCCESS on success, or IMAGE_PARSE_FAILURE for non-vboot
+ * images.
+ */
+int parse_firmware_image(struct firmware_image *image, const char *file_name);
+
+/*
+ * Duplicates a loaded firmware image so the copy can be modified (and freed)
+ * independently. The programmer of `to` is preserved.
+ * Returns 0 on success, otherwise failure.
+ */
+int copy_firmware_image(struct firmware_image *to,
+			const struct firmware_image *from);
+
 /*
  * Loads the active system firmware image (usually from SPI flash chip).
  * Returns 0 if success, non-zero if error.
@@ -98,16 +115,37 @@ void free_firmware_image(struct firmware_image *image);
 const char *get_firmware_image_temp_file(const struct firmware_image *image,
 					 struct tempfile *tempfiles);
 
+/*
+ * Reads a section (or whole image if section_name is NULL) of system firmware
+ * into given file, using the programmer of image. Contents outside the
+ * section in the file are undefined.
+ * Returns 0 if success, non-zero if error.
+ */
+int read_system_firmware_section(const struct firmware_image *image,
+				 const char *section_name,
+				 const char *file_path,
+				 int verbosity);
+
 /*
  * Writes a section from given firmware image to system firmware.
  * If section_name is NULL, write whole image.
+ * If no_verify is set, flashrom will not read back to verify the contents.
  * Returns 0 if success, non-zero if error.
  */
 int write_system_firmware(const struct firmware_image *image,
 			  const struct firmware_image *diff_image,
 			  const char *section_name,
 			  struct tempfile *tempfiles,
-			  int verbosity);
+			  int verbosity, int no_verify);
+
+/*
+ * Calculates the digest of a region in file, by reading the file block by
+ * block (so the region is never fully loaded in memory).
+ * Returns 0 if success, non-zero if error.
+ */
+int digest_file_region(const char *file_path, uint32_t offset, uint32_t size,
+		       enum vb2_hash_algorithm hash_alg, uint8_t *digest,
+		       uint32_t digest_size);
 
 struct firmware_section {
 	uint8_t *data;
@@ -205,9 +243,14 @@ const char *cbfs_extract_file(const char *image_file,
 
 /* Utilities for accessing system properties */
 struct system_property {
+	const char *name;
 	int (*getter)(void);
 	int value;
 	int initialized;
+	/* Provided by crossystem, and can be fetched in same batch. */
+	int crossystem;
+	/* Loaded from the cache file. */
+	int cached;
 };
 
 enum system_property_type {
@@ -223,6 +266,26 @@ enum system_property_type {
 /* Helper function to initialize system properties. */
 void init_system_properties(struct system_property *props, int num);
 
+/*
+ * Fetches all the crossystem properties that are not initialized yet, in one
+ * batch. Returns the number of properties fetched.
+ */
+int fetch_crossystem_properties(struct system_property *props, int num);
+
+/*
+ * Fetches the system property at index if it is not initialized yet.
+ * Properties from crossystem are fetched together, in one batch.
+ * If cache_file is not NULL, values are first loaded from the cache (if it was
+ * created in current boot and not expired), and the properties fetched from
+ * the system are then added to the cache. The cache keeps its timestamp, so
+ * its values are never kept beyond their expiry.
+ * Properties initialized otherwise (for example, overridden) are never saved
+ * into the cache.
+ * Returns the value of the property.
+ */
+int fetch_system_property(struct system_property *props, int num, int index,
+			  const char *cache_file);
+
 /*
  * Returns rootkey hash of firmware image, or NULL on failure.
  */
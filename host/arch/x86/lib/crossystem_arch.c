@@ -197,12 +197,9 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 		return -1;
 
 	/* Also attempt to write using flashrom if using vboot2 */
-	VbSharedDataHeader *sh = VbSharedDataRead();
-	if (sh) {
-		if (sh->flags & VBSD_BOOT_FIRMWARE_VBOOT2)
-			vb2_write_nv_storage_flashrom(ctx);
-		free(sh);
-	}
+	const VbSharedDataHeader *sh = VbSharedDataGet();
+	if (sh && (sh->flags & VBSD_BOOT_FIRMWARE_VBOOT2))
+		vb2_write_nv_storage_flashrom(ctx);
 
 	return 0;
 }
@@ -332,6 +329,8 @@ VbSharedDataHeader* VbSharedDataRead(void)
 	 * Check supported old versions first. */
 	if (1 == sh->struct_version)
 		expect_size = VB_SHARED_DATA_HEADER_SIZE_V1;
+	else if (2 == sh->struct_version)
+		expect_size = VB_SHARED_DATA_HEADER_SIZE_V2;
 	else {
 		/* There'd better be enough data for the current header size. */
 		expect_size = sizeof(VbSharedDataHeader);
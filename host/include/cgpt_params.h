@@ -24,6 +24,7 @@ typedef struct CgptCreateParams {
 	uint64_t drive_size;
 	int zap;
 	uint64_t padding;
+	uint32_t entries;
 } CgptCreateParams;
 
 typedef struct CgptAddParams {
@@ -70,6 +71,8 @@ typedef struct CgptShowParams {
 	int single_item;
 	int debug;
 	int num_partitions;
+	int direct_io;
+	int json;
 } CgptShowParams;
 
 typedef struct CgptRepairParams {
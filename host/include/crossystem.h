@@ -16,6 +16,29 @@ extern "C" {
  * VbGetSystemPropertyString(). */
 #define VB_MAX_STRING_PROPERTY     ((size_t) 8192)
 
+/* Flags for VbSystemProperty */
+#define VB_PROPERTY_STRING        0x01  /* String (not present = integer) */
+#define VB_PROPERTY_WRITABLE      0x02  /* Writable (not present = read-only) */
+#define VB_PROPERTY_NO_PRINT_ALL  0x04  /* Not printed with all properties */
+
+/* Description of a system property. */
+struct VbSystemProperty {
+	const char *name;    /* Property name */
+	int flags;           /* Flags (see above) */
+	const char *desc;    /* Human-readable description */
+	const char *format;  /* printf() format for integers, or NULL */
+};
+
+/* Find a system property by name, ignoring case.
+ *
+ * Returns the property, or NULL if no match. */
+const struct VbSystemProperty *VbFindSystemProperty(const char *name);
+
+/* Get the system property at 'index', counting from 0, to list them all.
+ *
+ * Returns the property, or NULL if 'index' is past the last one. */
+const struct VbSystemProperty *VbGetSystemPropertyByIndex(int index);
+
 /* Reads a system property integer.
  *
  * Returns the property value, or -1 if error. */
@@ -45,6 +68,25 @@ int VbSetSystemPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetSystemPropertyString(const char* name, const char* value);
 
+/* Start a transaction on NV storage.
+ *
+ * Until the matching VbNvTransactionCommit(), setting properties kept in NV
+ * storage only changes a copy in memory, read from NV storage at most once.
+ * Transactions may nest; only the outermost commit writes. */
+void VbNvTransactionBegin(void);
+
+/* Write the NV storage changes made in the transaction, if any, at once.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbNvTransactionCommit(void);
+
+/* Drop the system state kept by the getters above.
+ *
+ * VbSharedData, NV storage, the firmware type and GPIO switch positions are
+ * read once per process and shared by all properties.  Processes that run for
+ * a long time call this to read them again on the next get. */
+void VbRefreshSystemProperties(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,9 @@ int CgptGetPartitionDetails(CgptAddParams *params);
 int CgptBoot(CgptBootParams *params);
 int CgptGetBootPartitionNumber(CgptBootParams *params);
 int CgptShow(CgptShowParams *params);
+/* Shows several drives, loading them concurrently. */
+int CgptShowDrives(CgptShowParams *params, char *const drive_names[],
+		   int num_drives);
 int CgptGetNumNonEmptyPartitions(CgptShowParams *params);
 int CgptRepair(CgptRepairParams *params);
 int CgptPrioritize(CgptPrioritizeParams *params);
@@ -32,7 +32,8 @@ typedef enum VdatStringField {
 	VDAT_STRING_DEPRECATED_TIMERS = 0,  /* Timer values */
 	VDAT_STRING_LOAD_FIRMWARE_DEBUG,  /* LoadFirmware() debug info */
 	VDAT_STRING_DEPRECATED_LOAD_KERNEL_DEBUG,  /* LoadKernel() debug info */
-	VDAT_STRING_MAINFW_ACT  /* Active main firmware */
+	VDAT_STRING_MAINFW_ACT,  /* Active main firmware */
+	VDAT_STRING_BOOT_TIMES  /* Boot phase times */
 } VdatStringField;
 
 
@@ -99,67 +100,123 @@ static struct vb2_context *get_fake_context(void)
 	return fake_ctx;
 }
 
-static int vnc_read;
+/* Switch positions read from GPIOs, which are kept in the snapshot. */
+static const char *const snapshot_switches[] = {
+	"recoverysw_cur",
+	"wpsw_cur",
+	"phase_enforcement",
+};
+
+/* System state read at most once per process, so that getting many
+ * properties (e.g. crossystem with no arguments) doesn't read and parse the
+ * same files again for each of them.  VbRefreshSystemProperties() drops it. */
+static struct {
+	int vdat_read;
+	VbSharedDataHeader *vdat;
+	int nv_read;  /* NV storage is in the fake context */
+	int fw_type_read;
+	const char *fw_type;  /* NULL or fw_type_buf */
+	char fw_type_buf[64];
+	int switch_read[ARRAY_SIZE(snapshot_switches)];
+	int switch_value[ARRAY_SIZE(snapshot_switches)];
+} snapshot;
+
+void VbRefreshSystemProperties(void)
+{
+	free(snapshot.vdat);
+	memset(&snapshot, 0, sizeof(snapshot));
+}
 
-int vb2_get_nv_storage(enum vb2_nv_param param)
+const VbSharedDataHeader *VbSharedDataGet(void)
+{
+	if (!snapshot.vdat_read) {
+		snapshot.vdat = VbSharedDataRead();
+		snapshot.vdat_read = 1;
+	}
+	return snapshot.vdat;
+}
+
+/* Nesting depth of NV storage transactions, see VbNvTransactionBegin(). */
+static int nv_transaction;
+
+/* Return the fake context holding NV storage, reading it unless the snapshot
+ * already has it, or NULL if error. */
+static struct vb2_context *GetNvContext(void)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	const VbSharedDataHeader *sh = VbSharedDataGet();
 	struct vb2_context *ctx = get_fake_context();
 
 	if (!sh)
-		return -1;
+		return NULL;
 
 	/* TODO: locking around NV access */
-	if (!vnc_read) {
-		if (sh && sh->flags & VBSD_NVDATA_V2)
+	if (!snapshot.nv_read) {
+		if (sh->flags & VBSD_NVDATA_V2)
 			ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-		if (0 != vb2_read_nv_storage(ctx)) {
-			free(sh);
-			return -1;
-		}
+		if (0 != vb2_read_nv_storage(ctx))
+			return NULL;
 		vb2_nv_init(ctx);
 
 		/* TODO: If vnc.raw_changed, attempt to reopen NVRAM for write
 		 * and save the new defaults.  If we're able to, log. */
 
-		vnc_read = 1;
+		snapshot.nv_read = 1;
 	}
 
-	free(sh);
+	return ctx;
+}
+
+int vb2_get_nv_storage(enum vb2_nv_param param)
+{
+	struct vb2_context *ctx = GetNvContext();
+
+	if (!ctx)
+		return -1;
 	return (int)vb2_nv_get(ctx, param);
 }
 
-int vb2_set_nv_storage(enum vb2_nv_param param, int value)
+void VbNvTransactionBegin(void)
+{
+	/* Read NV storage again before changing it. */
+	if (nv_transaction++ == 0)
+		snapshot.nv_read = 0;
+}
+
+int VbNvTransactionCommit(void)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
 	struct vb2_context *ctx = get_fake_context();
 
-	if (!sh)
-		return -1;
+	if (nv_transaction == 0 || --nv_transaction > 0)
+		return 0;
 
-	/* TODO: locking around NV access */
-	if (sh && sh->flags & VBSD_NVDATA_V2)
-		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-	if (0 != vb2_read_nv_storage(ctx)) {
-		free(sh);
+	if (!(ctx->flags & VB2_CONTEXT_NVDATA_CHANGED))
+		return 0;
+	ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+	if (0 != vb2_write_nv_storage(ctx)) {
+		/* The changes are lost; read NV storage again next time. */
+		snapshot.nv_read = 0;
 		return -1;
 	}
-	vb2_nv_init(ctx);
-	vb2_nv_set(ctx, param, (uint32_t)value);
-
-	if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
-		vnc_read = 0;
-		if (0 != vb2_write_nv_storage(ctx)) {
-			free(sh);
-			return -1;
-		}
-	}
-
-	/* Success */
-	free(sh);
 	return 0;
 }
 
+int vb2_set_nv_storage(enum vb2_nv_param param, int value)
+{
+	struct vb2_context *ctx;
+	int retval = 0;
+
+	/* Outside of a transaction, write the change right away. */
+	VbNvTransactionBegin();
+	ctx = GetNvContext();
+	if (ctx)
+		vb2_nv_set(ctx, param, (uint32_t)value);
+	else
+		retval = -1;
+	if (0 != VbNvTransactionCommit())
+		retval = -1;
+	return retval;
+}
+
 /*
  * Set a param value, and try to flag it for persistent backup.  It's okay if
  * backup isn't supported (which it isn't, in current designs). It's
@@ -168,9 +225,14 @@ int vb2_set_nv_storage(enum vb2_nv_param param, int value)
 static int vb2_set_nv_storage_with_backup(enum vb2_nv_param param, int value)
 {
 	int retval;
+
+	/* Write both changes at once. */
+	VbNvTransactionBegin();
 	retval = vb2_set_nv_storage(param, value);
 	if (!retval)
 		vb2_set_nv_storage(VB2_NV_BACKUP_NVRAM_REQUEST, 1);
+	if (0 != VbNvTransactionCommit())
+		retval = -1;
 	return retval;
 }
 
@@ -245,9 +307,44 @@ static char *GetVdatLoadFirmwareDebug(char *dest, int size,
 	return dest;
 }
 
+/* Names of VbSharedDataHeader.boot_time_ms entries */
+static const char *const vdat_boot_time_names[VBSD_BOOT_TIME_COUNT] = {
+	[VBSD_BOOT_TIME_FW_PHASE1] = "fw_phase1",
+	[VBSD_BOOT_TIME_FW_PHASE2] = "fw_phase2",
+	[VBSD_BOOT_TIME_FW_PHASE3] = "fw_phase3",
+	[VBSD_BOOT_TIME_FW_KEYBLOCK] = "fw_keyblock",
+	[VBSD_BOOT_TIME_FW_PREAMBLE] = "fw_preamble",
+	[VBSD_BOOT_TIME_FW_BODY] = "fw_body",
+	[VBSD_BOOT_TIME_EC_SYNC] = "ec_sync",
+	[VBSD_BOOT_TIME_AUXFW_SYNC] = "auxfw_sync",
+	[VBSD_BOOT_TIME_LOAD_KERNEL] = "load_kernel",
+	[VBSD_BOOT_TIME_KERNEL_PART] = "kernel_part1",
+	[VBSD_BOOT_TIME_KERNEL_PART + 1] = "kernel_part2",
+	[VBSD_BOOT_TIME_KERNEL_PART + 2] = "kernel_part3",
+	[VBSD_BOOT_TIME_KERNEL_PART + 3] = "kernel_part4",
+};
+
+static char *GetVdatBootTimes(char *dest, int size,
+			      const VbSharedDataHeader *sh)
+{
+	int used = 0;
+	int i;
+
+	/* Fields added in struct version 3 */
+	if (sh->struct_version < 3)
+		return NULL;
+
+	dest[0] = '\0';
+	for (i = 0; i < VBSD_BOOT_TIME_COUNT && used < size; i++)
+		used += snprintf(dest + used, size - used, "%s=%u\n",
+				 vdat_boot_time_names[i],
+				 sh->boot_time_ms[i]);
+	return dest;
+}
+
 static char *GetVdatString(char *dest, int size, VdatStringField field)
 {
-	VbSharedDataHeader *sh = VbSharedDataRead();
+	const VbSharedDataHeader *sh = VbSharedDataGet();
 	char *value = dest;
 
 	if (!sh)
@@ -258,6 +355,10 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			value = GetVdatLoadFirmwareDebug(dest, size, sh);
 			break;
 
+		case VDAT_STRING_BOOT_TIMES:
+			value = GetVdatBootTimes(dest, size, sh);
+			break;
+
 		case VDAT_STRING_MAINFW_ACT:
 			switch(sh->firmware_index) {
 				case 0:
@@ -279,13 +380,12 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			break;
 	}
 
-	free(sh);
 	return value;
 }
 
 static int GetVdatInt(VdatIntField field)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	const VbSharedDataHeader *sh = VbSharedDataGet();
 	int value = -1;
 
 	if (!sh)
@@ -341,7 +441,6 @@ static int GetVdatInt(VdatIntField field)
 		}
 	}
 
-	free(sh);
 	return value;
 }
 
@@ -351,335 +450,758 @@ int VbSharedDataVersion(void)
 	return GetVdatInt(VDAT_INT_HEADER_VERSION);
 }
 
-int VbGetSystemPropertyInt(const char *name)
+/* Like VbGetArchPropertyInt(), but reads switch positions only once. */
+static int GetArchPropertyIntSnapshot(const char *name)
 {
-	int value = -1;
-
-	/* Check architecture-dependent properties first */
-	value = VbGetArchPropertyInt(name);
-	if (-1 != value)
-		return value;
-
-	/* NV storage values */
-	else if (!strcasecmp(name,"kern_nv")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-	} else if (!strcasecmp(name,"nvram_cleared")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_SETTINGS_RESET);
-	} else if (!strcasecmp(name,"recovery_request")) {
-		value = vb2_get_nv_storage(VB2_NV_RECOVERY_REQUEST);
-	} else if (!strcasecmp(name,"diagnostic_request")) {
-		value = vb2_get_nv_storage(VB2_NV_DIAG_REQUEST);
-	} else if (!strcasecmp(name,"dbg_reset")) {
-		value = vb2_get_nv_storage(VB2_NV_DEBUG_RESET_MODE);
-	} else if (!strcasecmp(name,"disable_dev_request")) {
-		value = vb2_get_nv_storage(VB2_NV_DISABLE_DEV_REQUEST);
-	} else if (!strcasecmp(name,"clear_tpm_owner_request")) {
-		if (TPM2_SIMULATOR)
-			/* Check mount-encrypted key status */
-			value = access(MOUNT_ENCRYPTED_KEY_PATH, F_OK) != 0;
-		else
-			value = vb2_get_nv_storage(
-				VB2_NV_CLEAR_TPM_OWNER_REQUEST);
-	} else if (!strcasecmp(name,"clear_tpm_owner_done")) {
-		value = vb2_get_nv_storage(VB2_NV_CLEAR_TPM_OWNER_DONE);
-	} else if (!strcasecmp(name,"tpm_rebooted")) {
-		value = vb2_get_nv_storage(VB2_NV_TPM_REQUESTED_REBOOT);
-	} else if (!strcasecmp(name,"fwb_tries") ||
-		   !strcasecmp(name,"fw_try_count")) {
-		value = vb2_get_nv_storage(VB2_NV_TRY_COUNT);
-	} else if (!strcasecmp(name,"fw_vboot2")) {
-		value = GetVdatInt(VDAT_INT_FW_BOOT2);
-	} else if (!strcasecmp(name,"fwupdate_tries")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (value != -1)
-			value &= KERN_NV_FWUPDATE_TRIES_MASK;
-	} else if (!strcasecmp(name,"block_devmode")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (value != -1) {
-			value &= KERN_NV_BLOCK_DEVMODE_FLAG;
-			value = !!value;
-		}
-	} else if (!strcasecmp(name,"tpm_attack")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (value != -1) {
-			value &= KERN_NV_TPM_ATTACK_FLAG;
-			value = !!value;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(snapshot_switches); i++) {
+		if (strcasecmp(name, snapshot_switches[i]))
+			continue;
+		if (!snapshot.switch_read[i]) {
+			snapshot.switch_value[i] = VbGetArchPropertyInt(name);
+			snapshot.switch_read[i] = 1;
 		}
-	} else if (!strcasecmp(name,"loc_idx")) {
-		value = vb2_get_nv_storage(VB2_NV_LOCALIZATION_INDEX);
-	} else if (!strcasecmp(name,"backup_nvram_request")) {
-		value = vb2_get_nv_storage(VB2_NV_BACKUP_NVRAM_REQUEST);
-	} else if (!strcasecmp(name,"dev_boot_usb")) {
-		value = vb2_get_nv_storage(VB2_NV_DEV_BOOT_EXTERNAL);
-	} else if (!strcasecmp(name,"dev_boot_legacy")) {
-		value = vb2_get_nv_storage(VB2_NV_DEV_BOOT_LEGACY);
-	} else if (!strcasecmp(name,"dev_boot_signed_only")) {
-		value = vb2_get_nv_storage(VB2_NV_DEV_BOOT_SIGNED_ONLY);
-	} else if (!strcasecmp(name,"dev_enable_udc")) {
-		value = vb2_get_nv_storage(VB2_NV_DEV_ENABLE_UDC);
-	} else if (!strcasecmp(name,"display_request")) {
-		value = vb2_get_nv_storage(VB2_NV_DISPLAY_REQUEST);
-	} else if (!strcasecmp(name,"recovery_subcode")) {
-		value = vb2_get_nv_storage(VB2_NV_RECOVERY_SUBCODE);
-	} else if (!strcasecmp(name,"wipeout_request")) {
-		value = vb2_get_nv_storage(VB2_NV_REQ_WIPEOUT);
-	} else if (!strcasecmp(name,"kernel_max_rollforward")) {
-		value = vb2_get_nv_storage(VB2_NV_KERNEL_MAX_ROLLFORWARD);
+		return snapshot.switch_value[i];
 	}
-	/* Other parameters */
-	else if (!strcasecmp(name,"cros_debug")) {
-		value = VbGetCrosDebug();
-	} else if (!strcasecmp(name,"debug_build")) {
-		value = VbGetDebugBuild();
-	} else if (!strcasecmp(name,"devsw_boot")) {
-		value = GetVdatInt(VDAT_INT_DEVSW_BOOT);
-	} else if (!strcasecmp(name, "recoverysw_boot")) {
-		value = GetVdatInt(VDAT_INT_RECSW_BOOT);
-	} else if (!strcasecmp(name, "wpsw_cur")) {
-		/* Use "write-protect at boot" as a fallback value. */
-		value = GetVdatInt(VDAT_INT_HW_WPSW_BOOT);
-	} else if (!strcasecmp(name,"vdat_flags")) {
-		value = GetVdatInt(VDAT_INT_FLAGS);
-	} else if (!strcasecmp(name,"tpm_fwver")) {
-		value = GetVdatInt(VDAT_INT_FW_VERSION_TPM);
-	} else if (!strcasecmp(name,"tpm_kernver")) {
-		value = GetVdatInt(VDAT_INT_KERNEL_VERSION_TPM);
-	} else if (!strcasecmp(name,"tried_fwb")) {
-		value = GetVdatInt(VDAT_INT_TRIED_FIRMWARE_B);
-	} else if (!strcasecmp(name,"recovery_reason")) {
-		value = GetVdatInt(VDAT_INT_RECOVERY_REASON);
-	} else if (!strcasecmp(name, "boot_on_ac_detect")) {
-		value = vb2_get_nv_storage(VB2_NV_BOOT_ON_AC_DETECT);
-	} else if (!strcasecmp(name, "try_ro_sync")) {
-		value = vb2_get_nv_storage(VB2_NV_TRY_RO_SYNC);
-	} else if (!strcasecmp(name, "battery_cutoff_request")) {
-		value = vb2_get_nv_storage(VB2_NV_BATTERY_CUTOFF_REQUEST);
-	} else if (!strcasecmp(name, "inside_vm")) {
-		/* Detect if the host is a VM. If there is no HWID and the
-		 * firmware type is "nonchrome", then assume it is a VM. If
-		 * HWID is present, it is a baremetal Chrome OS machine. Other
-		 * cases are errors. */
-		char hwid[VB_MAX_STRING_PROPERTY];
-		if (!VbGetSystemPropertyString("hwid", hwid, sizeof(hwid))) {
-			char fwtype_buf[VB_MAX_STRING_PROPERTY];
-			const char *fwtype = VbGetSystemPropertyString(
-				"mainfw_type", fwtype_buf, sizeof(fwtype_buf));
-			if (fwtype && !strcasecmp(fwtype, "nonchrome")) {
-				value = 1;
-			}
-		} else {
-			value = 0;
-		}
-	} else if (!strcasecmp(name, "post_ec_sync_delay")) {
-		value = vb2_get_nv_storage(VB2_NV_POST_EC_SYNC_DELAY);
+	return VbGetArchPropertyInt(name);
+}
+
+/* Like VbGetArchPropertyString(), but reads the firmware type only once. */
+static const char *GetArchPropertyStringSnapshot(const char *name, char *dest,
+						 size_t size)
+{
+	if (strcasecmp(name, "mainfw_type"))
+		return VbGetArchPropertyString(name, dest, size);
+
+	if (!snapshot.fw_type_read) {
+		snapshot.fw_type = VbGetArchPropertyString(
+			name, snapshot.fw_type_buf,
+			sizeof(snapshot.fw_type_buf));
+		snapshot.fw_type_read = 1;
 	}
+	if (!snapshot.fw_type)
+		return NULL;
+	return StrCopy(dest, snapshot.fw_type, size);
+}
+
+/* Architecture-dependent handlers to try before the common ones. */
+#define ARCH_GET	0x01
+#define ARCH_SET	0x02
+
+/* A system property and the functions to get and set it. */
+struct property {
+	struct VbSystemProperty info;
+	int arch;  /* ARCH_* flags */
+	int (*get_int)(const struct property *p);
+	const char *(*get_string)(const struct property *p, char *dest,
+				  size_t size);
+	int (*set_int)(const struct property *p, int value);
+	int (*set_string)(const struct property *p, const char *value);
+	enum vb2_nv_param nv;          /* NV storage field */
+	VdatIntField vdat_int;         /* VbSharedData field */
+	VdatStringField vdat_string;   /* VbSharedData string */
+	int kern_mask;                 /* Part of the kernel NV field */
+	const char *const *choices;    /* Names of the NV storage values */
+	int num_choices;
+};
+
+static int GetNvInt(const struct property *p)
+{
+	return vb2_get_nv_storage(p->nv);
+}
+
+static int SetNvInt(const struct property *p, int value)
+{
+	return vb2_set_nv_storage(p->nv, value);
+}
 
+static int SetNvIntWithBackup(const struct property *p, int value)
+{
+	return vb2_set_nv_storage_with_backup(p->nv, value);
+}
+
+/* Can only clear these flags; they are set by firmware. */
+static int ClearNvInt(const struct property *p, int value)
+{
+	return vb2_set_nv_storage(p->nv, 0);
+}
+
+static int GetVdatIntProperty(const struct property *p)
+{
+	return GetVdatInt(p->vdat_int);
+}
+
+static const char *GetVdatStringProperty(const struct property *p,
+					 char *dest, size_t size)
+{
+	return GetVdatString(dest, size, p->vdat_string);
+}
+
+static int GetKernFlag(const struct property *p)
+{
+	int value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
+	if (value != -1)
+		value = !!(value & p->kern_mask);
 	return value;
 }
 
-const char *VbGetSystemPropertyString(const char *name, char *dest,
-				      size_t size)
+static int SetKernFlag(const struct property *p, int value)
 {
-	/* Check architecture-dependent properties first */
-	if (VbGetArchPropertyString(name, dest, size))
-		return dest;
+	int kern_nv = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
+	if (kern_nv == -1)
+		return -1;
+	kern_nv &= ~p->kern_mask;
+	if (value)
+		kern_nv |= p->kern_mask;
+	return vb2_set_nv_storage_with_backup(VB2_NV_KERNEL_FIELD, kern_nv);
+}
 
-	if (!strcasecmp(name,"kernkey_vfy")) {
-		switch(GetVdatInt(VDAT_INT_KERNEL_KEY_VERIFIED)) {
-			case 0:
-				return "hash";
-			case 1:
-				return "sig";
-			default:
-				return NULL;
-		}
-	} else if (!strcasecmp(name, "mainfw_act")) {
-		return GetVdatString(dest, size, VDAT_STRING_MAINFW_ACT);
-	} else if (!strcasecmp(name, "vdat_lfdebug")) {
-		return GetVdatString(dest, size,
-				     VDAT_STRING_LOAD_FIRMWARE_DEBUG);
-	} else if (!strcasecmp(name, "fw_try_next")) {
-		return vb2_get_nv_storage(VB2_NV_TRY_NEXT) ? "B" : "A";
-	} else if (!strcasecmp(name, "fw_tried")) {
-		return vb2_get_nv_storage(VB2_NV_FW_TRIED) ? "B" : "A";
-	} else if (!strcasecmp(name, "fw_result")) {
-		int v = vb2_get_nv_storage(VB2_NV_FW_RESULT);
-		if (v < ARRAY_SIZE(fw_results))
-			return fw_results[v];
-		else
-			return "unknown";
-	} else if (!strcasecmp(name, "fw_prev_tried")) {
-		return vb2_get_nv_storage(VB2_NV_FW_PREV_TRIED) ? "B" : "A";
-	} else if (!strcasecmp(name, "fw_prev_result")) {
-		int v = vb2_get_nv_storage(VB2_NV_FW_PREV_RESULT);
-		if (v < ARRAY_SIZE(fw_results))
-			return fw_results[v];
-		else
-			return "unknown";
-	} else if (!strcasecmp(name,"dev_default_boot")) {
-		int v = vb2_get_nv_storage(VB2_NV_DEV_DEFAULT_BOOT);
-		if (v < ARRAY_SIZE(default_boot))
-			return default_boot[v];
-		else
-			return "unknown";
+static int GetKernField(const struct property *p)
+{
+	int value = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
+	if (value != -1)
+		value &= p->kern_mask;
+	return value;
+}
+
+static int SetKernField(const struct property *p, int value)
+{
+	int kern_nv = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
+	if (kern_nv == -1)
+		return -1;
+	kern_nv &= ~p->kern_mask;
+	kern_nv |= (value & p->kern_mask);
+	return vb2_set_nv_storage_with_backup(VB2_NV_KERNEL_FIELD, kern_nv);
+}
+
+/* NV storage values stored as an index into p->choices. */
+static const char *GetNvChoice(const struct property *p, char *dest,
+			       size_t size)
+{
+	int v = vb2_get_nv_storage(p->nv);
+	if (v >= 0 && v < p->num_choices)
+		return p->choices[v];
+	else
+		return "unknown";
+}
+
+static int SetNvChoice(const struct property *p, const char *value)
+{
+	int i;
+
+	for (i = 0; i < p->num_choices; i++) {
+		if (!strcasecmp(value, p->choices[i]))
+			return vb2_set_nv_storage(p->nv, i);
 	}
+	return -1;
+}
 
-	return NULL;
+static const char *GetNvFirmwareSlot(const struct property *p, char *dest,
+				     size_t size)
+{
+	return vb2_get_nv_storage(p->nv) ? "B" : "A";
 }
 
+static int GetCrosDebugProperty(const struct property *p)
+{
+	return VbGetCrosDebug();
+}
 
-int VbSetSystemPropertyInt(const char *name, int value)
+static int GetDebugBuildProperty(const struct property *p)
 {
-	/* Check architecture-dependent properties first */
+	return VbGetDebugBuild();
+}
 
-	if (0 == VbSetArchPropertyInt(name, value))
-		return 0;
+static int GetClearTpmOwnerRequest(const struct property *p)
+{
+	if (TPM2_SIMULATOR)
+		/* Check mount-encrypted key status */
+		return access(MOUNT_ENCRYPTED_KEY_PATH, F_OK) != 0;
+	else
+		return vb2_get_nv_storage(VB2_NV_CLEAR_TPM_OWNER_REQUEST);
+}
 
-	/* NV storage values */
-	if (!strcasecmp(name,"nvram_cleared")) {
-		/* Can only clear this flag; it's set inside the NV storage
-		 * library. */
-		return vb2_set_nv_storage(VB2_NV_KERNEL_SETTINGS_RESET, 0);
-	} else if (!strcasecmp(name,"recovery_request")) {
-		return vb2_set_nv_storage(VB2_NV_RECOVERY_REQUEST, value);
-	} else if (!strcasecmp(name,"diagnostic_request")) {
-		return vb2_set_nv_storage(VB2_NV_DIAG_REQUEST, value);
-	} else if (!strcasecmp(name,"recovery_subcode")) {
-		return vb2_set_nv_storage(VB2_NV_RECOVERY_SUBCODE, value);
-	} else if (!strcasecmp(name,"dbg_reset")) {
-		return vb2_set_nv_storage(VB2_NV_DEBUG_RESET_MODE, value);
-	} else if (!strcasecmp(name,"disable_dev_request")) {
-		return vb2_set_nv_storage(VB2_NV_DISABLE_DEV_REQUEST, value);
-	} else if (!strcasecmp(name,"clear_tpm_owner_request")) {
-		if (TPM2_SIMULATOR) {
-			/* We don't support to set clear_tpm_owner_request to 0
-			 * on simulator */
-			if (value == 0)
-				return -1;
-			/* Check mount-encrypted key status */
-			if (!access(MOUNT_ENCRYPTED_KEY_PATH, F_OK)) {
-				/* Remove the mount_encrypted key, and it would
-				 * also clear the TPM2.0 simulator NV space on
-				 * it. */
-				return remove(MOUNT_ENCRYPTED_KEY_PATH);
-			} else {
-				/* Return success when the file is already
-				 * removed */
-				return 0;
-			}
+static int SetClearTpmOwnerRequest(const struct property *p, int value)
+{
+	if (TPM2_SIMULATOR) {
+		/* We don't support to set clear_tpm_owner_request to 0
+		 * on simulator */
+		if (value == 0)
+			return -1;
+		/* Check mount-encrypted key status */
+		if (!access(MOUNT_ENCRYPTED_KEY_PATH, F_OK)) {
+			/* Remove the mount_encrypted key, and it would
+			 * also clear the TPM2.0 simulator NV space on
+			 * it. */
+			return remove(MOUNT_ENCRYPTED_KEY_PATH);
 		} else {
-			return vb2_set_nv_storage(
-				VB2_NV_CLEAR_TPM_OWNER_REQUEST, value);
+			/* Return success when the file is already
+			 * removed */
+			return 0;
 		}
-	} else if (!strcasecmp(name,"clear_tpm_owner_done")) {
-		/* Can only clear this flag; it's set by firmware. */
-		return vb2_set_nv_storage(VB2_NV_CLEAR_TPM_OWNER_DONE, 0);
-	} else if (!strcasecmp(name,"fwb_tries") ||
-		   !strcasecmp(name,"fw_try_count")) {
-		return vb2_set_nv_storage(VB2_NV_TRY_COUNT, value);
-	} else if (!strcasecmp(name,"display_request")) {
-		return vb2_set_nv_storage(VB2_NV_DISPLAY_REQUEST, value);
-	} else if (!strcasecmp(name,"wipeout_request")) {
-		/* Can only clear this flag, set only by firmware. */
-		return vb2_set_nv_storage(VB2_NV_REQ_WIPEOUT, 0);
-	} else if (!strcasecmp(name,"backup_nvram_request")) {
+	} else {
+		return vb2_set_nv_storage(
+			VB2_NV_CLEAR_TPM_OWNER_REQUEST, value);
+	}
+}
+
+static int GetInsideVm(const struct property *p)
+{
+	/* Detect if the host is a VM. If there is no HWID and the
+	 * firmware type is "nonchrome", then assume it is a VM. If
+	 * HWID is present, it is a baremetal Chrome OS machine. Other
+	 * cases are errors. */
+	char hwid[VB_MAX_STRING_PROPERTY];
+	if (!VbGetSystemPropertyString("hwid", hwid, sizeof(hwid))) {
+		char fwtype_buf[VB_MAX_STRING_PROPERTY];
+		const char *fwtype = VbGetSystemPropertyString(
+			"mainfw_type", fwtype_buf, sizeof(fwtype_buf));
+		if (fwtype && !strcasecmp(fwtype, "nonchrome"))
+			return 1;
+		return -1;
+	}
+	return 0;
+}
+
+static const char *GetKernkeyVfy(const struct property *p, char *dest,
+				 size_t size)
+{
+	switch(GetVdatInt(VDAT_INT_KERNEL_KEY_VERIFIED)) {
+		case 0:
+			return "hash";
+		case 1:
+			return "sig";
+		default:
+			return NULL;
+	}
+}
+
+static const char *firmware_slots[] = {"A", "B"};
+
+#define INT	0
+#define STRING	VB_PROPERTY_STRING
+#define RW	VB_PROPERTY_WRITABLE
+
+/* All system properties, in the order crossystem prints them. */
+static const struct property properties[] = {
+	{
+		.info = {"arch", STRING, "Platform architecture"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"backup_nvram_request", INT | RW,
+			 "Backup the nvram somewhere at the next boot. "
+			 "Cleared on success."},
+		.get_int = GetNvInt,
 		/* Best-effort only, since it requires firmware and TPM
 		 * support. */
-		return vb2_set_nv_storage(VB2_NV_BACKUP_NVRAM_REQUEST, value);
-	} else if (!strcasecmp(name,"fwupdate_tries")) {
-		int kern_nv = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (kern_nv == -1)
-			return -1;
-		kern_nv &= ~KERN_NV_FWUPDATE_TRIES_MASK;
-		kern_nv |= (value & KERN_NV_FWUPDATE_TRIES_MASK);
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_KERNEL_FIELD, kern_nv);
-	} else if (!strcasecmp(name,"block_devmode")) {
-		int kern_nv = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (kern_nv == -1)
-			return -1;
-		kern_nv &= ~KERN_NV_BLOCK_DEVMODE_FLAG;
-		if (value)
-			kern_nv |= KERN_NV_BLOCK_DEVMODE_FLAG;
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_KERNEL_FIELD, kern_nv);
-	} else if (!strcasecmp(name,"tpm_attack")) {
+		.set_int = SetNvInt,
+		.nv = VB2_NV_BACKUP_NVRAM_REQUEST,
+	},
+	{
+		.info = {"battery_cutoff_request", INT | RW,
+			 "Cut off battery and shutdown on next boot"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_BATTERY_CUTOFF_REQUEST,
+	},
+	{
+		.info = {"block_devmode", INT | RW,
+			 "Block all use of developer mode"},
+		.get_int = GetKernFlag,
+		.set_int = SetKernFlag,
+		.kern_mask = KERN_NV_BLOCK_DEVMODE_FLAG,
+	},
+	{
+		.info = {"boot_on_ac_detect", INT | RW | VB_PROPERTY_NO_PRINT_ALL,
+			 "Boot when AC is detected (not in print-all)"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_BOOT_ON_AC_DETECT,
+	},
+	{
+		.info = {"clear_tpm_owner_done", INT | RW,
+			 "Clear TPM owner done"},
+		.get_int = GetNvInt,
+		.set_int = ClearNvInt,
+		.nv = VB2_NV_CLEAR_TPM_OWNER_DONE,
+	},
+	{
+		.info = {"clear_tpm_owner_request", INT | RW,
+			 "Clear TPM owner on next boot"},
+		.get_int = GetClearTpmOwnerRequest,
+		.set_int = SetClearTpmOwnerRequest,
+	},
+	{
+		.info = {"cros_debug", INT, "OS should allow debug features"},
+		.get_int = GetCrosDebugProperty,
+	},
+	{
+		.info = {"dbg_reset", INT | RW, "Debug reset mode request"},
+		.arch = ARCH_GET | ARCH_SET,
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_DEBUG_RESET_MODE,
+	},
+	{
+		.info = {"debug_build", INT,
+			 "OS image built for debug features"},
+		.get_int = GetDebugBuildProperty,
+	},
+	{
+		.info = {"dev_boot_legacy", INT | RW,
+			 "Enable developer mode boot Legacy OSes"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_DEV_BOOT_LEGACY,
+	},
+	{
+		.info = {"dev_boot_signed_only", INT | RW,
+			 "Enable developer mode boot only from official "
+			 "kernels"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_DEV_BOOT_SIGNED_ONLY,
+	},
+	{
+		.info = {"dev_boot_usb", INT | RW,
+			 "Enable developer mode boot from external disk "
+			 "(USB/SD)"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_DEV_BOOT_EXTERNAL,
+	},
+	{
+		.info = {"dev_default_boot", STRING | RW,
+			 "Default boot from disk, legacy or usb"},
+		.get_string = GetNvChoice,
+		.set_string = SetNvChoice,
+		.nv = VB2_NV_DEV_DEFAULT_BOOT,
+		.choices = default_boot,
+		.num_choices = ARRAY_SIZE(default_boot),
+	},
+	{
+		.info = {"dev_enable_udc", INT | RW,
+			 "Enable USB Device Controller"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_DEV_ENABLE_UDC,
+	},
+	{
+		.info = {"devsw_boot", INT, "Developer switch position at boot"},
+		.arch = ARCH_GET,
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_DEVSW_BOOT,
+	},
+	{
+		.info = {"devsw_cur", INT, "Developer switch current position"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"diagnostic_request", INT | RW,
+			 "Request diagnostic rom run on next boot"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_DIAG_REQUEST,
+	},
+	{
+		.info = {"disable_dev_request", INT | RW,
+			 "Disable virtual dev-mode on next boot"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_DISABLE_DEV_REQUEST,
+	},
+	{
+		.info = {"ecfw_act", STRING, "Active EC firmware"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"post_ec_sync_delay", INT | RW,
+			 "Short delay after EC software sync (persistent, "
+			 "writable, eve only)"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_POST_EC_SYNC_DELAY,
+	},
+	{
+		.info = {"fw_prev_result", STRING,
+			 "Firmware result of previous boot (vboot2)"},
+		.get_string = GetNvChoice,
+		.nv = VB2_NV_FW_PREV_RESULT,
+		.choices = fw_results,
+		.num_choices = ARRAY_SIZE(fw_results),
+	},
+	{
+		.info = {"fw_prev_tried", STRING,
+			 "Firmware tried on previous boot (vboot2)"},
+		.get_string = GetNvFirmwareSlot,
+		.nv = VB2_NV_FW_PREV_TRIED,
+	},
+	{
+		.info = {"fw_result", STRING | RW,
+			 "Firmware result this boot (vboot2)"},
+		.get_string = GetNvChoice,
+		.set_string = SetNvChoice,
+		.nv = VB2_NV_FW_RESULT,
+		.choices = fw_results,
+		.num_choices = ARRAY_SIZE(fw_results),
+	},
+	{
+		.info = {"fw_tried", STRING,
+			 "Firmware tried this boot (vboot2)"},
+		.get_string = GetNvFirmwareSlot,
+		.nv = VB2_NV_FW_TRIED,
+	},
+	{
+		.info = {"fw_try_count", INT | RW,
+			 "Number of times to try fw_try_next"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_TRY_COUNT,
+	},
+	{
+		.info = {"fw_try_next", STRING | RW,
+			 "Firmware to try next (vboot2)"},
+		.get_string = GetNvFirmwareSlot,
+		.set_string = SetNvChoice,
+		.nv = VB2_NV_TRY_NEXT,
+		.choices = firmware_slots,
+		.num_choices = ARRAY_SIZE(firmware_slots),
+	},
+	{
+		.info = {"fw_vboot2", INT,
+			 "1 if firmware was selected by vboot2 or 0 "
+			 "otherwise"},
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_FW_BOOT2,
+	},
+	{
+		.info = {"fwb_tries", INT | RW, "Try firmware B count"},
+		.arch = ARCH_GET | ARCH_SET,
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_TRY_COUNT,
+	},
+	{
+		.info = {"fwid", STRING, "Active firmware ID"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"fwupdate_tries", INT | RW,
+			 "Times to try OS firmware update (inside kern_nv)"},
+		.arch = ARCH_GET | ARCH_SET,
+		.get_int = GetKernField,
+		.set_int = SetKernField,
+		.kern_mask = KERN_NV_FWUPDATE_TRIES_MASK,
+	},
+	{
+		.info = {"hwid", STRING, "Hardware ID"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"inside_vm", INT, "Running in a VM?"},
+		.get_int = GetInsideVm,
+	},
+	{
+		.info = {"kern_nv", INT, "Non-volatile field for kernel use",
+			 "0x%04x"},
+		.get_int = GetNvInt,
+		.nv = VB2_NV_KERNEL_FIELD,
+	},
+	{
+		.info = {"kernel_max_rollforward", INT | RW,
+			 "Max kernel version to store into TPM", "0x%08x"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_KERNEL_MAX_ROLLFORWARD,
+	},
+	{
+		.info = {"kernkey_vfy", STRING,
+			 "Type of verification done on kernel keyblock"},
+		.get_string = GetKernkeyVfy,
+	},
+	{
+		.info = {"loc_idx", INT | RW,
+			 "Localization index for firmware screens"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_LOCALIZATION_INDEX,
+	},
+	{
+		.info = {"mainfw_act", STRING, "Active main firmware"},
+		.arch = ARCH_GET,
+		.get_string = GetVdatStringProperty,
+		.vdat_string = VDAT_STRING_MAINFW_ACT,
+	},
+	{
+		.info = {"mainfw_type", STRING, "Active main firmware type"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"nvram_cleared", INT | RW,
+			 "Have NV settings been lost?  Write 0 to clear"},
+		.get_int = GetNvInt,
+		/* Can only clear this flag; it's set inside the NV storage
+		 * library. */
+		.set_int = ClearNvInt,
+		.nv = VB2_NV_KERNEL_SETTINGS_RESET,
+	},
+	{
+		.info = {"display_request", INT | RW,
+			 "Should we initialize the display at boot?"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_DISPLAY_REQUEST,
+	},
+	{
+		.info = {"phase_enforcement", INT,
+			 "Board should have full security settings applied"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"recovery_reason", INT,
+			 "Recovery mode reason for current boot"},
+		.arch = ARCH_GET,
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_RECOVERY_REASON,
+	},
+	{
+		.info = {"recovery_request", INT | RW, "Recovery mode request"},
+		.arch = ARCH_GET | ARCH_SET,
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_RECOVERY_REQUEST,
+	},
+	{
+		.info = {"recovery_subcode", INT | RW,
+			 "Recovery reason subcode"},
+		.get_int = GetNvInt,
+		.set_int = SetNvInt,
+		.nv = VB2_NV_RECOVERY_SUBCODE,
+	},
+	{
+		.info = {"recoverysw_boot", INT,
+			 "Recovery switch position at boot"},
+		.arch = ARCH_GET,
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_RECSW_BOOT,
+	},
+	{
+		.info = {"recoverysw_cur", INT,
+			 "Recovery switch current position"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"recoverysw_ec_boot", INT,
+			 "Recovery switch position at EC boot"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"ro_fwid", STRING, "Read-only firmware ID"},
+		.arch = ARCH_GET,
+	},
+	{
+		.info = {"tpm_attack", INT | RW,
+			 "TPM was interrupted since this flag was cleared"},
+		.get_int = GetKernFlag,
 		/* This value should only be read and cleared, but we allow
 		 * setting it to 1 for testing. */
-		int kern_nv = vb2_get_nv_storage(VB2_NV_KERNEL_FIELD);
-		if (kern_nv == -1)
-			return -1;
-		kern_nv &= ~KERN_NV_TPM_ATTACK_FLAG;
-		if (value)
-			kern_nv |= KERN_NV_TPM_ATTACK_FLAG;
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_KERNEL_FIELD, kern_nv);
-	} else if (!strcasecmp(name,"loc_idx")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_LOCALIZATION_INDEX, value);
-	} else if (!strcasecmp(name,"dev_boot_usb")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_DEV_BOOT_EXTERNAL, value);
-	} else if (!strcasecmp(name,"dev_boot_legacy")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_DEV_BOOT_LEGACY, value);
-	} else if (!strcasecmp(name,"dev_boot_signed_only")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_DEV_BOOT_SIGNED_ONLY, value);
-	} else if (!strcasecmp(name, "dev_enable_udc")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_DEV_ENABLE_UDC, value);
-	} else if (!strcasecmp(name, "boot_on_ac_detect")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_BOOT_ON_AC_DETECT, value);
-	} else if (!strcasecmp(name, "try_ro_sync")) {
-		return vb2_set_nv_storage_with_backup(
-			VB2_NV_TRY_RO_SYNC, value);
-	} else if (!strcasecmp(name, "battery_cutoff_request")) {
-		return vb2_set_nv_storage(VB2_NV_BATTERY_CUTOFF_REQUEST, value);
-	} else if (!strcasecmp(name,"kernel_max_rollforward")) {
-		return vb2_set_nv_storage(VB2_NV_KERNEL_MAX_ROLLFORWARD, value);
-	} else if (!strcasecmp(name, "post_ec_sync_delay")) {
-		return vb2_set_nv_storage(VB2_NV_POST_EC_SYNC_DELAY, value);
+		.set_int = SetKernFlag,
+		.kern_mask = KERN_NV_TPM_ATTACK_FLAG,
+	},
+	{
+		.info = {"tpm_fwver", INT, "Firmware version stored in TPM",
+			 "0x%08x"},
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_FW_VERSION_TPM,
+	},
+	{
+		.info = {"tpm_kernver", INT, "Kernel version stored in TPM",
+			 "0x%08x"},
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_KERNEL_VERSION_TPM,
+	},
+	{
+		.info = {"tpm_rebooted", INT,
+			 "TPM requesting repeated reboot (vboot2)"},
+		.get_int = GetNvInt,
+		.nv = VB2_NV_TPM_REQUESTED_REBOOT,
+	},
+	{
+		.info = {"tried_fwb", INT,
+			 "Tried firmware B before A this boot"},
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_TRIED_FIRMWARE_B,
+	},
+	{
+		.info = {"try_ro_sync", INT, "try read only software sync"},
+		.get_int = GetNvInt,
+		.set_int = SetNvIntWithBackup,
+		.nv = VB2_NV_TRY_RO_SYNC,
+	},
+	{
+		.info = {"vdat_boot_times", STRING | VB_PROPERTY_NO_PRINT_ALL,
+			 "Boot phase times in ms (not in print-all)"},
+		.get_string = GetVdatStringProperty,
+		.vdat_string = VDAT_STRING_BOOT_TIMES,
+	},
+	{
+		.info = {"vdat_flags", INT, "Flags from VbSharedData",
+			 "0x%08x"},
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_FLAGS,
+	},
+	{
+		.info = {"vdat_lfdebug", STRING | VB_PROPERTY_NO_PRINT_ALL,
+			 "LoadFirmware() debug data (not in print-all)"},
+		.get_string = GetVdatStringProperty,
+		.vdat_string = VDAT_STRING_LOAD_FIRMWARE_DEBUG,
+	},
+	{
+		.info = {"wipeout_request", INT | RW,
+			 "Firmware requested factory reset (wipeout)"},
+		.get_int = GetNvInt,
+		/* Can only clear this flag, set only by firmware. */
+		.set_int = ClearNvInt,
+		.nv = VB2_NV_REQ_WIPEOUT,
+	},
+	{
+		.info = {"wpsw_cur", INT,
+			 "Firmware write protect hardware switch current "
+			 "position"},
+		.arch = ARCH_GET,
+		/* Use "write-protect at boot" as a fallback value. */
+		.get_int = GetVdatIntProperty,
+		.vdat_int = VDAT_INT_HW_WPSW_BOOT,
+	},
+};
+
+#undef INT
+#undef STRING
+#undef RW
+
+/* Open addressing hash of the property names, ignoring case.  Each slot holds
+ * an index in properties[] plus one, or 0 if empty. */
+#define PROPERTY_HASH_SIZE 128
+static uint8_t property_hash[PROPERTY_HASH_SIZE];
+
+_Static_assert(ARRAY_SIZE(properties) * 2 <= PROPERTY_HASH_SIZE,
+	       "PROPERTY_HASH_SIZE is too small");
+
+/* FNV-1a hash of the lower case name. */
+static uint32_t HashPropertyName(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	for (; *name; name++) {
+		hash ^= (uint8_t)tolower((unsigned char)*name);
+		hash *= 16777619u;
 	}
+	return hash;
+}
 
-	return -1;
+static const struct property *FindProperty(const char *name)
+{
+	static int hashed;
+	uint32_t slot;
+	int i;
+
+	if (!hashed) {
+		for (i = 0; i < ARRAY_SIZE(properties); i++) {
+			slot = HashPropertyName(properties[i].info.name);
+			while (property_hash[slot % PROPERTY_HASH_SIZE])
+				slot++;
+			property_hash[slot % PROPERTY_HASH_SIZE] = i + 1;
+		}
+		hashed = 1;
+	}
+
+	if (!name)
+		return NULL;
+	for (slot = HashPropertyName(name);
+	     property_hash[slot % PROPERTY_HASH_SIZE]; slot++) {
+		i = property_hash[slot % PROPERTY_HASH_SIZE] - 1;
+		if (!strcasecmp(properties[i].info.name, name))
+			return &properties[i];
+	}
+	return NULL;
 }
 
-int VbSetSystemPropertyString(const char* name, const char* value)
+const struct VbSystemProperty *VbFindSystemProperty(const char *name)
 {
-	/* Chain to architecture-dependent properties */
-	if (0 == VbSetArchPropertyString(name, value))
-		return 0;
+	const struct property *p = FindProperty(name);
+	return p ? &p->info : NULL;
+}
 
-	if (!strcasecmp(name, "fw_try_next")) {
-		if (!strcasecmp(value, "A"))
-			return vb2_set_nv_storage(VB2_NV_TRY_NEXT, 0);
-		else if (!strcasecmp(value, "B"))
-			return vb2_set_nv_storage(VB2_NV_TRY_NEXT, 1);
-		else
-			return -1;
+const struct VbSystemProperty *VbGetSystemPropertyByIndex(int index)
+{
+	if (index < 0 || index >= ARRAY_SIZE(properties))
+		return NULL;
+	return &properties[index].info;
+}
 
-	} else if (!strcasecmp(name, "fw_result")) {
-		int i;
+int VbGetSystemPropertyInt(const char *name)
+{
+	const struct property *p = FindProperty(name);
+	int value;
 
-		for (i = 0; i < ARRAY_SIZE(fw_results); i++) {
-			if (!strcasecmp(value, fw_results[i]))
-				return vb2_set_nv_storage(VB2_NV_FW_RESULT, i);
-		}
+	if (!p || (p->info.flags & VB_PROPERTY_STRING))
 		return -1;
-	} else if (!strcasecmp(name, "dev_default_boot")) {
-		int i;
 
-		for (i = 0; i < ARRAY_SIZE(default_boot); i++) {
-			if (!strcasecmp(value, default_boot[i]))
-				return vb2_set_nv_storage(
-					VB2_NV_DEV_DEFAULT_BOOT, i);
-		}
-		return -1;
+	/* Check architecture-dependent properties first */
+	if (p->arch & ARCH_GET) {
+		value = GetArchPropertyIntSnapshot(name);
+		if (-1 != value)
+			return value;
 	}
 
-	return -1;
+	return p->get_int ? p->get_int(p) : -1;
+}
+
+const char *VbGetSystemPropertyString(const char *name, char *dest,
+				      size_t size)
+{
+	const struct property *p = FindProperty(name);
+
+	if (!p || !(p->info.flags & VB_PROPERTY_STRING))
+		return NULL;
+
+	/* Check architecture-dependent properties first */
+	if ((p->arch & ARCH_GET) &&
+	    GetArchPropertyStringSnapshot(name, dest, size))
+		return dest;
+
+	return p->get_string ? p->get_string(p, dest, size) : NULL;
+}
+
+
+int VbSetSystemPropertyInt(const char *name, int value)
+{
+	const struct property *p = FindProperty(name);
+
+	if (!p || (p->info.flags & VB_PROPERTY_STRING))
+		return -1;
+
+	/* Check architecture-dependent properties first */
+	if ((p->arch & ARCH_SET) && 0 == VbSetArchPropertyInt(name, value))
+		return 0;
+
+	return p->set_int ? p->set_int(p, value) : -1;
+}
+
+int VbSetSystemPropertyString(const char* name, const char* value)
+{
+	const struct property *p = FindProperty(name);
+
+	if (!p || !(p->info.flags & VB_PROPERTY_STRING))
+		return -1;
+
+	/* Chain to architecture-dependent properties */
+	if ((p->arch & ARCH_SET) && 0 == VbSetArchPropertyString(name, value))
+		return 0;
+
+	return p->set_string ? p->set_string(p, value) : -1;
 }
 
 /**
@@ -694,7 +1216,8 @@ int VbSetSystemPropertyString(const char* name, const char* value)
  */
 static int vb2_nv_index(const uint8_t *buf, uint32_t buf_sz, int vbnv_size)
 {
-	int index;
+	int index = 0;
+	int end = buf_sz / vbnv_size;
 	uint8_t blank[VB2_NVDATA_SIZE_V2];
 
 	/* The size of the buffer should be an even multiple of the
@@ -705,10 +1228,17 @@ static int vb2_nv_index(const uint8_t *buf, uint32_t buf_sz, int vbnv_size)
 			"firmware bug.\n", buf_sz, vbnv_size);
 	}
 
+	/* Entries are written in order from the beginning of the EEPROM
+	   and only erased all at once, so binary search for the first
+	   blank one. */
 	memset(blank, 0xff, sizeof(blank));
-	for (index = 0; index < buf_sz / vbnv_size; index++) {
-		if (!memcmp(blank, &buf[index * vbnv_size], vbnv_size))
-			break;
+	while (index < end) {
+		int mid = index + (end - index) / 2;
+
+		if (!memcmp(blank, &buf[mid * vbnv_size], vbnv_size))
+			end = mid;
+		else
+			index = mid + 1;
 	}
 
 	if (!index) {
@@ -751,9 +1281,12 @@ int vb2_write_nv_storage_flashrom(struct vb2_context *ctx)
 	int vbnv_size = vb2_nv_get_size(ctx);
 	uint8_t *flash_buf;
 	uint32_t flash_size;
+	uint8_t *fmap;
+	uint32_t fmap_size;
 
-	if (flashrom_read(FLASHROM_PROGRAMMER_INTERNAL_AP, VBNV_FMAP_REGION,
-			  &flash_buf, &flash_size))
+	if (flashrom_read_with_fmap(FLASHROM_PROGRAMMER_INTERNAL_AP,
+				    VBNV_FMAP_REGION, &flash_buf, &flash_size,
+				    &fmap, &fmap_size))
 		return -1;
 
 	current_index = vb2_nv_index(flash_buf, flash_size, vbnv_size);
@@ -766,17 +1299,24 @@ int vb2_write_nv_storage_flashrom(struct vb2_context *ctx)
 	if (next_index * vbnv_size == flash_size) {
 		/* VBNV is full.  Erase and write at beginning. */
 		memset(flash_buf, 0xff, flash_size);
-		next_index = 0;
+		memcpy(flash_buf, ctx->nvdata, vbnv_size);
+		if (flashrom_write(FLASHROM_PROGRAMMER_INTERNAL_AP,
+				   VBNV_FMAP_REGION, flash_buf, flash_size))
+			rv = -1;
+		goto exit;
 	}
 
-	memcpy(&flash_buf[next_index * vbnv_size], ctx->nvdata, vbnv_size);
-	if (flashrom_write(FLASHROM_PROGRAMMER_INTERNAL_AP, VBNV_FMAP_REGION,
-			   flash_buf, flash_size)) {
+	/* The next entry is still erased, so only program that one. */
+	if (flashrom_write_range(FLASHROM_PROGRAMMER_INTERNAL_AP, fmap,
+				 fmap_size, VBNV_FMAP_REGION,
+				 next_index * vbnv_size, ctx->nvdata,
+				 vbnv_size)) {
 		rv = -1;
 		goto exit;
 	}
 
  exit:
+	free(fmap);
 	free(flash_buf);
 	return rv;
 }
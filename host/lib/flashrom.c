@@ -21,6 +21,7 @@
 #include "2return_codes.h"
 #include "host_misc.h"
 #include "flashrom.h"
+#include "fmap.h"
 #include "subprocess.h"
 
 #define FLASHROM_EXEC_NAME "flashrom"
@@ -167,3 +168,116 @@ vb2_error_t flashrom_write(const char *programmer, const char *region,
 	free(tmpfile);
 	return rv;
 }
+
+vb2_error_t flashrom_read_with_fmap(const char *programmer, const char *region,
+				    uint8_t **data_out, uint32_t *size_out,
+				    uint8_t **fmap_out, uint32_t *fmap_size_out)
+{
+	char *tmpfile;
+	char *fmap_tmpfile;
+	char region_param[PATH_MAX];
+	char fmap_param[PATH_MAX];
+	vb2_error_t rv;
+
+	*data_out = NULL;
+	*size_out = 0;
+	*fmap_out = NULL;
+	*fmap_size_out = 0;
+
+	VB2_TRY(write_temp_file(NULL, 0, &tmpfile));
+	rv = write_temp_file(NULL, 0, &fmap_tmpfile);
+	if (rv != VB2_SUCCESS)
+		goto exit;
+
+	snprintf(region_param, sizeof(region_param), "%s:%s", region, tmpfile);
+	snprintf(fmap_param, sizeof(fmap_param), "%s:%s", FLASHROM_FMAP_REGION,
+		 fmap_tmpfile);
+
+	const char *const argv[] = {
+		FLASHROM_EXEC_NAME,
+		"-p",
+		programmer,
+		"-r",
+		"-i",
+		region_param,
+		"-i",
+		fmap_param,
+		NULL,
+	};
+
+	rv = run_flashrom(argv);
+	if (rv == VB2_SUCCESS)
+		rv = vb2_read_file(tmpfile, data_out, size_out);
+	if (rv == VB2_SUCCESS)
+		rv = vb2_read_file(fmap_tmpfile, fmap_out, fmap_size_out);
+	if (rv != VB2_SUCCESS) {
+		free(*data_out);
+		*data_out = NULL;
+		*size_out = 0;
+	}
+
+	unlink(fmap_tmpfile);
+	free(fmap_tmpfile);
+ exit:
+	unlink(tmpfile);
+	free(tmpfile);
+	return rv;
+}
+
+vb2_error_t flashrom_write_range(const char *programmer, uint8_t *fmap,
+				 uint32_t fmap_size, const char *region,
+				 uint32_t offset, uint8_t *data,
+				 uint32_t size)
+{
+	FmapAreaHeader *ah;
+	char layout[FMAP_NAMELEN + 32];
+	char *tmpfile;
+	char *layout_tmpfile;
+	char region_param[PATH_MAX];
+	uint32_t start;
+	vb2_error_t rv;
+
+	if (!fmap_find_by_name(fmap, fmap_size, NULL, region, &ah)) {
+		fprintf(stderr, "Region %s not found in FMAP.\n", region);
+		return VB2_ERROR_FLASHROM;
+	}
+	if (!size || offset > ah->area_size || size > ah->area_size - offset) {
+		fprintf(stderr, "Range is outside of region %s.\n", region);
+		return VB2_ERROR_FLASHROM;
+	}
+
+	/* Describe the range to flashrom as a layout with a single region,
+	   named after the fmap region it is part of. */
+	start = ah->area_offset + offset;
+	snprintf(layout, sizeof(layout), "%08x:%08x %s\n", start,
+		 start + size - 1, region);
+
+	VB2_TRY(write_temp_file(data, size, &tmpfile));
+	rv = write_temp_file((const uint8_t *)layout, strlen(layout),
+			     &layout_tmpfile);
+	if (rv != VB2_SUCCESS)
+		goto exit;
+
+	snprintf(region_param, sizeof(region_param), "%s:%s", region, tmpfile);
+
+	const char *const argv[] = {
+		FLASHROM_EXEC_NAME,
+		"-p",
+		programmer,
+		"--fast-verify",
+		"-w",
+		"-l",
+		layout_tmpfile,
+		"-i",
+		region_param,
+		NULL,
+	};
+
+	rv = run_flashrom(argv);
+	unlink(layout_tmpfile);
+	free(layout_tmpfile);
+ exit:
+	unlink(tmpfile);
+	free(tmpfile);
+	return rv;
+}
@@ -0,0 +1,181 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host hwcrypto provider, backed by OpenSSL.
+ *
+ * This is not part of the vboot libraries.  Programs which link it ahead of
+ * them get these vb2ex_hwcrypto_*() instead of the weak stubs which report
+ * hwcrypto as unsupported, so that the hwcrypto paths of firmware
+ * verification can be exercised and profiled on the host.
+ */
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+
+/* Digest in progress.  Like a hardware engine, there is only one. */
+static EVP_MD_CTX *digest_ctx;
+static enum vb2_hash_algorithm digest_alg;
+
+static const EVP_MD *hash_to_md(enum vb2_hash_algorithm hash_alg)
+{
+	switch (hash_alg) {
+	case VB2_HASH_SHA1:
+		return EVP_sha1();
+	case VB2_HASH_SHA224:
+		return EVP_sha224();
+	case VB2_HASH_SHA256:
+		return EVP_sha256();
+	case VB2_HASH_SHA384:
+		return EVP_sha384();
+	case VB2_HASH_SHA512:
+		return EVP_sha512();
+	default:
+		return NULL;
+	}
+}
+
+static uint32_t rsa_exponent(enum vb2_signature_algorithm sig_alg)
+{
+	switch (sig_alg) {
+	case VB2_SIG_RSA1024:
+	case VB2_SIG_RSA2048:
+	case VB2_SIG_RSA4096:
+	case VB2_SIG_RSA8192:
+		return 65537;
+	case VB2_SIG_RSA2048_EXP3:
+	case VB2_SIG_RSA3072_EXP3:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+/* Return the modulus of a key, which vboot stores as little endian words. */
+static BIGNUM *key_modulus(const struct vb2_public_key *key)
+{
+	uint32_t key_bytes = key->arrsize * sizeof(uint32_t);
+	uint8_t *buf = malloc(key_bytes);
+	BIGNUM *n = NULL;
+	uint32_t i, word;
+
+	if (!buf)
+		return NULL;
+
+	for (i = 0; i < key->arrsize; i++) {
+		word = key->n[key->arrsize - 1 - i];
+		buf[4 * i] = word >> 24;
+		buf[4 * i + 1] = word >> 16;
+		buf[4 * i + 2] = word >> 8;
+		buf[4 * i + 3] = word;
+	}
+	n = BN_bin2bn(buf, key_bytes, NULL);
+	free(buf);
+	return n;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+				       uint32_t data_size)
+{
+	const EVP_MD *md = hash_to_md(hash_alg);
+
+	if (!md)
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+
+	if (!digest_ctx)
+		digest_ctx = EVP_MD_CTX_new();
+	if (!digest_ctx || !EVP_DigestInit_ex(digest_ctx, md, NULL))
+		return VB2_ERROR_SHA_INIT_ALGORITHM;
+
+	digest_alg = hash_alg;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	if (!digest_ctx || !EVP_DigestUpdate(digest_ctx, buf, size))
+		return VB2_ERROR_SHA_EXTEND_ALGORITHM;
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
+					   uint32_t digest_size)
+{
+	uint8_t md_buf[EVP_MAX_MD_SIZE];
+	unsigned int md_size;
+
+	if (!digest_ctx)
+		return VB2_ERROR_SHA_FINALIZE_ALGORITHM;
+	if (digest_size < vb2_digest_size(digest_alg))
+		return VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE;
+	if (!EVP_DigestFinal_ex(digest_ctx, md_buf, &md_size))
+		return VB2_ERROR_SHA_FINALIZE_ALGORITHM;
+
+	memcpy(digest, md_buf, md_size);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_rsa_verify_digest(const struct vb2_public_key *key,
+					     const uint8_t *sig,
+					     const uint8_t *digest)
+{
+	const EVP_MD *md = hash_to_md(key->hash_alg);
+	uint32_t exp = rsa_exponent(key->sig_alg);
+	BIGNUM *n, *e;
+	RSA *rsa;
+	int ok;
+
+	if (!md || !exp)
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+
+	rsa = RSA_new();
+	n = key_modulus(key);
+	e = BN_new();
+	if (!rsa || !n || !e || !BN_set_word(e, exp) ||
+	    !RSA_set0_key(rsa, n, e, NULL)) {
+		BN_free(n);
+		BN_free(e);
+		RSA_free(rsa);
+		return VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	}
+
+	/* The key now owns n and e. */
+	ok = RSA_verify(EVP_MD_type(md), digest, vb2_digest_size(key->hash_alg),
+			sig, key->arrsize * sizeof(uint32_t), rsa);
+	RSA_free(rsa);
+
+	return ok == 1 ? VB2_SUCCESS : VB2_ERROR_RSA_VERIFY_DIGEST;
+}
+
+vb2_error_t vb2ex_hwcrypto_modexp(const struct vb2_public_key *key,
+				  uint8_t *inout,
+				  uint32_t *workbuf32, int exp)
+{
+	uint32_t key_bytes = key->arrsize * sizeof(uint32_t);
+	BN_CTX *bn_ctx = BN_CTX_new();
+	BIGNUM *n = key_modulus(key);
+	BIGNUM *e = BN_new();
+	BIGNUM *x = BN_bin2bn(inout, key_bytes, NULL);
+	BIGNUM *r = BN_new();
+	vb2_error_t rv = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+
+	if (bn_ctx && n && e && x && r && BN_set_word(e, exp) &&
+	    BN_mod_exp(r, x, e, n, bn_ctx) &&
+	    BN_bn2binpad(r, inout, key_bytes) == key_bytes)
+		rv = VB2_SUCCESS;
+
+	BN_free(r);
+	BN_free(x);
+	BN_free(e);
+	BN_free(n);
+	BN_CTX_free(bn_ctx);
+	return rv;
+}
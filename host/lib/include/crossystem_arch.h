@@ -44,6 +44,12 @@ int FwidStartsWith(const char *start);
 /* Return version of VbSharedData struct or -1 if not found. */
 int VbSharedDataVersion(void);
 
+/* Return the VbSharedData buffer, read with VbSharedDataRead() once until
+ * VbRefreshSystemProperties().  The caller must not free it.
+ *
+ * Returns NULL if error. */
+const VbSharedDataHeader *VbSharedDataGet(void);
+
 /* Apis WITH ARCH-SPECIFIC IMPLEMENTATIONS */
 
 /* Read the non-volatile context from NVRAM.
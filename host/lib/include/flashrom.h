@@ -12,6 +12,9 @@
 #define FLASHROM_PROGRAMMER_INTERNAL_AP "host"
 #define FLASHROM_PROGRAMMER_INTERNAL_EC "ec"
 
+/* Name of the fmap region holding the FMAP itself. */
+#define FLASHROM_FMAP_REGION "FMAP"
+
 /**
  * Read using flashrom into an allocated buffer.
  *
@@ -48,3 +51,43 @@ vb2_error_t flashrom_read(const char *programmer, const char *region,
  */
 vb2_error_t flashrom_write(const char *programmer, const char *region,
 			   uint8_t *data, uint32_t size);
+
+/**
+ * Read an fmap region and the FMAP using a single flashrom run, for
+ * a later flashrom_write_range() into the region.
+ *
+ * @param programmer	The name of the programmer to use.
+ * @param region	The name of the fmap region to read.
+ * @param data_out	Output parameter of allocated buffer holding the
+ *			region.  The caller should free the buffer.
+ * @param size_out	Output parameter of region buffer size.
+ * @param fmap_out	Output parameter of allocated buffer holding the
+ *			FMAP.  The caller should free the buffer.
+ * @param fmap_size_out	Output parameter of FMAP buffer size.
+ *
+ * @return VB2_SUCCESS on success, or a relevant error.
+ */
+vb2_error_t flashrom_read_with_fmap(const char *programmer, const char *region,
+				    uint8_t **data_out, uint32_t *size_out,
+				    uint8_t **fmap_out, uint32_t *fmap_size_out);
+
+/**
+ * Write only part of an fmap region using flashrom, leaving the rest
+ * of the flash chip untouched.  Nothing is erased if the part is
+ * still erased.
+ *
+ * @param programmer	The name of the programmer to use.
+ * @param fmap		The FMAP of the flash chip, as read by
+ *			flashrom_read_with_fmap().
+ * @param fmap_size	The size of the FMAP buffer.
+ * @param region	The name of the fmap region to write into.
+ * @param offset	The offset of the part within the region.
+ * @param data		The buffer to write.
+ * @param size		The size of the buffer to write.
+ *
+ * @return VB2_SUCCESS on success, or a relevant error.
+ */
+vb2_error_t flashrom_write_range(const char *programmer, uint8_t *fmap,
+				 uint32_t fmap_size, const char *region,
+				 uint32_t offset, uint8_t *data,
+				 uint32_t size);
@@ -0,0 +1,211 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmark of GPT entries checking and kernel selection.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "2common.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "crc32.h"
+#include "gpt.h"
+#include "timer_utils.h"
+
+/* Number of entries checked in each benchmark, approximately. */
+#define TEST_WORK (20000 * DEFAULT_NUMBER_OF_ENTRIES)
+
+/* Number of kernels in the tables used for kernel selection. */
+#define NUM_KERNELS 8
+
+static const Guid guid_kernel = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+static const Guid guid_rootfs = GPT_ENT_TYPE_CHROMEOS_ROOTFS;
+
+/* Builds a full table of valid, non-overlapping entries in random order. */
+static void build_entries(GptHeader *h, GptEntry *entries, uint32_t num)
+{
+	uint32_t i, j;
+	GptEntry tmp;
+
+	memset(h, 0, sizeof(*h));
+	h->first_usable_lba = 34;
+	h->last_usable_lba = 34 + 16 * (uint64_t)num;
+	h->number_of_entries = num;
+	h->size_of_entry = sizeof(GptEntry);
+
+	srand(num);
+	memset(entries, 0, num * sizeof(GptEntry));
+	for (i = 0; i < num; i++) {
+		memcpy(&entries[i].type, &guid_kernel, sizeof(Guid));
+		for (j = 0; j < sizeof(Guid); j++)
+			entries[i].unique.u.raw[j] = rand();
+		entries[i].starting_lba = h->first_usable_lba + 16 * i;
+		entries[i].ending_lba = entries[i].starting_lba + 15;
+	}
+	for (i = num - 1; i > 0; i--) {
+		j = rand() % (i + 1);
+		tmp = entries[i];
+		entries[i] = entries[j];
+		entries[j] = tmp;
+	}
+	h->entries_crc32 = Crc32((const uint8_t *)entries,
+				 num * sizeof(GptEntry));
+}
+
+static void run(const char *name, GptHeader *h, GptEntry *entries,
+		int (*check)(GptEntry *, GptHeader *), uint32_t iterations)
+{
+	ClockTimerState ct;
+	uint32_t i, msecs;
+	int r = 0;
+
+	if (!iterations)
+		iterations = 1;
+
+	StartTimer(&ct);
+	for (i = 0; i < iterations; i++)
+		r |= check(entries, h);
+	StopTimer(&ct);
+	msecs = GetDurationMsecs(&ct);
+
+	fprintf(stderr, "# %s (%u entries): %u iterations = %u ms%s\n",
+		name, h->number_of_entries, iterations, msecs,
+		r ? " (FAILED)" : "");
+	fprintf(stdout, "usecs_per_check_%s_%u:%f\n", name,
+		h->number_of_entries, msecs * 1000.0 / iterations);
+}
+
+/*
+ * Builds a valid GPT with num one-sector partitions, NUM_KERNELS of which are
+ * kernels that can be tried, spread over the table.
+ */
+static void build_gpt(GptData *gpt, uint32_t num)
+{
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	GptHeader *h2 = (GptHeader *)gpt->secondary_header;
+	GptEntry *e = (GptEntry *)gpt->primary_entries;
+	uint32_t entries_sectors = num * sizeof(GptEntry) / 512;
+	uint32_t i;
+
+	memset(h1, 0, 512);
+	memset(e, 0, num * sizeof(GptEntry));
+	memcpy(h1->signature, GPT_HEADER_SIGNATURE, GPT_HEADER_SIGNATURE_SIZE);
+	h1->revision = GPT_HEADER_REVISION;
+	h1->size = sizeof(GptHeader);
+	h1->my_lba = 1;
+	h1->entries_lba = 2;
+	h1->first_usable_lba = 2 + entries_sectors;
+	h1->last_usable_lba = h1->first_usable_lba + num - 1;
+	h1->number_of_entries = num;
+	h1->size_of_entry = sizeof(GptEntry);
+
+	gpt->sector_bytes = 512;
+	gpt->streaming_drive_sectors = gpt->gpt_drive_sectors =
+		h1->last_usable_lba + 1 + entries_sectors + 1;
+	gpt->flags = 0;
+	h1->alternate_lba = gpt->gpt_drive_sectors - 1;
+
+	for (i = 0; i < num; i++) {
+		e[i].unique.u.Uuid.time_low = i + 1;
+		e[i].starting_lba = e[i].ending_lba = h1->first_usable_lba + i;
+		if (i % (num / NUM_KERNELS) == num / NUM_KERNELS - 1) {
+			memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+			SetEntryPriority(e + i, 1 + i % 15);
+			SetEntryTries(e + i, 1);
+		} else {
+			memcpy(&e[i].type, &guid_rootfs, sizeof(Guid));
+		}
+	}
+	h1->entries_crc32 = Crc32((const uint8_t *)e, num * sizeof(GptEntry));
+	h1->header_crc32 = HeaderCrc(h1);
+
+	memcpy(h2, h1, 512);
+	memcpy(gpt->secondary_entries, e, num * sizeof(GptEntry));
+	h2->my_lba = gpt->gpt_drive_sectors - 1;
+	h2->alternate_lba = 1;
+	h2->entries_lba = h2->my_lba - entries_sectors;
+	h2->header_crc32 = HeaderCrc(h2);
+}
+
+/* Times walking through all the kernels, with or without the kernel list. */
+static void run_next_kernel(const char *name, GptData *gpt, int use_list,
+			    uint32_t iterations)
+{
+	ClockTimerState ct;
+	uint64_t start, size;
+	uint32_t i, msecs, found = 0;
+
+	StartTimer(&ct);
+	for (i = 0; i < iterations; i++) {
+		gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+		gpt->current_priority = 999;
+		gpt->next_kernel_candidate = 0;
+		gpt->kernel_candidates_valid = use_list;
+		while (GptNextKernelEntry(gpt, &start, &size) == GPT_SUCCESS)
+			found++;
+	}
+	StopTimer(&ct);
+	msecs = GetDurationMsecs(&ct);
+
+	fprintf(stderr, "# %s (%u entries): %u iterations = %u ms%s\n",
+		name, ((GptHeader *)gpt->primary_header)->number_of_entries,
+		iterations, msecs,
+		found == iterations * NUM_KERNELS ? "" : " (FAILED)");
+	fprintf(stdout, "usecs_per_walk_%s_%u:%f\n", name,
+		((GptHeader *)gpt->primary_header)->number_of_entries,
+		msecs * 1000.0 / iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	const uint32_t sizes[] = {DEFAULT_NUMBER_OF_ENTRIES, 1024,
+				  MAX_NUMBER_OF_ENTRIES};
+	GptEntry *entries = malloc(MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry));
+	GptHeader h;
+	GptData gpt;
+	uint32_t i, n, pairs;
+
+	if (!entries)
+		return 1;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		build_entries(&h, entries, n);
+		run("sorted", &h, entries, CheckEntriesSorted, TEST_WORK / n);
+		/* Pairwise check is quadratic; keep the run time sane. */
+		pairs = n / DEFAULT_NUMBER_OF_ENTRIES;
+		run("pairwise", &h, entries, CheckEntriesPairwise,
+		    TEST_WORK / n / pairs);
+	}
+	free(entries);
+
+	memset(&gpt, 0, sizeof(gpt));
+	gpt.primary_header = malloc(512);
+	gpt.secondary_header = malloc(512);
+	gpt.primary_entries = malloc(MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry));
+	gpt.secondary_entries = malloc(MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry));
+	if (!gpt.primary_header || !gpt.secondary_header ||
+	    !gpt.primary_entries || !gpt.secondary_entries)
+		return 1;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		build_gpt(&gpt, n);
+		if (GptInit(&gpt) != GPT_SUCCESS || !gpt.kernel_candidates_valid) {
+			fprintf(stderr, "# GptInit failed for %u entries\n", n);
+			return 1;
+		}
+		run_next_kernel("list", &gpt, 1, TEST_WORK / NUM_KERNELS);
+		run_next_kernel("scan", &gpt, 0, TEST_WORK / n);
+	}
+	free(gpt.primary_header);
+	free(gpt.secondary_header);
+	free(gpt.primary_entries);
+	free(gpt.secondary_entries);
+	return 0;
+}
@@ -295,6 +295,37 @@ static int HeaderCrcTest(void)
 	return TEST_OK;
 }
 
+/* Test if CRCs can be combined and patched without rehashing everything. */
+static int Crc32CombineTest(void)
+{
+	uint8_t buf[4096], old[sizeof(GptEntry)];
+	uint32_t crc, i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)(i * 7 + (i >> 8));
+	crc = Crc32(buf, sizeof(buf));
+
+	EXPECT(Crc32Combine(Crc32(buf, 1000), Crc32(buf + 1000, 3096), 3096) ==
+	       crc);
+	EXPECT(Crc32Combine(Crc32(buf, 4095), Crc32(buf + 4095, 1), 1) == crc);
+	EXPECT(Crc32Combine(crc, Crc32(buf, 0), 0) == crc);
+
+	/* Change one entry-sized chunk in the middle, then the last one */
+	memcpy(old, buf + 1024, sizeof(old));
+	buf[1024] ^= 0x01;
+	buf[1024 + sizeof(old) - 1] ^= 0x80;
+	crc = Crc32Patch(crc, sizeof(buf), 1024, old, buf + 1024, sizeof(old));
+	EXPECT(Crc32(buf, sizeof(buf)) == crc);
+
+	memcpy(old, buf + sizeof(buf) - sizeof(old), sizeof(old));
+	memset(buf + sizeof(buf) - sizeof(old), 0xa5, sizeof(old));
+	crc = Crc32Patch(crc, sizeof(buf), sizeof(buf) - sizeof(old), old,
+			 buf + sizeof(buf) - sizeof(old), sizeof(old));
+	EXPECT(Crc32(buf, sizeof(buf)) == crc);
+
+	return TEST_OK;
+}
+
 /* Test if header-same comparison works. */
 static int HeaderSameTest(void)
 {
@@ -846,10 +877,48 @@ static int OverlappedPartitionTest(void) {
 		RefreshCrc32(gpt);
 
 		EXPECT(cases[i].overlapped == CheckEntries(e, h));
+		EXPECT(CheckEntriesPairwise(e, h) == CheckEntriesSorted(e, h));
 	}
 	return TEST_OK;
 }
 
+/* Test checking entries of a table larger than the default. */
+static int LargeEntriesTest(void)
+{
+	GptHeader h;
+	GptEntry *e;
+	uint32_t i, n = MAX_NUMBER_OF_ENTRIES;
+
+	e = calloc(n, sizeof(GptEntry));
+	memset(&h, 0, sizeof(h));
+	h.first_usable_lba = 34;
+	h.last_usable_lba = 34 + 2 * n;
+	h.number_of_entries = n;
+	h.size_of_entry = sizeof(GptEntry);
+
+	/* Fill in reverse order so the entries need sorting. */
+	for (i = 0; i < n; i++) {
+		memcpy(&e[i].type, &guid_kernel, sizeof(Guid));
+		SetGuid(&e[i].unique, i);
+		e[i].starting_lba = h.last_usable_lba - 2 * i - 1;
+		e[i].ending_lba = e[i].starting_lba + 1;
+	}
+	h.entries_crc32 = Crc32((uint8_t *)e, n * sizeof(GptEntry));
+	EXPECT(0 == CheckEntries(e, &h));
+
+	e[n - 1].ending_lba++;
+	h.entries_crc32 = Crc32((uint8_t *)e, n * sizeof(GptEntry));
+	EXPECT(GPT_ERROR_START_LBA_OVERLAP == CheckEntries(e, &h));
+
+	e[n - 1].ending_lba--;
+	SetGuid(&e[n - 1].unique, 0);
+	h.entries_crc32 = Crc32((uint8_t *)e, n * sizeof(GptEntry));
+	EXPECT(GPT_ERROR_DUP_GUID == CheckEntries(e, &h));
+
+	free(e);
+	return TEST_OK;
+}
+
 /* Test both validity checking and repair. */
 static int ValidityCheckTest(void)
 {
@@ -1308,6 +1377,77 @@ static int GetNextPrioTest(void)
 	return TEST_OK;
 }
 
+/*
+ * Walk through all kernels and record their indices, either from the list
+ * built by GptInit() or by scanning the entries.
+ */
+static int WalkKernels(GptData *gpt, int use_list, int *order, int max)
+{
+	uint64_t start, size;
+	int n = 0;
+
+	GptInit(gpt);
+	if (!use_list)
+		gpt->kernel_candidates_valid = 0;
+	while (n < max && GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size))
+		order[n++] = gpt->current_kernel;
+	return n;
+}
+
+/* Fill the whole table, making every stride-th entry a kernel. */
+static void FillLargeTable(GptData *gpt, int stride)
+{
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	GptHeader *h1 = (GptHeader *)gpt->primary_header;
+	int i;
+
+	BuildTestGptData(gpt);
+	for (i = 0; i < h1->number_of_entries; i++) {
+		FillEntry(e1 + i, i % stride == 0, (i * 7) % 16, i % 3 == 0,
+			  i % 5);
+		SetGuid(&e1[i].unique, i);
+		e1[i].starting_lba = 34 + 3 * i;
+		e1[i].ending_lba = e1[i].starting_lba + 2;
+	}
+	RefreshCrc32(gpt);
+}
+
+/* Large tables give the same kernel order with and without the list. */
+static int GetNextLargeTableTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	int list_order[128], scan_order[128];
+	uint64_t start, size;
+	int n;
+
+	/* A few kernels fit in the list */
+	FillLargeTable(gpt, 10);
+	n = WalkKernels(gpt, 1, list_order, ARRAY_SIZE(list_order));
+	EXPECT(1 == gpt->kernel_candidates_valid);
+	EXPECT(n > 1);
+	EXPECT(n == WalkKernels(gpt, 0, scan_order, ARRAY_SIZE(scan_order)));
+	EXPECT(0 == memcmp(list_order, scan_order, n * sizeof(int)));
+
+	/* Changing a listed kernel after GptInit() falls back to a rescan */
+	GptInit(gpt);
+	SetEntryPriority(e1 + scan_order[1], 15);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(scan_order[0] == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(0 == gpt->kernel_candidates_valid);
+
+	/* Too many kernels for the list */
+	FillLargeTable(gpt, 1);
+	n = WalkKernels(gpt, 1, list_order, ARRAY_SIZE(list_order));
+	EXPECT(0 == gpt->kernel_candidates_valid);
+	EXPECT(n > GPT_MAX_KERNEL_CANDIDATES);
+	EXPECT(n == WalkKernels(gpt, 0, scan_order, ARRAY_SIZE(scan_order)));
+	EXPECT(0 == memcmp(list_order, scan_order, n * sizeof(int)));
+
+	return TEST_OK;
+}
+
 static int GetNextTriesTest(void)
 {
 	GptData *gpt = GetEmptyGptData();
@@ -1388,6 +1528,15 @@ static int GptUpdateTest(void)
 	EXPECT(0 == GetEntryTries(e2 + KERNEL_B));
 	/* And that's caused the GPT to need updating */
 	EXPECT(0x0F == gpt->modified);
+	/* With CRCs matching the new entries */
+	EXPECT(0 == CheckEntries(e, (GptHeader *)gpt->primary_header));
+	EXPECT(0 == CheckEntries(e2, (GptHeader *)gpt->secondary_header));
+	EXPECT(0 == CheckHeader((GptHeader *)gpt->primary_header, 0,
+				gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
+	EXPECT(0 == CheckHeader((GptHeader *)gpt->secondary_header, 1,
+				gpt->streaming_drive_sectors,
+				gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
 
 	/* Another kernel with tries */
 	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
@@ -1591,6 +1740,27 @@ static int CheckHeaderOffDevice(void)
 	EXPECT(1 == CheckHeader(secondary_header, 1, gpt->streaming_drive_sectors,
 		gpt->gpt_drive_sectors, GPT_FLAG_EXTERNAL, gpt->sector_bytes));
 
+	// More entries than usual are fine if there is space for them.
+	BuildTestGptData(gpt);
+	primary_header->number_of_entries = 4 * DEFAULT_NUMBER_OF_ENTRIES;
+	primary_header->first_usable_lba = 2 +
+		CalculateEntriesSectors(primary_header, gpt->sector_bytes);
+	primary_header->header_crc32 = HeaderCrc(primary_header);
+	EXPECT(1 == CheckHeader(primary_header, 0, gpt->streaming_drive_sectors,
+		gpt->gpt_drive_sectors, 0, gpt->sector_bytes));
+	EXPECT(0 == CheckHeader(primary_header, 0, 4096, 4096, 0,
+		gpt->sector_bytes));
+	EXPECT(CalculateEntriesAllocSize(primary_header, NULL,
+		gpt->sector_bytes) == 4 * GPT_ENTRIES_ALLOC_SIZE);
+	EXPECT(CalculateEntriesAllocSize(NULL, NULL, gpt->sector_bytes) ==
+	       GPT_ENTRIES_ALLOC_SIZE);
+
+	// But not more than the maximum, even off device.
+	primary_header->number_of_entries = MAX_NUMBER_OF_ENTRIES + 1;
+	primary_header->header_crc32 = HeaderCrc(primary_header);
+	EXPECT(1 == CheckHeader(primary_header, 0, 1 << 20, 1 << 20,
+		GPT_FLAG_EXTERNAL, gpt->sector_bytes));
+
 	return TEST_OK;
 }
 
@@ -1607,6 +1777,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(TestBuildTestGptData), },
 		{ TEST_CASE(ParameterTests), },
 		{ TEST_CASE(HeaderCrcTest), },
+		{ TEST_CASE(Crc32CombineTest), },
 		{ TEST_CASE(HeaderSameTest), },
 		{ TEST_CASE(SignatureTest), },
 		{ TEST_CASE(RevisionTest), },
@@ -1620,6 +1791,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(EntriesCrcTest), },
 		{ TEST_CASE(ValidEntryTest), },
 		{ TEST_CASE(OverlappedPartitionTest), },
+		{ TEST_CASE(LargeEntriesTest), },
 		{ TEST_CASE(ValidityCheckTest), },
 		{ TEST_CASE(NoValidKernelEntryTest), },
 		{ TEST_CASE(EntryAttributeGetSetTest), },
@@ -1627,6 +1799,7 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextNormalTest), },
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
+		{ TEST_CASE(GetNextLargeTableTest), },
 		{ TEST_CASE(GptUpdateTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
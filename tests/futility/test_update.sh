@@ -318,6 +318,145 @@ test_update "Legacy update" \
 	"${FROM_IMAGE}" "${TMP}.expected.legacy" \
 	-i "${TO_IMAGE}" --mode=legacy
 
+# Test emulation, which should only write the blocks (4KB) being changed.
+cp -f "${TMP}.expected.full" "${TMP}.emu.changed"
+patch_file "${TMP}.emu.changed" FW_MAIN_A 0 "corrupted"
+patch_file "${TMP}.emu.changed" FW_MAIN_A 4090 "corrupted"
+patch_file "${TMP}.emu.changed" FW_MAIN_B 8192 "corrupted"
+IMAGE_SIZE="$(stat -c %s "${TMP}.expected.full")"
+
+echo "TEST: Full update (emulation, changed blocks)"
+cp -f "${TMP}.emu.changed" "${TMP}.emu"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --debug 2>"${TMP}.emu.log"
+cmp "${TMP}.emu" "${TMP}.expected.full"
+grep -qF "Wrote 12288 of ${IMAGE_SIZE} bytes" "${TMP}.emu.log"
+
+echo "TEST: Full update (emulation, no changes)"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --debug 2>"${TMP}.emu.log"
+cmp "${TMP}.emu" "${TMP}.expected.full"
+grep -qF "Wrote 0 of ${IMAGE_SIZE} bytes" "${TMP}.emu.log"
+
+# Test --plan, which should only print the plan without changing the target.
+cp -f "${TMP}.expected.full" "${TMP}.emu.plan"
+patch_file "${TMP}.emu.plan" FW_MAIN_A 0 "corrupted"
+patch_file "${TMP}.emu.plan" FW_MAIN_B 4090 "corrupted"
+
+echo "TEST: Full update (--plan)"
+cp -f "${TMP}.emu.plan" "${TMP}.emu"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --plan >"${TMP}.plan.out"
+cmp "${TMP}.emu" "${TMP}.emu.plan"
+grep -qF '"mode": "full",' "${TMP}.plan.out"
+grep -qF '"result": { "code": 0,' "${TMP}.plan.out"
+grep -qF '"changed_bytes": 18, "erase_blocks": 3, "erase_block_size": 4096,' \
+	"${TMP}.plan.out"
+grep -qF '"bytes_erased": 12288, "bytes_written": 12288,' "${TMP}.plan.out"
+
+echo "TEST: Full update (--plan, --plan_speed)"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --plan --plan_speed="host=1000/100/50/65536" \
+	>"${TMP}.plan.out"
+cmp "${TMP}.emu" "${TMP}.emu.plan"
+grep -qF '"changed_bytes": 18, "erase_blocks": 2, "erase_block_size": 65536,' \
+	"${TMP}.plan.out"
+grep -qF '"bytes_erased": 131072, "bytes_written": 131072,' "${TMP}.plan.out"
+
+test_update "Full update (--plan, invalid --plan_speed)" \
+	"${TMP}.emu.plan" "!Invalid throughput for host: 1000/100" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1 --plan \
+	--plan_speed="host=1000/100"
+
+# Test --verify_hash, which should verify every section written.
+echo "TEST: Full update (--verify_hash)"
+cp -f "${FROM_IMAGE}" "${TMP}.emu"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --verify_hash >"${TMP}.verify.log" 2>&1
+cmp "${TMP}.emu" "${TMP}.expected.full"
+grep -qF "Verified whole image on host (${IMAGE_SIZE} bytes)" \
+	"${TMP}.verify.log"
+
+echo "TEST: RW update (--verify_hash)"
+cp -f "${FROM_IMAGE}" "${TMP}.emu"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=1 \
+	--sys_props 0,0x10001,1 --verify_hash >"${TMP}.verify.log" 2>&1
+cmp "${TMP}.emu" "${TMP}.expected.rw"
+for section in RW_SECTION_A RW_SECTION_B RW_SHARED RW_LEGACY; do
+	size="$(${FUTILITY} dump_fmap -p "${TO_IMAGE}" "${section}" | \
+		sed 's/.* //')"
+	grep -qF "Verified ${section} on host (${size} bytes)" \
+		"${TMP}.verify.log"
+done
+
+# Test --prop_cache, only when the boot ID is available.
+BOOT_ID_PATH="/proc/sys/kernel/random/boot_id"
+PROP_CACHE="${TMP}.prop_cache"
+
+# args: boot_id timestamp [name=value ...]
+make_prop_cache() {
+	local boot_id="$1"
+	local timestamp="$2"
+
+	shift 2
+	printf '%s\n' "boot_id=${boot_id}" "timestamp=${timestamp}" "$@" \
+		>"${PROP_CACHE}"
+}
+
+if [ -r "${BOOT_ID_PATH}" ]; then
+	BOOT_ID="$(cat "${BOOT_ID_PATH}")"
+	NOW="$(date +%s)"
+
+	make_prop_cache "${BOOT_ID}" "${NOW}" mainfw_act=0 \
+		tpm_fwver=0x10001 fw_vboot2=1 wp_hw=0 wp_sw=0
+	cp -f "${PROP_CACHE}" "${PROP_CACHE}.orig"
+	test_update "Full update (--prop_cache)" \
+		"${FROM_IMAGE}" "${TMP}.expected.full" \
+		-i "${TO_IMAGE}" --prop_cache "${PROP_CACHE}"
+	# Nothing was fetched, so the cache is left alone.
+	cmp "${PROP_CACHE}" "${PROP_CACHE}.orig"
+
+	make_prop_cache "${BOOT_ID}" "${NOW}" mainfw_act=0 \
+		tpm_fwver=0x10001 fw_vboot2=1 wp_hw=1 wp_sw=1
+	test_update "RW update (--prop_cache)" \
+		"${FROM_IMAGE}" "${TMP}.expected.rw" \
+		-i "${TO_IMAGE}" --prop_cache "${PROP_CACHE}"
+
+	make_prop_cache "${BOOT_ID}" "${NOW}" mainfw_act=0 \
+		tpm_fwver=0x10005 fw_vboot2=1 wp_hw=0 wp_sw=0
+	test_update "Full update (--prop_cache, TPM Anti-rollback)" \
+		"${FROM_IMAGE}" "!Firmware version rollback detected (5->4)" \
+		-i "${TO_IMAGE}" --prop_cache "${PROP_CACHE}"
+
+	# A cache from another boot, or an expired one, is ignored and
+	# replaced by the values fetched from the system.
+	make_prop_cache "not-${BOOT_ID}" "${NOW}" tpm_fwver=0x10005
+	test_update "Full update (--prop_cache, other boot)" \
+		"${FROM_IMAGE}" "${TMP}.expected.full" \
+		-i "${TO_IMAGE}" --wp=0 --force --prop_cache "${PROP_CACHE}"
+	grep -qx "boot_id=${BOOT_ID}" "${PROP_CACHE}"
+	[ "$(grep "^tpm_fwver=" "${PROP_CACHE}")" != "tpm_fwver=65541" ]
+
+	make_prop_cache "${BOOT_ID}" "$((NOW - 3600))" tpm_fwver=0x10005
+	test_update "Full update (--prop_cache, expired)" \
+		"${FROM_IMAGE}" "${TMP}.expected.full" \
+		-i "${TO_IMAGE}" --wp=0 --force --prop_cache "${PROP_CACHE}"
+	[ "$(grep "^timestamp=" "${PROP_CACHE}")" != \
+		"timestamp=$((NOW - 3600))" ]
+	[ "$(grep "^tpm_fwver=" "${PROP_CACHE}")" != "tpm_fwver=65541" ]
+
+	# Values fetched later are added without extending the expiry, and
+	# the cached values are written back as decimal.
+	make_prop_cache "${BOOT_ID}" "$((NOW - 100))" mainfw_act=0x0 \
+		fw_vboot2=0x1
+	test_update "Full update (--prop_cache, partial)" \
+		"${FROM_IMAGE}" "${TMP}.expected.full" \
+		-i "${TO_IMAGE}" --wp=0 --force --prop_cache "${PROP_CACHE}"
+	grep -qx "timestamp=$((NOW - 100))" "${PROP_CACHE}"
+	grep -qx "mainfw_act=0" "${PROP_CACHE}"
+	grep -qx "fw_vboot2=1" "${PROP_CACHE}"
+fi
+
 # Test quirks
 test_update "Full update (wrong size)" \
 	"${FROM_IMAGE}.large" "!Image size is different" \
@@ -467,6 +606,26 @@ test_update "Full update (-a, model=WL, no VPD, default keys)" \
 	"${FROM_IMAGE}.al" "${LINK_BIOS}" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=whitetip
 
+# Test manifest with images shared by models: link2 refers to the same file as
+# link, and bios_coral.bin is a different file with the same contents.
+D="${TMP}.dedup"
+mkdir -p "${D}/images"
+cp -r "${SCRIPT_DIR}/futility/models" "${D}/"
+cp -r "${D}/models/link" "${D}/models/link2"
+cp -f "${LINK_BIOS}" "${D}/images/bios_link.bin"
+cp -f "${LINK_BIOS}" "${D}/images/bios_coral.bin"
+cp -f "${PEPPY_BIOS}" "${D}/images/bios_peppy.bin"
+echo "TEST: Manifest (--manifest, shared images)"
+${FUTILITY} update -a "${D}" --manifest >"${TMP}.json.out"
+LINK_SIZE="$(stat -c %s "${LINK_BIOS}")"
+grep -qxF "  \"_dedup\": { \"loads\": 4, \"files\": 3, \"unique\": 2, \
+\"shared_bytes\": $((LINK_SIZE * 2)) }" "${TMP}.json.out"
+# Models sharing an image report the same versions and keys.
+[ "$(grep -A1 '"link": {' "${TMP}.json.out" | tail -1)" = \
+	"$(grep -A1 '"link2": {' "${TMP}.json.out" | tail -1)" ]
+[ "$(grep -A2 '"link": {' "${TMP}.json.out" | tail -1)" = \
+	"$(grep -A2 '"whitetip": {' "${TMP}.json.out" | tail -1)" ]
+
 # Test special programmer
 if type flashrom >/dev/null 2>&1; then
 	echo "TEST: Full update (dummy programmer)"
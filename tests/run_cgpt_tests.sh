@@ -316,6 +316,66 @@ $CGPT show $MTD ${DEV} | grep -q INVALID
 $CGPT repair $MTD ${DEV}
 ($CGPT show $MTD ${DEV} | grep -q INVALID) && error
 
+echo "Test cgpt batch command..."
+$CGPT create $MTD ${DEV}
+$CGPT batch $MTD ${DEV} <<EOF
+# Comments and empty lines are ignored.
+
+add -b ${DATA_START} -s ${DATA_SIZE} -t ${DATA_GUID} -l "${DATA_LABEL}"
+add -b ${KERN_START} -s ${KERN_SIZE} -t ${KERN_GUID} -l '${KERN_LABEL}'
+add -i ${KERN_NUM} -P 5 -T 1
+prioritize -i ${KERN_NUM}
+EOF
+X=$($CGPT show $MTD -l -i ${DATA_NUM} ${DEV})
+[ "$X" = "${DATA_LABEL}" ] || error
+X=$($CGPT show $MTD -l -i ${KERN_NUM} ${DEV})
+[ "$X" = "${KERN_LABEL}" ] || error
+X=$($CGPT show $MTD -P -i ${KERN_NUM} ${DEV})
+[ "$X" = "1" ] || error
+
+# Nothing is written if any command fails.
+cp ${DEV} ${DEV}.orig
+printf 'add -i %d -T 0\nadd -b %d -s 1 -t data\n' ${KERN_NUM} ${DATA_START} |
+  assert_fail $CGPT batch $MTD ${DEV}
+cmp ${DEV} ${DEV}.orig || error
+assert_fail $CGPT batch $MTD -f /dev/null -x ${DEV}
+echo "find -t kernel" | assert_fail $CGPT batch $MTD ${DEV}
+rm -f ${DEV}.orig
+
+echo "Test cgpt show with JSON output and several drives..."
+X=$($CGPT show $MTD --json ${DEV} | grep -c '"number": ')
+[ "$X" = "2" ] || error
+X=$($CGPT show $MTD -j -i ${KERN_NUM} ${DEV} | grep -o '"label": "[^"]*"')
+[ "$X" = "\"label\": \"${KERN_LABEL}\"" ] || error
+cp ${DEV} ${DEV}.2
+X=$($CGPT show $MTD -P -i ${KERN_NUM} ${DEV} ${DEV}.2 | grep -cx 1)
+[ "$X" = "2" ] || error
+X=$($CGPT show $MTD -j ${DEV} ${DEV}.2 | grep -c '"drive": ')
+[ "$X" = "2" ] || error
+assert_fail $CGPT show $MTD ${DEV} ${DEV}.missing
+assert_fail $CGPT show $MTD -j -P -i ${KERN_NUM} ${DEV}
+rm -f ${DEV}.2
+
+echo "Test cgpt create and repair on a sparse image..."
+SPARSE=sparse.bin
+rm -f ${SPARSE}
+truncate -s 1G ${SPARSE}
+# Only the blocks holding the headers get allocated, the empty tables are
+# left as holes.
+BLOCKS=$(( $(stat -c %o ${SPARSE}) / 512 * 2 ))
+$CGPT create ${SPARSE}
+[ "$(stat -c %b ${SPARSE})" -le "${BLOCKS}" ] || error
+dd if=/dev/zero of=${SPARSE} conv=notrunc bs=512 count=1 seek=1 2>/dev/null
+$CGPT repair ${SPARSE}
+($CGPT show ${SPARSE} | grep -q INVALID) && error
+[ "$(stat -c %b ${SPARSE})" -le "${BLOCKS}" ] || error
+# Zeros written over old data read back as zeros.
+yes | head -c $(( 34 * 512 )) | dd of=${SPARSE} conv=notrunc 2>/dev/null
+$CGPT create ${SPARSE}
+[ -z "$(dd if=${SPARSE} bs=512 skip=2 count=32 2>/dev/null | tr -d '\0')" ] ||
+  error
+rm -f ${SPARSE}
+
 echo "Test with IGNOREME primary GPT..."
 $CGPT create $MTD ${DEV}
 $CGPT legacy $MTD -p ${DEV}
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "2common.h"
 #include "2sha.h"
@@ -15,6 +16,55 @@
 
 #define TEST_BUFFER_SIZE 4000000
 
+/* Scattered data: every other one of 2 * TEST_SEGMENTS chunks is hashed. */
+#define TEST_SEGMENTS 64
+#define TEST_SEGMENT_SIZE (TEST_BUFFER_SIZE / (2 * TEST_SEGMENTS))
+#define TEST_SG_ITERATIONS 10
+
+/* Hash scattered data by copying it together first. */
+static void hash_copy(const struct vb2_hash_segment *segs, uint8_t *staging,
+		      uint8_t *digest)
+{
+	uint32_t i;
+
+	for (i = 0; i < TEST_SEGMENTS; i++)
+		memcpy(staging + i * TEST_SEGMENT_SIZE, segs[i].buf,
+		       segs[i].size);
+	vb2_digest_buffer(staging, TEST_SEGMENTS * TEST_SEGMENT_SIZE,
+			  VB2_HASH_SHA256, digest, VB2_MAX_DIGEST_SIZE);
+}
+
+/* Hash scattered data in place. */
+static void hash_sg(const struct vb2_hash_segment *segs, uint8_t *staging,
+		    uint8_t *digest)
+{
+	struct vb2_digest_context dc;
+
+	vb2_digest_init(&dc, VB2_HASH_SHA256);
+	vb2_digest_extend_sg(&dc, segs, TEST_SEGMENTS);
+	vb2_digest_finalize(&dc, digest, VB2_MAX_DIGEST_SIZE);
+}
+
+static void run_sg(const char *name, const struct vb2_hash_segment *segs,
+		   uint8_t *staging, uint8_t *digest,
+		   void (*hash)(const struct vb2_hash_segment *, uint8_t *,
+				uint8_t *))
+{
+	ClockTimerState ct;
+	uint32_t i, msecs;
+
+	StartTimer(&ct);
+	for (i = 0; i < TEST_SG_ITERATIONS; i++)
+		hash(segs, staging, digest);
+	StopTimer(&ct);
+	msecs = GetDurationMsecs(&ct);
+
+	fprintf(stderr, "# SHA256 %u segments, %s: %u iterations = %u ms\n",
+		TEST_SEGMENTS, name, TEST_SG_ITERATIONS, msecs);
+	fprintf(stdout, "usecs_per_sg_hash_%s:%f\n", name,
+		msecs * 1000.0 / TEST_SG_ITERATIONS);
+}
+
 int main(int argc, char *argv[]) {
 	int i;
 	double speed;
@@ -41,6 +91,21 @@ int main(int argc, char *argv[]) {
 			vb2_get_hash_algorithm_name(i), speed);
 	}
 
+	/* Compare hashing scattered data in place with copying it first. */
+	struct vb2_hash_segment segs[TEST_SEGMENTS];
+	uint8_t digest_sg[VB2_MAX_DIGEST_SIZE];
+	uint8_t *staging = malloc(TEST_SEGMENTS * TEST_SEGMENT_SIZE);
+
+	for (i = 0; i < TEST_SEGMENTS; i++) {
+		segs[i].buf = buffer + 2 * i * TEST_SEGMENT_SIZE;
+		segs[i].size = TEST_SEGMENT_SIZE;
+	}
+	run_sg("copy", segs, staging, digest, hash_copy);
+	run_sg("in_place", segs, staging, digest_sg, hash_sg);
+	if (memcmp(digest, digest_sg, vb2_digest_size(VB2_HASH_SHA256)))
+		fprintf(stderr, "# Scatter-gather digest mismatch!\n");
+
+	free(staging);
 	free(buffer);
 	return 0;
 }
@@ -692,6 +692,7 @@ static void init_hash_tests(void)
 static void extend_hash_tests(void)
 {
 	struct vb2_digest_context *dc;
+	struct vb2_hash_segment segs[3];
 
 	reset_common_data(FOR_EXTEND_HASH);
 	TEST_SUCC(vb2api_extend_hash(ctx, mock_body, 32),
@@ -715,6 +716,33 @@ static void extend_hash_tests(void)
 	TEST_EQ(vb2api_extend_hash(ctx, mock_body, 0),
 		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend empty");
 
+	reset_common_data(FOR_EXTEND_HASH);
+	segs[0].buf = mock_body;
+	segs[0].size = 16;
+	segs[1].buf = NULL;
+	segs[1].size = 0;
+	segs[2].buf = mock_body + 16;
+	segs[2].size = mock_body_size - 16;
+	TEST_SUCC(vb2api_extend_hash_sg(ctx, segs, 3), "hash extend sg good");
+	TEST_EQ(sd->hash_remaining_size, 0, "hash extend sg remaining");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	segs[2].size = mock_body_size - 15;
+	TEST_EQ(vb2api_extend_hash_sg(ctx, segs, 3),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend sg too much");
+	TEST_EQ(sd->hash_remaining_size, mock_body_size,
+		"hash extend sg too much remaining");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	segs[0].size = 16;
+	segs[2].size = UINT32_MAX - 8;
+	TEST_EQ(vb2api_extend_hash_sg(ctx, segs, 3),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend sg overflow");
+
+	reset_common_data(FOR_EXTEND_HASH);
+	TEST_EQ(vb2api_extend_hash_sg(ctx, segs + 1, 1),
+		VB2_ERROR_API_EXTEND_HASH_SIZE, "hash extend sg empty");
+
 	if (hwcrypto_state != HWCRYPTO_ENABLED) {
 		reset_common_data(FOR_EXTEND_HASH);
 		dc = (struct vb2_digest_context *)
@@ -108,6 +108,7 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	struct vb2_public_key pubk, pubk_orig;
 	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
 	struct vb2_signature *sig2;
+	struct vb2_hash_segment segs[3];
 
 	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
 
@@ -139,6 +140,35 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	TEST_EQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
 		0, "vb2_verify_data() ok");
 
+	segs[0].buf = test_data;
+	segs[0].size = 10;
+	segs[1].buf = NULL;
+	segs[1].size = 0;
+	segs[2].buf = test_data + 10;
+	segs[2].size = test_size - 10;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_SUCC(vb2_verify_data_sg(segs, 3, sig2, &pubk, &wb),
+		  "vb2_verify_data_sg() ok");
+
+	/* Data past the signed length is ignored */
+	segs[2].size = test_size;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_SUCC(vb2_verify_data_sg(segs, 3, sig2, &pubk, &wb),
+		  "vb2_verify_data_sg() extra data ok");
+
+	segs[2].size = test_size - 11;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_EQ(vb2_verify_data_sg(segs, 3, sig2, &pubk, &wb),
+		VB2_ERROR_VDATA_NOT_ENOUGH_DATA,
+		"vb2_verify_data_sg() segments too small");
+
+	segs[0].buf = test_data + 10;
+	segs[2].buf = test_data;
+	segs[2].size = test_size - 10;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_NEQ(vb2_verify_data_sg(segs, 3, sig2, &pubk, &wb),
+		 0, "vb2_verify_data_sg() segments out of order");
+
 	memcpy(sig2, sig, sig_total_size);
 	sig2->sig_size -= 16;
 	TEST_NEQ(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
@@ -182,6 +212,49 @@ static void test_verify_data(const struct vb2_packed_key *key1,
 	free(sig2);
 }
 
+static void test_workbuf_profile(const struct vb2_packed_key *key1,
+				 const struct vb2_signature *sig)
+{
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	struct vb2_workbuf wb;
+
+	struct vb2_public_key pubk;
+	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
+	struct vb2_signature *sig2;
+	uint32_t peak = 0;
+
+	TEST_SUCC(vb2_unpack_key(&pubk, key1), "workbuf profile unpack key");
+
+	sig2 = (struct vb2_signature *)malloc(sig_total_size);
+	memcpy(sig2, sig, sig_total_size);
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	wb.peak = &peak;
+#if WORKBUF_PROFILE
+	vb2_workbuf_clear_sites();
+#endif
+
+	TEST_SUCC(vb2_verify_data(test_data, test_size, sig2, &pubk, &wb),
+		  "workbuf profile verify data");
+	TEST_TRUE(peak > 0 && peak <= VB2_VERIFY_DATA_WORKBUF_BYTES,
+		  "  workbuf peak within VB2_VERIFY_DATA_WORKBUF_BYTES");
+	printf("vb2_verify_data() workbuf peak: %u of %zu bytes\n",
+	       peak, sizeof(workbuf));
+
+#if WORKBUF_PROFILE
+	{
+		const struct vb2_workbuf_site *site = vb2_workbuf_get_sites();
+		int i;
+
+		for (i = 0; i < VB2_WORKBUF_PROFILE_SITES && site[i].func; i++)
+			printf("  %s: %u allocs, max %u bytes\n",
+			       site[i].func, site[i].count, site[i].max_size);
+	}
+#endif
+
+	free(sig2);
+}
 
 static int test_algorithm(int key_algorithm, const char *keys_dir)
 {
@@ -222,6 +295,7 @@ static int test_algorithm(int key_algorithm, const char *keys_dir)
 
 	test_unpack_key(key1);
 	test_verify_data(key1, sig);
+	test_workbuf_profile(key1, sig);
 
 	retval = 0;
 
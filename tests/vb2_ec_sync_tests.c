@@ -42,6 +42,14 @@ static int mock_ec_rw_hash_size;
 static uint8_t hexp[32];
 static uint8_t update_hash;
 static int hexp_size;
+#define MOCK_BLOCK_COUNT 4
+static uint8_t mock_block_hexp[MOCK_BLOCK_COUNT][32];
+static uint8_t mock_block_heff[MOCK_BLOCK_COUNT][32];
+static uint32_t mock_block_size;
+static uint32_t mock_block_count;
+static int ec_blocks_updated;
+static vb2_error_t update_block_retval;
+static int update_block_broken;
 static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
 	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
 static struct vb2_context *ctx;
@@ -92,6 +100,15 @@ static void ResetMocks(void)
 
 	update_hash = 42;
 
+	/* No block hashes unless a test asks for them */
+	memset(mock_block_hexp, 0, sizeof(mock_block_hexp));
+	memset(mock_block_heff, 0, sizeof(mock_block_heff));
+	mock_block_size = 0x1000;
+	mock_block_count = 0;
+	ec_blocks_updated = 0;
+	update_block_retval = VB2_SUCCESS;
+	update_block_broken = 0;
+
 	vb2api_secdata_kernel_create(ctx);
 	vb2_secdata_kernel_init(ctx);
 
@@ -190,6 +207,54 @@ vb2_error_t vb2ex_ec_update_image(enum vb2_firmware_selection select)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2ex_ec_get_expected_block_hashes(
+	enum vb2_firmware_selection select, const uint8_t **hashes,
+	uint32_t *block_size, uint32_t *block_count)
+{
+	if (!mock_block_count)
+		return VB2_ERROR_EX_UNIMPLEMENTED;
+
+	*hashes = mock_block_hexp[0];
+	*block_size = mock_block_size;
+	*block_count = mock_block_count;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_ec_hash_block(enum vb2_firmware_selection select,
+				uint32_t block, const uint8_t **hash,
+				int *hash_size)
+{
+	*hash = mock_block_heff[block];
+	*hash_size = sizeof(mock_block_heff[block]);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_ec_update_block(enum vb2_firmware_selection select,
+				  uint32_t block)
+{
+	if (update_block_retval)
+		return update_block_retval;
+
+	ec_blocks_updated++;
+	if (update_block_broken)
+		return VB2_SUCCESS;
+
+	memcpy(mock_block_heff[block], mock_block_hexp[block],
+	       sizeof(mock_block_heff[block]));
+
+	/* Once every block matches, so does the whole image */
+	if (!memcmp(mock_block_heff, mock_block_hexp, sizeof(mock_block_heff))) {
+		if (select == VB_SELECT_FIRMWARE_READONLY) {
+			ec_ro_updated = 1;
+			mock_ec_ro_hash[0] = update_hash;
+		} else {
+			ec_rw_updated = 1;
+			mock_ec_rw_hash[0] = update_hash;
+		}
+	}
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2ex_ec_vboot_done(struct vb2_context *c)
 {
 	ec_vboot_done_calls++;
@@ -427,6 +492,58 @@ static void VbSoftwareSyncTest(void)
 	TEST_EQ(ec_rw_protected, 1, "  ec rw protected");
 	TEST_EQ(ec_run_image, 1, "  ec run image");
 
+	/* Block-by-block updates */
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCK_COUNT;
+	mock_block_heff[1][0] = 1;
+	mock_block_heff[3][5] = 1;
+	test_ssync(0, 0, "Update rw blocks");
+	TEST_EQ(ec_blocks_updated, 2, "  ec blocks updated");
+	TEST_EQ(ec_ro_updated, 0, "  ec ro updated");
+	TEST_EQ(ec_rw_updated, 1, "  ec rw updated");
+	TEST_EQ(ec_rw_protected, 1, "  ec rw protected");
+	TEST_EQ(ec_run_image, 1, "  ec run image");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCK_COUNT;
+	mock_block_size = 0;
+	test_ssync(VB2_ERROR_EC_BLOCK_HASHES,
+		   VB2_RECOVERY_EC_UPDATE, "Invalid block hashes");
+	TEST_EQ(ec_blocks_updated, 0, "  ec blocks updated");
+	TEST_EQ(ec_rw_updated, 0, "  ec rw updated");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCK_COUNT;
+	mock_block_heff[2][0] = 1;
+	update_block_retval = VB2_ERROR_MOCK;
+	test_ssync(VB2_ERROR_MOCK,
+		   VB2_RECOVERY_EC_UPDATE, "Update rw block failed");
+	TEST_EQ(ec_rw_updated, 0, "  ec rw updated");
+	TEST_EQ(ec_run_image, 0, "  ec run image");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCK_COUNT;
+	mock_block_heff[2][0] = 1;
+	update_block_broken = 1;
+	test_ssync(VB2_ERROR_EC_BLOCK_VERIFY,
+		   VB2_RECOVERY_EC_UPDATE, "Updated rw block still differs");
+	TEST_EQ(ec_blocks_updated, 1, "  ec blocks updated");
+	TEST_EQ(ec_rw_updated, 0, "  ec rw updated");
+	TEST_EQ(ec_run_image, 0, "  ec run image");
+
+	ResetMocks();
+	mock_ec_rw_hash[0]++;
+	mock_block_count = MOCK_BLOCK_COUNT;
+	test_ssync(VB2_REQUEST_REBOOT_EC_TO_RO,
+		   VB2_RECOVERY_EC_UPDATE, "Blocks match but image differs");
+	TEST_EQ(ec_blocks_updated, 0, "  ec blocks updated");
+	TEST_EQ(ec_rw_updated, 0, "  ec rw updated");
+	TEST_EQ(ec_run_image, 0, "  ec run image");
+
 	ResetMocks();
 	vb2_nv_set(ctx, VB2_NV_TRY_RO_SYNC, 1);
 	mock_ec_ro_hash[0]++;
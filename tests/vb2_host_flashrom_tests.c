@@ -20,10 +20,12 @@
 #include "2return_codes.h"
 #include "host_misc.h"
 #include "flashrom.h"
+#include "fmap.h"
 #include "subprocess.h"
 #include "test_common.h"
 
 #define MOCK_TMPFILE_NAME "/tmp/vb2_unittest"
+#define MOCK_TMPFILE2_NAME "/tmp/vb2_unittest2"
 #define MOCK_ROM_CONTENTS "bloop123"
 
 static bool flashrom_mock_success = true;
@@ -34,14 +36,21 @@ static enum {
 } captured_verify;
 static const char *captured_op_filename;
 static const char *captured_region_param;
+static const char *captured_region2_param;
+static uint8_t *captured_layout;
+static uint32_t captured_layout_size;
 static const char *captured_programmer;
 static uint8_t *captured_rom_contents;
 static uint32_t captured_rom_size;
 
+/* Number of temporary files created since the last flashrom run. */
+static int mock_tmpfile_count;
+
 /* Mocked mkstemp for tests. */
 int mkstemp(char *template_name)
 {
-	strncpy(template_name, MOCK_TMPFILE_NAME, strlen(template_name));
+	strncpy(template_name, mock_tmpfile_count++ ? MOCK_TMPFILE2_NAME :
+		MOCK_TMPFILE_NAME, strlen(template_name));
 	return open(template_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
 }
 
@@ -70,6 +79,11 @@ int subprocess_run(const char *const argv[],
 	captured_operation = FLASHROM_VERIFY_UNSPECIFIED;
 	captured_op_filename = NULL;
 	captured_region_param = NULL;
+	captured_region2_param = NULL;
+	free(captured_layout);
+	captured_layout = NULL;
+	captured_layout_size = 0;
+	mock_tmpfile_count = 0;
 	captured_programmer = NULL;
 	captured_rom_contents = NULL;
 	captured_rom_size = 0;
@@ -84,7 +98,7 @@ int subprocess_run(const char *const argv[],
 	   wrapper library.  If it's updated to support more modes of
 	   operation, this unit test code should be updated too. */
 	while ((opt = getopt_long(argc, (char *const *)argv,
-				  ":p:r:w:i:", long_opts, NULL)) != -1) {
+				  ":p:r:w:i:l:", long_opts, NULL)) != -1) {
 		/* Always consume the next argument if it does not
 		   start with a dash.  We have to muck with getopt's
 		   global variables to make this happen. */
@@ -112,7 +126,15 @@ int subprocess_run(const char *const argv[],
 			captured_op_filename = optarg;
 			break;
 		case 'i':
-			captured_region_param = optarg;
+			if (captured_region_param)
+				captured_region2_param = optarg;
+			else
+				captured_region_param = optarg;
+			break;
+		case 'l':
+			if (optarg)
+				vb2_read_file(optarg, &captured_layout,
+					      &captured_layout_size);
 			break;
 		case 0:
 			/* long option */
@@ -134,6 +156,10 @@ int subprocess_run(const char *const argv[],
 		/* Write the mocked string we read from the ROM. */
 		rv |= vb2_write_file(MOCK_TMPFILE_NAME, MOCK_ROM_CONTENTS,
 				     strlen(MOCK_ROM_CONTENTS));
+		if (captured_region2_param)
+			rv |= vb2_write_file(MOCK_TMPFILE2_NAME,
+					     MOCK_ROM_CONTENTS,
+					     strlen(MOCK_ROM_CONTENTS));
 	} else if (captured_operation == FLASHROM_WRITE) {
 		/* Capture the buffer contents we wrote to the ROM. */
 		rv |= vb2_read_file(MOCK_TMPFILE_NAME, &captured_rom_contents,
@@ -254,6 +280,110 @@ static void test_write_failure(void)
 	flashrom_mock_success = true;
 }
 
+static void test_read_with_fmap(void)
+{
+	uint8_t *buf;
+	uint32_t buf_sz;
+	uint8_t *fmap;
+	uint32_t fmap_sz;
+
+	TEST_SUCC(flashrom_read_with_fmap("someprog", "SOME_REGION", &buf,
+					  &buf_sz, &fmap, &fmap_sz),
+		  "Flashrom read with FMAP succeeds");
+	TEST_STR_EQ(captured_programmer, "someprog",
+		    "Using specified programmer");
+	TEST_EQ(captured_operation, FLASHROM_READ, "Doing a read operation");
+	TEST_STR_EQ(captured_region_param, "SOME_REGION:" MOCK_TMPFILE_NAME,
+		    "Reading the region to correct file");
+	TEST_STR_EQ(captured_region2_param, "FMAP:" MOCK_TMPFILE2_NAME,
+		    "Reading the FMAP to correct file");
+	TEST_EQ(buf_sz, strlen(MOCK_ROM_CONTENTS), "Contents correct size");
+	TEST_SUCC(memcmp(buf, MOCK_ROM_CONTENTS, buf_sz),
+		  "Buffer has correct contents");
+	TEST_EQ(fmap_sz, strlen(MOCK_ROM_CONTENTS), "FMAP correct size");
+	TEST_SUCC(memcmp(fmap, MOCK_ROM_CONTENTS, fmap_sz),
+		  "FMAP has correct contents");
+
+	free(buf);
+	free(fmap);
+}
+
+static void test_read_with_fmap_failure(void)
+{
+	uint8_t *buf;
+	uint32_t buf_sz;
+	uint8_t *fmap;
+	uint32_t fmap_sz;
+
+	flashrom_mock_success = false;
+	TEST_NEQ(flashrom_read_with_fmap("someprog", "SOME_REGION", &buf,
+					 &buf_sz, &fmap, &fmap_sz),
+		 VB2_SUCCESS, "Flashrom read with FMAP fails");
+	TEST_PTR_EQ(buf, NULL, "No region buffer");
+	TEST_PTR_EQ(fmap, NULL, "No FMAP buffer");
+	flashrom_mock_success = true;
+}
+
+/* An FMAP with SOME_REGION at 0x1000 and 0x100 bytes long. */
+static struct {
+	FmapHeader header;
+	FmapAreaHeader area;
+} __attribute__((packed)) mock_fmap = {
+	.header = {
+		.fmap_signature = FMAP_SIGNATURE,
+		.fmap_ver_major = FMAP_VER_MAJOR,
+		.fmap_nareas = 1,
+	},
+	.area = {
+		.area_offset = 0x1000,
+		.area_size = 0x100,
+		.area_name = "SOME_REGION",
+	},
+};
+
+static void test_write_range(void)
+{
+	uint8_t buf[sizeof(MOCK_ROM_CONTENTS) - 1];
+	const char *expected_layout = "00001010:00001017 SOME_REGION\n";
+
+	memcpy(buf, MOCK_ROM_CONTENTS, sizeof(buf));
+
+	TEST_SUCC(flashrom_write_range("someprog", (uint8_t *)&mock_fmap,
+				       sizeof(mock_fmap), "SOME_REGION", 0x10,
+				       buf, sizeof(buf)),
+		  "Flashrom range write succeeds");
+	TEST_STR_EQ(captured_programmer, "someprog",
+		    "Using specified programmer");
+	TEST_EQ(captured_operation, FLASHROM_WRITE, "Doing a write operation");
+	TEST_EQ(captured_verify, FLASHROM_VERIFY_FAST,
+		"Fast verification enabled");
+	TEST_EQ(captured_layout_size, strlen(expected_layout),
+		"Layout correct size");
+	TEST_SUCC(memcmp(captured_layout, expected_layout,
+			 captured_layout_size),
+		  "Layout covers only the range");
+	TEST_STR_EQ(captured_region_param, "SOME_REGION:" MOCK_TMPFILE_NAME,
+		    "Writing from correct file to the range");
+	TEST_EQ(captured_rom_size, strlen(MOCK_ROM_CONTENTS),
+		"Contents correct size");
+	TEST_SUCC(memcmp(captured_rom_contents, MOCK_ROM_CONTENTS,
+			 captured_rom_size), "Buffer has correct contents");
+}
+
+static void test_write_range_outside(void)
+{
+	uint8_t buf[0x20] = { 0 };
+
+	TEST_NEQ(flashrom_write_range("someprog", (uint8_t *)&mock_fmap,
+				      sizeof(mock_fmap), "OTHER_REGION", 0,
+				      buf, sizeof(buf)),
+		 VB2_SUCCESS, "Range write fails for an unknown region");
+	TEST_NEQ(flashrom_write_range("someprog", (uint8_t *)&mock_fmap,
+				      sizeof(mock_fmap), "SOME_REGION", 0xf0,
+				      buf, sizeof(buf)),
+		 VB2_SUCCESS, "Range write fails past the end of the region");
+}
+
 int main(int argc, char *argv[])
 {
 	test_read_whole_chip();
@@ -262,6 +392,10 @@ int main(int argc, char *argv[])
 	test_write_whole_chip();
 	test_write_region();
 	test_write_failure();
+	test_read_with_fmap();
+	test_read_with_fmap_failure();
+	test_write_range();
+	test_write_range_outside();
 
 	return gTestSuccess ? 0 : 255;
 }
@@ -0,0 +1,183 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the host hwcrypto provider.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+#include "host_common.h"
+#include "host_key21.h"
+#include "test_common.h"
+#include "vb2_common.h"
+
+static const uint8_t test_data[] = "This is some test data to hash and sign.";
+
+static void test_digest(void)
+{
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	int alg;
+
+	for (alg = VB2_HASH_SHA1; alg < VB2_HASH_ALG_COUNT; alg++) {
+		printf("***Testing digest: %s\n",
+		       vb2_get_hash_algorithm_name(alg));
+		vb2_digest_buffer(test_data, sizeof(test_data), alg,
+				  expect, sizeof(expect));
+
+		TEST_SUCC(vb2ex_hwcrypto_digest_init(alg, sizeof(test_data)),
+			  "digest init");
+		TEST_SUCC(vb2ex_hwcrypto_digest_extend(test_data, 10),
+			  "digest extend");
+		TEST_SUCC(vb2ex_hwcrypto_digest_extend(test_data + 10,
+						       sizeof(test_data) - 10),
+			  "digest extend again");
+		TEST_SUCC(vb2ex_hwcrypto_digest_finalize(digest,
+							 sizeof(digest)),
+			  "digest finalize");
+		TEST_SUCC(memcmp(digest, expect, vb2_digest_size(alg)),
+			  "digest matches software digest");
+	}
+
+	TEST_EQ(vb2ex_hwcrypto_digest_init(VB2_HASH_NONE, 0),
+		VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED, "digest init unsupported");
+
+	TEST_SUCC(vb2ex_hwcrypto_digest_init(VB2_HASH_SHA256, 0),
+		  "digest init for small finalize");
+	TEST_EQ(vb2ex_hwcrypto_digest_finalize(digest,
+					       VB2_SHA256_DIGEST_SIZE - 1),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE, "digest finalize too small");
+}
+
+static void test_rsa(const struct vb2_packed_key *key1,
+		     const struct vb2_signature *sig)
+{
+	uint8_t workbuf[VB2_VERIFY_DATA_WORKBUF_BYTES]
+		 __attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	uint32_t workbuf32[VB2_VERIFY_RSA_DIGEST_WORKBUF_BYTES / sizeof(uint32_t)];
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+	uint32_t sig_total_size = sig->sig_offset + sig->sig_size;
+	uint32_t digest_size;
+	struct vb2_public_key pubk;
+	struct vb2_signature *sig2;
+	struct vb2_workbuf wb;
+	uint8_t *buf;
+
+	TEST_SUCC(vb2_unpack_key(&pubk, key1), "unpack key");
+	digest_size = vb2_digest_size(pubk.hash_alg);
+	vb2_digest_buffer(test_data, sizeof(test_data), pubk.hash_alg,
+			  digest, sizeof(digest));
+
+	TEST_SUCC(vb2ex_hwcrypto_rsa_verify_digest(&pubk,
+						   vb2_signature_data(sig),
+						   digest),
+		  "rsa verify digest");
+	digest[0] ^= 0x5A;
+	TEST_EQ(vb2ex_hwcrypto_rsa_verify_digest(&pubk,
+						 vb2_signature_data(sig),
+						 digest),
+		VB2_ERROR_RSA_VERIFY_DIGEST, "rsa verify wrong digest");
+	digest[0] ^= 0x5A;
+
+	/* modexp leaves the padded digest, which ends with the digest */
+	buf = malloc(sig->sig_size);
+	memcpy(buf, vb2_signature_data(sig), sig->sig_size);
+	TEST_SUCC(vb2ex_hwcrypto_modexp(&pubk, buf, workbuf32,
+					pubk.sig_alg == VB2_SIG_RSA2048_EXP3 ||
+					pubk.sig_alg == VB2_SIG_RSA3072_EXP3 ?
+					3 : 65537),
+		  "modexp");
+	TEST_SUCC(memcmp(buf + sig->sig_size - digest_size, digest,
+			 digest_size), "modexp result");
+	free(buf);
+
+	/* Whole verification, taking the hwcrypto path */
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	sig2 = malloc(sig_total_size);
+	pubk.allow_hwcrypto = 1;
+	memcpy(sig2, sig, sig_total_size);
+	TEST_SUCC(vb2_verify_data(test_data, sizeof(test_data), sig2, &pubk,
+				  &wb), "verify data with hwcrypto");
+	memcpy(sig2, sig, sig_total_size);
+	vb2_signature_data_mutable(sig2)[0] ^= 0x5A;
+	TEST_NEQ(vb2_verify_data(test_data, sizeof(test_data), sig2, &pubk,
+				 &wb), 0, "verify data with hwcrypto wrong sig");
+	free(sig2);
+}
+
+static int test_algorithm(int key_algorithm, const char *keys_dir)
+{
+	char filename[1024];
+	struct vb2_private_key *private_key = NULL;
+	struct vb2_signature *sig = NULL;
+	struct vb2_packed_key *key1 = NULL;
+	int retval = 1;
+
+	printf("***Testing algorithm: %s\n",
+	       vb2_get_crypto_algorithm_name(key_algorithm));
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.pem",
+		 keys_dir, vb2_get_crypto_algorithm_file(key_algorithm));
+	private_key = vb2_read_private_key_pem(filename, key_algorithm);
+	if (!private_key) {
+		fprintf(stderr, "Error reading private_key: %s\n", filename);
+		goto cleanup_algorithm;
+	}
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.keyb",
+		 keys_dir, vb2_get_crypto_algorithm_file(key_algorithm));
+	key1 = vb2_read_packed_keyb(filename, key_algorithm, 1);
+	if (!key1) {
+		fprintf(stderr, "Error reading public_key: %s\n", filename);
+		goto cleanup_algorithm;
+	}
+
+	sig = vb2_calculate_signature(test_data, sizeof(test_data),
+				      private_key);
+	TEST_PTR_NEQ(sig, 0, "Calculate signature");
+	if (!sig)
+		goto cleanup_algorithm;
+
+	test_rsa(key1, sig);
+
+	retval = 0;
+
+cleanup_algorithm:
+	free(key1);
+	free(private_key);
+	free(sig);
+	return retval;
+}
+
+/* Test only the algorithms we use */
+const int key_algs[] = {
+	VB2_ALG_RSA2048_SHA256,
+	VB2_ALG_RSA4096_SHA256,
+	VB2_ALG_RSA8192_SHA512,
+};
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <keys_dir>", argv[0]);
+		return -1;
+	}
+
+	test_digest();
+
+	for (i = 0; i < ARRAY_SIZE(key_algs); i++) {
+		if (test_algorithm(key_algs[i], argv[1]))
+			return 1;
+	}
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -31,6 +31,8 @@ static void assert_mock_params(const char *programmer, const char *region)
 }
 
 static bool mock_flashrom_fail;
+static int mock_flashrom_writes;
+static int mock_flashrom_range_writes;
 
 /* To support both 16-byte and 64-byte nvdata with the same fake
    eeprom, we can size the flash chip to be 16x64. So, for 16-byte
@@ -78,6 +80,8 @@ static void reset_test_data(struct vb2_context *ctx, int nvdata_size)
 
 	/* Flashrom succeeds unless the test says otherwise. */
 	mock_flashrom_fail = false;
+	mock_flashrom_writes = 0;
+	mock_flashrom_range_writes = 0;
 }
 
 /* Mocked flashrom_read for tests. */
@@ -110,6 +114,45 @@ vb2_error_t flashrom_write(const char *programmer, const char *region,
 	TEST_EQ(data_size, sizeof(fake_flash_region),
 		"The flash size is correct");
 	memcpy(fake_flash_region, data, data_size);
+	mock_flashrom_writes++;
+	return VB2_SUCCESS;
+}
+
+/* Mocked flashrom_read_with_fmap for tests. */
+vb2_error_t flashrom_read_with_fmap(const char *programmer, const char *region,
+				    uint8_t **data_out, uint32_t *size_out,
+				    uint8_t **fmap_out, uint32_t *fmap_size_out)
+{
+	vb2_error_t rv;
+
+	*fmap_out = NULL;
+	*fmap_size_out = 0;
+
+	rv = flashrom_read(programmer, region, data_out, size_out);
+	if (rv == VB2_SUCCESS) {
+		/* The FMAP is only passed on to flashrom_write_range(). */
+		*fmap_out = malloc(1);
+		*fmap_size_out = 1;
+	}
+	return rv;
+}
+
+/* Mocked flashrom_write_range for tests. */
+vb2_error_t flashrom_write_range(const char *programmer, uint8_t *fmap,
+				 uint32_t fmap_size, const char *region,
+				 uint32_t offset, uint8_t *data,
+				 uint32_t size)
+{
+	if (mock_flashrom_fail)
+		return VB2_ERROR_FLASHROM;
+
+	assert_mock_params(programmer, region);
+
+	TEST_PTR_NEQ(fmap, NULL, "The FMAP is passed on");
+	TEST_TRUE(offset + size <= sizeof(fake_flash_region),
+		  "The range is inside of the flash");
+	memcpy(fake_flash_region + offset, data, size);
+	mock_flashrom_range_writes++;
 	return VB2_SUCCESS;
 }
 
@@ -161,6 +204,25 @@ static void test_read_ok_full(void)
 		0, "The nvdata in the vb2_context was updated from flash");
 }
 
+static void test_read_ok_middle(void)
+{
+	struct vb2_context ctx;
+
+	reset_test_data(&ctx, sizeof(test_nvdata_16b));
+
+	for (int entry = 0; entry < 36; entry++)
+		memcpy(fake_flash_region + (entry * VB2_NVDATA_SIZE),
+		       test_nvdata_16b, sizeof(test_nvdata_16b));
+
+	memcpy(fake_flash_region + (36 * VB2_NVDATA_SIZE), test_nvdata2_16b,
+	       sizeof(test_nvdata2_16b));
+
+	TEST_EQ(vb2_read_nv_storage_flashrom(&ctx), 0,
+		"Reading storage succeeds");
+	TEST_EQ(memcmp(ctx.nvdata, test_nvdata2_16b, sizeof(test_nvdata2_16b)),
+		0, "The last entry before the erased ones is read");
+}
+
 static void test_read_fail_uninitialized(void)
 {
 	struct vb2_context ctx;
@@ -196,6 +258,8 @@ static void test_write_ok_beginning(void)
 	TEST_EQ(memcmp(fake_flash_region + VB2_NVDATA_SIZE, test_nvdata2_16b,
 		       sizeof(test_nvdata2_16b)),
 		0, "The flash was updated with a new entry");
+	TEST_EQ(mock_flashrom_range_writes, 1, "Only the new entry is written");
+	TEST_EQ(mock_flashrom_writes, 0, "The region is not written");
 }
 
 static void test_write_ok_2ndentry(void)
@@ -238,6 +302,7 @@ static void test_write_ok_full(void)
 		0,
 		"The flash was erased and the new entry was placed at "
 		"the beginning");
+	TEST_EQ(mock_flashrom_writes, 1, "The whole region is written");
 }
 
 static void test_write_fail_uninitialized(void)
@@ -267,6 +332,7 @@ int main(int argc, char *argv[])
 	test_read_ok_beginning();
 	test_read_ok_2ndentry();
 	test_read_ok_full();
+	test_read_ok_middle();
 	test_read_fail_uninitialized();
 	test_read_fail_flashrom();
 	test_write_ok_beginning();
@@ -12,6 +12,7 @@
 #include "2secdata.h"
 #include "2sysincludes.h"
 #include "test_common.h"
+#include "vboot_struct.h"
 
 /* Common context for tests */
 static uint8_t workbuf[VB2_FIRMWARE_WORKBUF_RECOMMENDED_SIZE]
@@ -831,6 +832,68 @@ static void get_recovery_reason_tests(void)
 	TEST_EQ(vb2api_get_recovery_reason(ctx), 4, "correct recovery reason");
 }
 
+static void boot_time_tests(void)
+{
+	VbSharedDataHeader vbsd;
+
+	/* vb2_add_boot_time() */
+	reset_common_data();
+	TEST_EQ(sd->boot_time_ms[VB2_BOOT_TIME_FW_BODY], 0,
+		"boot times start at zero");
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_BODY, vb2ex_mtime() - 5);
+	vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_BODY, vb2ex_mtime() - 7);
+	TEST_TRUE(sd->boot_time_ms[VB2_BOOT_TIME_FW_BODY] >= 12,
+		  "boot time adds up");
+	TEST_EQ(sd->boot_time_ms[VB2_BOOT_TIME_FW_PHASE1], 0,
+		"other boot times untouched");
+
+	/* vb2api_export_vbsd() */
+	reset_common_data();
+	sd->boot_time_ms[VB2_BOOT_TIME_FW_PHASE1] = 11;
+	sd->boot_time_ms[VB2_BOOT_TIME_KERNEL_PART + 3] = 22;
+	vb2api_export_vbsd(ctx, &vbsd);
+	TEST_EQ(vbsd.struct_version, 3, "VBSD version with boot times");
+	TEST_EQ(vbsd.boot_time_ms[VBSD_BOOT_TIME_FW_PHASE1], 11,
+		"phase 1 time exported");
+	TEST_EQ(vbsd.boot_time_ms[VBSD_BOOT_TIME_KERNEL_PART + 3], 22,
+		"last kernel partition time exported");
+}
+
+static void workbuf_peak_tests(void)
+{
+	struct vb2_workbuf wb, wblocal;
+	uint32_t used;
+	char *info;
+
+	reset_common_data();
+	used = sd->workbuf_used;
+	TEST_EQ(sd->workbuf_peak, used, "workbuf peak starts at used");
+
+	vb2_workbuf_from_ctx(ctx, &wb);
+	wblocal = wb;
+	vb2_workbuf_alloc(&wblocal, 3 * VB2_WORKBUF_ALIGN - 1);
+	vb2_workbuf_alloc(&wb, VB2_WORKBUF_ALIGN);
+	TEST_EQ(sd->workbuf_peak, used + 3 * VB2_WORKBUF_ALIGN,
+		"  raised through copies of the workbuf");
+
+	TEST_PTR_EQ(vb2_workbuf_alloc(&wb, sd->workbuf_size), NULL,
+		    "  alloc too big");
+	TEST_EQ(sd->workbuf_peak, used + 3 * VB2_WORKBUF_ALIGN,
+		"  failed alloc not counted");
+
+	vb2_set_workbuf_used(ctx, used + 5 * VB2_WORKBUF_ALIGN);
+	TEST_EQ(sd->workbuf_peak, used + 5 * VB2_WORKBUF_ALIGN,
+		"  raised by vb2_set_workbuf_used()");
+	vb2_set_workbuf_used(ctx, used);
+	TEST_EQ(sd->workbuf_peak, used + 5 * VB2_WORKBUF_ALIGN,
+		"  not lowered by vb2_set_workbuf_used()");
+
+	info = vb2api_get_debug_info(ctx);
+	TEST_PTR_NEQ(strstr(info, "\nworkbuf: used="), NULL,
+		     "  reported in debug info");
+	free(info);
+}
+
 static void phone_recovery_enabled_tests(void)
 {
 	/* Phone recovery enabled */
@@ -1065,6 +1128,8 @@ int main(int argc, char* argv[])
 	need_reboot_for_display_tests();
 	clear_recovery_tests();
 	get_recovery_reason_tests();
+	boot_time_tests();
+	workbuf_peak_tests();
 	phone_recovery_enabled_tests();
 	diagnostic_ui_enabled_tests();
 	dev_default_boot_tests();
@@ -52,6 +52,7 @@ static int preamble_verify_fail;
 static int verify_data_fail;
 static int unpack_key_fail;
 static int gpt_flag_external;
+static size_t malloc_fail_size;  /* fail allocations this big, if non-zero */
 
 static struct vb2_gbb_header gbb;
 static VbExDiskHandle_t handle;
@@ -85,7 +86,7 @@ static void SetupGptHeader(GptHeader *h, int is_secondary)
 
 	/* 16KB: 128 entries of 128 bytes */
 	h->size_of_entry = sizeof(GptEntry);
-	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h->number_of_entries = DEFAULT_NUMBER_OF_ENTRIES;
 
 	/* Set LBA pointers for primary or secondary header */
 	if (is_secondary) {
@@ -122,6 +123,7 @@ static void ResetMocks(void)
 
 	disk_read_to_fail = -1;
 	disk_write_to_fail = -1;
+	malloc_fail_size = 0;
 
 	gpt_init_fail = 0;
 	keyblock_verify_fail = 0;
@@ -213,7 +215,9 @@ vb2_error_t VbExDiskRead(VbExDiskHandle_t h, uint64_t lba_start,
 {
 	LOGCALL("VbExDiskRead(h, %d, %d)\n", (int)lba_start, (int)lba_count);
 
-	if ((int)lba_start == disk_read_to_fail)
+	/* Fail any read which covers the failing sector */
+	if (disk_read_to_fail >= (int)lba_start &&
+	    disk_read_to_fail < (int)(lba_start + lba_count))
 		return VB2_ERROR_MOCK;
 
 	memcpy(buffer, &mock_disk[lba_start * MOCK_SECTOR_SIZE],
@@ -236,6 +240,16 @@ vb2_error_t VbExDiskWrite(VbExDiskHandle_t h, uint64_t lba_start,
 	return VB2_SUCCESS;
 }
 
+/* Linked with --wrap=malloc, so allocations by the code under test can fail */
+void *__real_malloc(size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_malloc(size_t size)
+{
+	if (malloc_fail_size && size >= malloc_fail_size)
+		return NULL;
+	return __real_malloc(size);
+}
+
 int GptInit(GptData *gpt)
 {
 	return gpt_init_fail;
@@ -349,10 +363,8 @@ static void ReadWriteGptTest(void)
 
 	ResetMocks();
 	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 2, 32)\n"
-		   "VbExDiskRead(h, 1023, 1)\n"
-		   "VbExDiskRead(h, 991, 32)\n");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
 	ResetCallLog();
 	/*
 	 * Valgrind complains about access to uninitialized memory here, so
@@ -376,9 +388,8 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
 		g.gpt_drive_sectors, 0, g.sector_bytes),
 		0, "Secondary header is valid");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 1023, 1)\n"
-		   "VbExDiskRead(h, 991, 32)\n");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
 	WriteAndFreeGptData(handle, &g);
 
 	/*
@@ -395,9 +406,8 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
 		g.gpt_drive_sectors, 0, g.sector_bytes),
 		1, "Secondary header is invalid");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 2, 32)\n"
-		   "VbExDiskRead(h, 1023, 1)\n");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
 	WriteAndFreeGptData(handle, &g);
 
 	/*
@@ -415,8 +425,8 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
 		g.gpt_drive_sectors, 0, g.sector_bytes),
 		1, "Secondary header is invalid");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 1023, 1)\n");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
 	WriteAndFreeGptData(handle, &g);
 
 	/*
@@ -435,9 +445,8 @@ static void ReadWriteGptTest(void)
 	GptRepair(&g);
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
 		"Fix Primary GPT: WriteAndFreeGptData");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 1023, 1)\n"
-		   "VbExDiskRead(h, 991, 32)\n"
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n"
 		   "VbExDiskWrite(h, 1, 1)\n"
 		   "VbExDiskWrite(h, 2, 32)\n");
 	TEST_EQ(CheckHeader(mock_gpt_primary, 0, g.streaming_drive_sectors,
@@ -460,9 +469,8 @@ static void ReadWriteGptTest(void)
 	GptRepair(&g);
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0,
 		"Fix Secondary GPT: WriteAndFreeGptData");
-	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
-		   "VbExDiskRead(h, 2, 32)\n"
-		   "VbExDiskRead(h, 1023, 1)\n"
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n"
 		   "VbExDiskWrite(h, 1023, 1)\n"
 		   "VbExDiskWrite(h, 991, 32)\n");
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
@@ -477,7 +485,7 @@ static void ReadWriteGptTest(void)
 	memset(g.primary_header, '\0', g.sector_bytes);
 	h = (GptHeader*)g.primary_header;
 	h->entries_lba = 2;
-	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h->number_of_entries = DEFAULT_NUMBER_OF_ENTRIES;
 	h->size_of_entry = sizeof(GptEntry);
 	TEST_EQ(WriteAndFreeGptData(handle, &g), 0, "WriteAndFree mod 1");
 	TEST_CALLS("VbExDiskWrite(h, 1, 1)\n"
@@ -491,7 +499,7 @@ static void ReadWriteGptTest(void)
 	memset(g.primary_header, '\0', g.sector_bytes);
 	h = (GptHeader*)g.primary_header;
 	h->entries_lba = 2;
-	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	h->number_of_entries = DEFAULT_NUMBER_OF_ENTRIES;
 	h->size_of_entry = sizeof(GptEntry);
 	h = (GptHeader*)g.secondary_header;
 	h->entries_lba = 991;
@@ -526,6 +534,10 @@ static void ReadWriteGptTest(void)
 	ResetMocks();
 	disk_read_to_fail = 2;
 	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead disk fail");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 1, 1)\n"
+		   "VbExDiskRead(h, 2, 32)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
 	g.valid_headers = MASK_BOTH;
 	g.valid_entries = MASK_SECONDARY;
 	GptRepair(&g);
@@ -553,6 +565,42 @@ static void ReadWriteGptTest(void)
 	TEST_CALLS("VbExDiskWrite(h, 1023, 1)\n"
 		   "VbExDiskWrite(h, 991, 32)\n");
 
+	/* More entries than fit in the default buffers */
+	ResetMocks();
+	h = mock_gpt_primary;
+	h->number_of_entries = 4 * DEFAULT_NUMBER_OF_ENTRIES;
+	h->first_usable_lba = 2 + CalculateEntriesSectors(h, MOCK_SECTOR_SIZE);
+	h->last_usable_lba = 800;
+	h->header_crc32 = HeaderCrc(h);
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead grow");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 2, 128)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
+	TEST_EQ(CheckHeader((GptHeader *)g.primary_header, 0,
+			    g.streaming_drive_sectors, g.gpt_drive_sectors, 0,
+			    g.sector_bytes),
+		0, "  primary header kept");
+	WriteAndFreeGptData(handle, &g);
+
+	/* Header is dropped if its entries can't be allocated */
+	ResetMocks();
+	h = mock_gpt_primary;
+	h->number_of_entries = 4 * DEFAULT_NUMBER_OF_ENTRIES;
+	h->first_usable_lba = 2 + CalculateEntriesSectors(h, MOCK_SECTOR_SIZE);
+	h->last_usable_lba = 800;
+	h->header_crc32 = HeaderCrc(h);
+	malloc_fail_size = 2 * GPT_ENTRIES_ALLOC_SIZE;
+	TEST_EQ(AllocAndReadGptData(handle, &g), 0, "AllocAndRead grow fail");
+	TEST_CALLS("VbExDiskRead(h, 1, 33)\n"
+		   "VbExDiskRead(h, 991, 33)\n");
+	TEST_NEQ(CheckHeader((GptHeader *)g.primary_header, 0,
+			     g.streaming_drive_sectors, g.gpt_drive_sectors, 0,
+			     g.sector_bytes),
+		 0, "  primary header dropped");
+	GptValidityCheck(&g);
+	TEST_EQ(g.valid_headers, MASK_SECONDARY, "  only secondary valid");
+	WriteAndFreeGptData(handle, &g);
+
 	/* Error writing */
 	ResetMocks();
 	disk_write_to_fail = 1;
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# Copyright 2020 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Smoke test for verified_boot_sim in normal, recovery and hwcrypto modes
+
+# Load common constants and variables.
+. "$(dirname "$0")/common.sh"
+
+set -e
+
+CGPT=${BIN_DIR}/cgpt
+DEVKEYS=${SCRIPT_DIR}/devkeys
+
+# Run tests in a dedicated directory for easy cleanup or debugging.
+DIR="${TEST_DIR}/verified_boot_sim_test_dir"
+[ -d "$DIR" ] || mkdir -p "$DIR"
+echo "Testing verified_boot_sim in $DIR"
+cd "$DIR"
+
+echo 'Creating test firmware image'
+
+# GBB with the dev root and recovery keys
+${FUTILITY} gbb -c 0x100,0x1000,0,0x1000 gbb.test
+${FUTILITY} gbb -s -k ${DEVKEYS}/root_key.vbpubk \
+    -r ${DEVKEYS}/recovery_key.vbpubk gbb.test
+
+# Firmware body and vblock signed with the dev firmware keys
+dd if=/dev/urandom bs=65536 count=4 of="fw_body.bin"
+${FUTILITY} vbutil_firmware --vblock vblock.test \
+    --keyblock ${DEVKEYS}/firmware.keyblock \
+    --signprivate ${DEVKEYS}/firmware_data_key.vbprivk \
+    --version 1 \
+    --fv "fw_body.bin" \
+    --kernelkey ${DEVKEYS}/kernel_subkey.vbpubk \
+    --flags 0
+
+# Lay them out in a 4MB image using an existing fmap
+dd if=/dev/zero bs=1048576 count=4 of=fw.test
+dd if=${SCRIPT_DIR}/futility/data_fmap2.bin of=fw.test conv=notrunc
+${FUTILITY} load_fmap fw.test GBB:gbb.test \
+    VBLOCK_A:vblock.test VBLOCK_B:vblock.test \
+    FW_MAIN_A:fw_body.bin FW_MAIN_B:fw_body.bin
+
+echo 'Creating test disk images'
+
+# Dummy kernel data
+echo "hi there" > "dummy_config.txt"
+dd if=/dev/urandom bs=16384 count=1 of="dummy_bootloader.bin"
+dd if=/dev/urandom bs=32768 count=1 of="dummy_kernel.bin"
+
+# Normal mode kernel is signed by the kernel subkey, recovery mode kernel
+# by the recovery key.
+${FUTILITY} vbutil_kernel \
+    --pack "kernel.test" \
+    --keyblock ${DEVKEYS}/kernel.keyblock \
+    --signprivate ${DEVKEYS}/kernel_data_key.vbprivk \
+    --version 1 \
+    --arch arm \
+    --vmlinuz "dummy_kernel.bin" \
+    --bootloader "dummy_bootloader.bin" \
+    --config "dummy_config.txt"
+${FUTILITY} vbutil_kernel \
+    --pack "rec_kernel.test" \
+    --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+    --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+    --version 1 \
+    --arch arm \
+    --vmlinuz "dummy_kernel.bin" \
+    --bootloader "dummy_bootloader.bin" \
+    --config "dummy_config.txt"
+
+for kernel in kernel rec_kernel; do
+  dd if=/dev/zero of=${kernel}_disk.test bs=1024 count=1024
+  ${CGPT} create ${kernel}_disk.test
+  ${CGPT} add -i 1 -S 1 -P 1 -b 64 -s 960 -t kernel -l kernelA \
+      ${kernel}_disk.test
+  dd if=${kernel}.test of=${kernel}_disk.test bs=512 seek=64 conv=notrunc
+done
+
+echo 'Running verified_boot_sim'
+
+${BUILD_RUN}/utility/verified_boot_sim -n 2 -F 20000 -D 50000 \
+    fw.test kernel_disk.test
+happy 'Normal mode boot succeeded'
+
+${BUILD_RUN}/utility/verified_boot_sim -r fw.test rec_kernel_disk.test
+happy 'Recovery mode boot succeeded'
+
+${BUILD_RUN}/utility/verified_boot_sim_hwcrypto -H fw.test kernel_disk.test
+happy 'Hwcrypto boot succeeded'
@@ -0,0 +1,429 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runs verified boot from firmware verification to LoadKernel() against a
+ * firmware image and a disk image, with emulated TPM and NV storage and
+ * simulated flash and disk bandwidth, and reports how long each phase took.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2misc.h"
+#include "2secdata.h"
+#include "2sysincludes.h"
+#include "fmap.h"
+#include "host_misc.h"
+#include "load_kernel_fw.h"
+#include "vboot_api.h"
+
+#define LBA_BYTES 512
+#define KERNEL_BUFFER_SIZE 0x4000000
+#define BODY_BLOCK_SIZE 0x10000
+
+static uint8_t workbuf[VB2_KERNEL_WORKBUF_RECOMMENDED_SIZE]
+	__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+
+/* Firmware image, and simulated flash bandwidth in KB/s (0 = unlimited) */
+static uint8_t *fw_image;
+static uint32_t fw_image_size;
+static uint32_t flash_kbps;
+
+/* Disk image, and simulated disk bandwidth in KB/s (0 = unlimited) */
+static FILE *disk_file;
+static uint64_t disk_lba_count;
+static uint32_t disk_kbps;
+
+/* Names of the phases in vb2_shared_data.boot_time_ms[] */
+static const char *const boot_time_names[VB2_BOOT_TIME_COUNT] = {
+	[VB2_BOOT_TIME_FW_PHASE1] = "fw_phase1",
+	[VB2_BOOT_TIME_FW_PHASE2] = "fw_phase2",
+	[VB2_BOOT_TIME_FW_PHASE3] = "fw_phase3",
+	[VB2_BOOT_TIME_FW_KEYBLOCK] = "  fw_keyblock",
+	[VB2_BOOT_TIME_FW_PREAMBLE] = "  fw_preamble",
+	[VB2_BOOT_TIME_FW_BODY] = "fw_body",
+	[VB2_BOOT_TIME_EC_SYNC] = "ec_sync",
+	[VB2_BOOT_TIME_AUXFW_SYNC] = "auxfw_sync",
+	[VB2_BOOT_TIME_LOAD_KERNEL] = "load_kernel",
+	[VB2_BOOT_TIME_KERNEL_PART] = "  kernel_part1",
+	[VB2_BOOT_TIME_KERNEL_PART + 1] = "  kernel_part2",
+	[VB2_BOOT_TIME_KERNEL_PART + 2] = "  kernel_part3",
+	[VB2_BOOT_TIME_KERNEL_PART + 3] = "  kernel_part4",
+};
+
+/* Wait as long as reading size bytes at kbps KB/s would take. */
+static void simulate_transfer(uint64_t size, uint32_t kbps)
+{
+	if (kbps)
+		usleep(size * VB2_USEC_PER_MSEC * VB2_MSEC_PER_SEC /
+		       ((uint64_t)kbps * 1024));
+}
+
+/* Find an fmap area in the firmware image. */
+static uint8_t *find_fw_area(const char *name, uint32_t *size)
+{
+	FmapAreaHeader *ah;
+	uint8_t *area;
+
+	area = fmap_find_by_name(fw_image, fw_image_size, NULL, name, &ah);
+	if (!area || ah->area_offset > fw_image_size ||
+	    ah->area_size > fw_image_size - ah->area_offset)
+		return NULL;
+
+	*size = ah->area_size;
+	return area;
+}
+
+/* Read resources from the firmware image, at the flash bandwidth. */
+vb2_error_t vb2ex_read_resource(struct vb2_context *c,
+				enum vb2_resource_index index, uint32_t offset,
+				void *buf, uint32_t size)
+{
+	const char *name;
+	uint8_t *area;
+	uint32_t area_size;
+
+	switch (index) {
+	case VB2_RES_GBB:
+		name = "GBB";
+		break;
+	case VB2_RES_FW_VBLOCK:
+		name = c->flags & VB2_CONTEXT_FW_SLOT_B ?
+			"VBLOCK_B" : "VBLOCK_A";
+		break;
+	default:
+		return VB2_ERROR_EX_READ_RESOURCE_INDEX;
+	}
+
+	area = find_fw_area(name, &area_size);
+	if (!area)
+		return VB2_ERROR_EX_READ_RESOURCE_INDEX;
+	if (offset > area_size || size > area_size - offset)
+		return VB2_ERROR_EX_READ_RESOURCE_SIZE;
+
+	memcpy(buf, area + offset, size);
+	simulate_transfer(size, flash_kbps);
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_tpm_clear_owner(struct vb2_context *c)
+{
+	/* Nothing to clear in the emulated TPM. */
+	return VB2_SUCCESS;
+}
+
+/* The disk image is the only fixed disk. */
+vb2_error_t VbExDiskGetInfo(VbDiskInfo **infos_ptr, uint32_t *count,
+			    uint32_t disk_flags)
+{
+	static VbDiskInfo info;
+
+	*infos_ptr = NULL;
+	*count = 0;
+	if (!(disk_flags & VB_DISK_FLAG_FIXED))
+		return VB2_SUCCESS;
+
+	info.handle = (VbExDiskHandle_t)disk_file;
+	info.bytes_per_lba = LBA_BYTES;
+	info.lba_count = disk_lba_count;
+	info.streaming_lba_count = disk_lba_count;
+	info.flags = VB_DISK_FLAG_FIXED;
+	info.name = "drive_image";
+	*infos_ptr = &info;
+	*count = 1;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t VbExDiskFreeInfo(VbDiskInfo *infos_ptr,
+			     VbExDiskHandle_t preserve_handle)
+{
+	return VB2_SUCCESS;
+}
+
+/* Read the disk image, at the disk bandwidth. */
+vb2_error_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+			 uint64_t lba_count, void *buffer)
+{
+	if (lba_start >= disk_lba_count ||
+	    lba_count > disk_lba_count - lba_start) {
+		fprintf(stderr, "Read overrun: %" PRIu64 " + %" PRIu64
+			" > %" PRIu64 "\n", lba_start, lba_count,
+			disk_lba_count);
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	if (0 != fseek(disk_file, lba_start * LBA_BYTES, SEEK_SET) ||
+	    1 != fread(buffer, lba_count * LBA_BYTES, 1, disk_file)) {
+		fprintf(stderr, "Read error.\n");
+		return VB2_ERROR_UNKNOWN;
+	}
+
+	simulate_transfer(lba_count * LBA_BYTES, disk_kbps);
+	return VB2_SUCCESS;
+}
+
+/* Writes (GPT updates) are dropped, so that each run sees the same disk. */
+vb2_error_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			  uint64_t lba_count, const void *buffer)
+{
+	return VB2_SUCCESS;
+}
+
+/* Hash the firmware body of the chosen slot, at the flash bandwidth. */
+static vb2_error_t hash_body(struct vb2_context *ctx)
+{
+	uint8_t *body;
+	uint32_t body_size;
+	uint32_t remaining;
+	uint32_t size;
+	uint32_t start_ms;
+
+	body = find_fw_area(ctx->flags & VB2_CONTEXT_FW_SLOT_B ?
+			    "FW_MAIN_B" : "FW_MAIN_A", &body_size);
+	if (!body)
+		return VB2_ERROR_TEST_INPUT_FILE;
+
+	VB2_TRY(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY));
+
+	remaining = vb2api_get_firmware_size(ctx);
+	if (remaining > body_size)
+		return VB2_ERROR_TEST_INPUT_FILE;
+
+	while (remaining) {
+		size = remaining < BODY_BLOCK_SIZE ?
+			remaining : BODY_BLOCK_SIZE;
+		/*
+		 * On a real board the body is read from flash as it is
+		 * hashed, so account the transfer to the fw_body phase.
+		 */
+		start_ms = vb2ex_mtime();
+		simulate_transfer(size, flash_kbps);
+		vb2_add_boot_time(ctx, VB2_BOOT_TIME_FW_BODY, start_ms);
+		VB2_TRY(vb2api_extend_hash(ctx, body, size));
+		body += size;
+		remaining -= size;
+	}
+
+	return vb2api_check_hash(ctx);
+}
+
+/*
+ * Run one boot, from firmware verification to LoadKernel().  Returns the
+ * result of the first failing step, and the shared data in *sd_out.
+ */
+static vb2_error_t run_boot(int recovery, int hwcrypto, LoadKernelParams *lkp,
+			    struct vb2_shared_data **sd_out)
+{
+	struct vb2_context *ctx;
+	vb2_error_t rv;
+
+	VB2_TRY(vb2api_init(workbuf, sizeof(workbuf), &ctx));
+	*sd_out = vb2_get_sd(ctx);
+
+	/* Emulated TPM: fresh secure data, and no FWMP. */
+	vb2api_secdata_firmware_create(ctx);
+	vb2api_secdata_kernel_create(ctx);
+	ctx->flags |= VB2_CONTEXT_NO_SECDATA_FWMP;
+	if (hwcrypto) {
+		/* As if kernel verification on a previous boot allowed it */
+		VB2_TRY(vb2_secdata_kernel_init(ctx));
+		vb2_secdata_kernel_set(ctx, VB2_SECDATA_KERNEL_FLAGS,
+				       vb2_secdata_kernel_get(ctx,
+					       VB2_SECDATA_KERNEL_FLAGS) |
+				       VB2_SECDATA_KERNEL_FLAG_HWCRYPTO_ALLOWED);
+	}
+	if (recovery)
+		ctx->flags |= VB2_CONTEXT_FORCE_RECOVERY_MODE;
+
+	/* Firmware verification, skipped by recovery mode */
+	rv = vb2api_fw_phase1(ctx);
+	if (rv == VB2_ERROR_API_PHASE1_RECOVERY) {
+		printf("Phase 1 wants recovery mode.\n");
+	} else if (rv) {
+		printf("Phase 1 failed: %#x\n", rv);
+		return rv;
+	} else {
+		rv = vb2api_fw_phase2(ctx);
+		if (!rv)
+			rv = vb2api_fw_phase3(ctx);
+		if (!rv)
+			rv = hash_body(ctx);
+		if (rv) {
+			printf("Firmware verification failed: %#x\n", rv);
+			return rv;
+		}
+	}
+
+	/* Kernel verification */
+	rv = vb2api_kernel_phase1(ctx);
+	if (rv) {
+		printf("Kernel phase 1 failed: %#x\n", rv);
+		return rv;
+	}
+
+	lkp->partition_number = 0;
+	rv = LoadKernel(ctx, lkp);
+	if (rv) {
+		printf("LoadKernel() failed: %#x\n", rv);
+		return rv;
+	}
+
+	return VB2_SUCCESS;
+}
+
+static void print_help(const char *progname)
+{
+	fprintf(stderr,
+		"usage: %s [options] <firmware_image> <drive_image>\n"
+		"\noptions:\n"
+		"  -F NUM     simulated flash bandwidth in KB/s"
+		" (default 0, unlimited)\n"
+		"  -D NUM     simulated disk bandwidth in KB/s"
+		" (default 0, unlimited)\n"
+		"  -n NUM     number of boots to run and average"
+		" (default 1)\n"
+		"  -r         boot in recovery mode\n"
+		"  -H         allow hwcrypto (only useful when linked with a\n"
+		"             hwcrypto provider, as verified_boot_sim_hwcrypto)\n",
+		progname);
+}
+
+/* Parse a number option, counting errors in *errorcnt. */
+static uint32_t parse_num(int c, const char *arg, int *errorcnt)
+{
+	char *e = NULL;
+	uint32_t value = strtoul(arg, &e, 0);
+
+	if (!*arg || (e && *e)) {
+		fprintf(stderr, "Invalid argument to -%c: \"%s\"\n", c, arg);
+		(*errorcnt)++;
+	}
+	return value;
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t total_ms[VB2_BOOT_TIME_COUNT] = {0};
+	uint64_t run_ms = 0;
+	uint32_t workbuf_peak = 0;
+	struct vb2_shared_data *sd;
+	LoadKernelParams lkp;
+	uint32_t runs = 1;
+	uint32_t start_ms;
+	int recovery = 0;
+	int hwcrypto = 0;
+	int errorcnt = 0;
+	int c, i;
+	uint32_t n;
+	vb2_error_t rv = VB2_SUCCESS;
+
+	opterr = 0;
+	while ((c = getopt(argc, argv, ":F:D:n:rH")) != -1) {
+		switch (c) {
+		case 'F':
+			flash_kbps = parse_num(c, optarg, &errorcnt);
+			break;
+		case 'D':
+			disk_kbps = parse_num(c, optarg, &errorcnt);
+			break;
+		case 'n':
+			runs = parse_num(c, optarg, &errorcnt);
+			if (!runs)
+				errorcnt++;
+			break;
+		case 'r':
+			recovery = 1;
+			break;
+		case 'H':
+			hwcrypto = 1;
+			break;
+		case '?':
+			fprintf(stderr, "Unrecognized switch: -%c\n", optopt);
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to -%c\n", optopt);
+			errorcnt++;
+			break;
+		default:
+			errorcnt++;
+			break;
+		}
+	}
+
+	if (errorcnt || argc - optind != 2) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	if (VB2_SUCCESS != vb2_read_file(argv[optind], &fw_image,
+					 &fw_image_size)) {
+		fprintf(stderr, "Unable to read firmware image %s\n",
+			argv[optind]);
+		return 1;
+	}
+	if (!fmap_find(fw_image, fw_image_size)) {
+		fprintf(stderr, "No FMAP in firmware image %s\n",
+			argv[optind]);
+		free(fw_image);
+		return 1;
+	}
+
+	disk_file = fopen(argv[optind + 1], "rb");
+	if (!disk_file) {
+		fprintf(stderr, "Unable to open drive image %s\n",
+			argv[optind + 1]);
+		free(fw_image);
+		return 1;
+	}
+	fseek(disk_file, 0, SEEK_END);
+	disk_lba_count = ftell(disk_file) / LBA_BYTES;
+
+	memset(&lkp, 0, sizeof(lkp));
+	lkp.disk_handle = (VbExDiskHandle_t)disk_file;
+	lkp.bytes_per_lba = LBA_BYTES;
+	lkp.streaming_lba_count = disk_lba_count;
+	lkp.gpt_lba_count = disk_lba_count;
+	lkp.kernel_buffer = malloc(KERNEL_BUFFER_SIZE);
+	lkp.kernel_buffer_size = KERNEL_BUFFER_SIZE;
+	if (!lkp.kernel_buffer) {
+		fprintf(stderr, "Unable to allocate kernel buffer.\n");
+		fclose(disk_file);
+		free(fw_image);
+		return 1;
+	}
+
+	for (n = 0; n < runs && rv == VB2_SUCCESS; n++) {
+		start_ms = vb2ex_mtime();
+		rv = run_boot(recovery, hwcrypto, &lkp, &sd);
+		run_ms += vb2ex_mtime() - start_ms;
+		if (rv == VB2_SUCCESS) {
+			for (i = 0; i < VB2_BOOT_TIME_COUNT; i++)
+				total_ms[i] += sd->boot_time_ms[i];
+			workbuf_peak = VB2_MAX(workbuf_peak, sd->workbuf_peak);
+		}
+	}
+
+	if (rv == VB2_SUCCESS) {
+		printf("Booted partition %u in %u run(s)\n",
+		       lkp.partition_number, runs);
+		printf("%-16s %10s\n", "Phase", "Avg (ms)");
+		for (i = 0; i < VB2_BOOT_TIME_COUNT; i++)
+			printf("%-16s %10" PRIu64 "\n", boot_time_names[i],
+			       total_ms[i] / runs);
+		printf("%-16s %10" PRIu64 "\n", "total", run_ms / runs);
+		printf("Workbuf peak: %u of %zu bytes\n",
+		       workbuf_peak, sizeof(workbuf));
+	}
+
+	fclose(disk_file);
+	free(lkp.kernel_buffer);
+	free(fw_image);
+	return rv != VB2_SUCCESS;
+}